@@ -0,0 +1,77 @@
+#include <cstdio>
+#include <cstdlib>
+#include "Core/Constants.h"
+#include "Core/Auxiliaries.h"
+#include "Core/JobSystem.h"
+#include "Core/Renderers/Renderer.h"
+
+// Runs the frame loop on the headless NullRenderer, for the platforms without a renderer backend.
+// Usage: PillowHeadless [frame count] [worker cost in microseconds]
+namespace
+{
+   using namespace Pillow;
+
+   const int32_t DefaultFrameCount = 600;
+   const double DefaultWorkerMicroseconds = 200;
+
+   void LogStageStats(const Graphics::FrameStageStats& stats)
+   {
+      const double frames = double(std::max(stats.Frames, uint64_t(1)));
+      char line[160];
+      std::snprintf(line, sizeof(line), "Frames %llu  Pioneer(ms) %.3f  Worker(ms) %.3f  CriticalWorker(ms) %.3f  Assembler(ms) %.3f",
+         (unsigned long long)stats.Frames, stats.PioneerMilliseconds, stats.WorkerMilliseconds, stats.CriticalWorkerMilliseconds, stats.AssemblerMilliseconds);
+      LogSystem(line);
+      std::snprintf(line, sizeof(line), "Per frame    Pioneer(ms) %.3f  Worker(ms) %.3f  CriticalWorker(ms) %.3f  Assembler(ms) %.3f",
+         stats.PioneerMilliseconds / frames, stats.WorkerMilliseconds / frames, stats.CriticalWorkerMilliseconds / frames, stats.AssemblerMilliseconds / frames);
+      LogSystem(line);
+   }
+
+   // The idle time of every job thread, and of the outside threads last.
+   void LogJobStats()
+   {
+      char line[160];
+      for (int32_t i = 0; i <= GetJobThreadCount(); i++)
+      {
+         const int32_t threadIndex = i < GetJobThreadCount() ? i : -1;
+         const JobStats stats = GetJobStats(threadIndex);
+         std::snprintf(line, sizeof(line), "Job thread %d  Executed %llu  Busy(ms) %.3f  Spin(ms) %.3f  Park(ms) %.3f  SpinWakeups %llu  ParkWakeups %llu",
+            threadIndex, (unsigned long long)stats.Executed, stats.BusyMilliseconds, stats.SpinMilliseconds, stats.ParkMilliseconds,
+            (unsigned long long)stats.SpinWakeups, (unsigned long long)stats.ParkWakeups);
+         LogSystem(line);
+      }
+   }
+}
+
+int main(int argc, char** argv)
+{
+   const int32_t frameCount = argc > 1 ? std::atoi(argv[1]) : DefaultFrameCount;
+   const double workerMicroseconds = argc > 2 ? std::atof(argv[2]) : DefaultWorkerMicroseconds;
+   try
+   {
+      if (frameCount <= 0) throw std::runtime_error("The frame count must be positive.");
+      GlobalClockStart();
+      Constants::SetThreadNumbers();
+      InitializeJobSystem(Constants::ThreadNumJobs);
+      Graphics::InitializeRenderer(Constants::ThreadNumRenderer, nullptr);
+      Graphics::NullRenderer& renderer = static_cast<Graphics::NullRenderer&>(*Graphics::Instance);
+      renderer.SetWorkerCost(-1, workerMicroseconds);
+      renderer.Launch();
+      for (int32_t i = 0; i < frameCount; i++)
+      {
+         GlobalClockUpdate();
+         renderer.Commit();
+      }
+      // Waits for the last frame.
+      renderer.Terminate();
+      LogStageStats(renderer.GetStageStats());
+      LogJobStats();
+      Graphics::Instance.reset();
+      TerminateJobSystem();
+   }
+   catch (const std::exception& exception)
+   {
+      LogSystem(string("The headless run failed: ") + exception.what());
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
@@ -1,5 +1,19 @@
-#include "Auxiliaries.h"
+// Ahead of DirectXMath, the SAL macros it defines off Windows(e.g. __pre) break <regex>.
 #include <regex>
+#include "Auxiliaries.h"
+#include "JobSystem.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <cstdio>
+#if defined(_WIN64)
+#else // Android and the other POSIX platforms.
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 using namespace Pillow;
 using namespace std::chrono;
@@ -66,6 +80,99 @@ bool Pillow::KeyValuePair::operator<(const KeyValuePair& right) const
    return this->operator>(right);
 }
 
+int32_t Pillow::GetParallelForThreadCount(int32_t count, int32_t threadCount)
+{
+   // The job system's threads plus the calling one, which runs jobs while it waits.
+   const int32_t jobThreadCount = GetJobThreadCount();
+   if (threadCount <= 0) threadCount = jobThreadCount > 0 ? jobThreadCount + 1 : std::max(int32_t(std::thread::hardware_concurrency()), 1);
+   return std::min(threadCount, count);
+}
+
+void Pillow::ParallelFor(int32_t count, int32_t threadCount, const std::function<void(int32_t)>& job)
+{
+   if (count <= 0) return;
+   const int32_t jobThreadCount = GetJobThreadCount();
+   threadCount = GetParallelForThreadCount(count, threadCount);
+   // Jobs are claimed one by one from a shared cursor, so uneven jobs don't stall the fast threads.
+   std::atomic<int32_t> cursor{ 0 };
+   std::exception_ptr error;
+   std::mutex errorLock;
+   auto Loop = [&]()
+      {
+         try
+         {
+            for (int32_t i = cursor.fetch_add(1, std::memory_order::relaxed); i < count; i = cursor.fetch_add(1, std::memory_order::relaxed))
+            {
+               job(i);
+            }
+         }
+         catch (...)
+         {
+            // Keep the first exception, and stop handing out the remaining jobs.
+            std::lock_guard lock(errorLock);
+            if (!error) error = std::current_exception();
+            cursor.store(count, std::memory_order::relaxed);
+         }
+      };
+   if (jobThreadCount > 0)
+   {
+      // Nested calls are safe, WaitForCounter() runs the queued jobs instead of blocking.
+      JobCounter counter;
+      SubmitJobs(threadCount, [&](int32_t) { Loop(); }, &counter);
+      WaitForCounter(counter);
+   }
+   else
+   {
+      // Before InitializeJobSystem(), e.g. in the offline tools.
+      std::vector<std::thread> helpers;
+      helpers.reserve(threadCount - 1);
+      for (int32_t i = 1; i < threadCount; i++) helpers.emplace_back(Loop);
+      Loop();
+      for (auto& thread : helpers) thread.join();
+   }
+   if (error) std::rethrow_exception(error);
+}
+
+MappedFile::MappedFile(const string& path)
+{
+#if defined(_WIN64)
+   std::wstring _path;
+   utf8::utf8to16(path.begin(), path.end(), std::back_inserter(_path));
+   HANDLE file = CreateFileW(_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Unable to open file");
+   LARGE_INTEGER size{};
+   // Empty files cannot be mapped.
+   HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0 ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+   CloseHandle(file);
+   if (!mapping) throw std::runtime_error("Unable to map file");
+   // The view holds the mapping, so the handles can be closed right away.
+   view = reinterpret_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+   CloseHandle(mapping);
+   if (!view) throw std::runtime_error("Unable to map file");
+   _Size = size.QuadPart;
+#else
+   int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+   if (file < 0) throw std::runtime_error("Unable to open file");
+   struct stat status{};
+   // Empty files cannot be mapped.
+   void* address = fstat(file, &status) == 0 && status.st_size > 0 ? mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+   close(file);
+   if (address == MAP_FAILED) throw std::runtime_error("Unable to map file");
+   view = reinterpret_cast<uint8_t*>(address);
+   _Size = status.st_size;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+   if (!view) return;
+#if defined(_WIN64)
+   UnmapViewOfFile(view);
+#else
+   munmap(view, _Size);
+#endif
+}
+
 string Pillow::GetResourcePath(const string& name)
 {
    using namespace std::filesystem;
@@ -83,17 +190,30 @@ string Pillow::GetResourcePath(const string& name)
          }
          currentPath = currentPath.parent_path();
       } while (currentPath != currentPath.root_path());
-      if (resourceRootPath.empty()) throw std::exception("\"Resources\" folder does not exist.");
+      if (resourceRootPath.empty()) throw std::runtime_error("\"Resources\" folder does not exist.");
    }
    string result;
 #if defined(_WIN64)
    std::wstring _result = resourceRootPath / name;
    utf8::utf16to8(_result.begin(), _result.end(), std::back_inserter(result));
 #elif defined(__ANDROID__)
+#else
+   result = (resourceRootPath / name).string();
 #endif
    return result;
 }
 
+std::vector<uint8_t> Pillow::ReadBinaryFile(const string& path)
+{
+   std::ifstream file(path, std::ios::binary | std::ios::ate);
+   if (!file.is_open()) throw std::runtime_error("Unable to open file");
+   std::streamsize size = file.tellg();
+   file.seekg(0, std::ios::beg);
+   std::vector<uint8_t> fileData(size);
+   if (size > 0 && !file.read((char*)fileData.data(), size)) throw std::runtime_error("Error reading file");
+   return fileData;
+}
+
 void Pillow::LogSystem(const string& text)
 {
 #if defined(_WIN64)
@@ -102,6 +222,8 @@ void Pillow::LogSystem(const string& text)
    OutputDebugString(_text.c_str());
    OutputDebugString(L"\n");
 #elif defined(__ANDROID__)
+#else
+   std::puts(text.c_str());
 #endif
 }
 
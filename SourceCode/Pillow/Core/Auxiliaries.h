@@ -3,12 +3,15 @@
 #include <typeinfo>
 #include <type_traits>
 #include <exception>
+#include <stdexcept>
 #include <shared_mutex>
 #include <string>
+#include <vector>
 #include <ranges>
 #include <filesystem>
 #include <locale>
 #include <chrono>
+#include <functional>
 #if defined(_WIN64)
 #define NOMINMAX
 #include <Windows.h>
@@ -25,7 +28,7 @@
 #if defined(_MSC_VER)
 #define ForceInline __forceinline
 #elif defined(__GNUC__) | defined(__clang__)
-#define ForceInline __attribute__((always_inline))
+#define ForceInline inline __attribute__((always_inline))
 #endif
 
 // A known issue: VS applies wrong formats for consecutive "PropertyReadonly" macros.
@@ -35,7 +38,7 @@ public: ForceInline type Get##name() const { return _##name; }
 
 #define SingletonCheck() \
 static decltype(this) instance = nullptr; \
-if(instance) throw std::exception("A singleton class cannot be created twice."); \
+if(instance) throw std::runtime_error("A singleton class cannot be created twice."); \
 instance = this;
 
 #define DeleteDefautedMethods(type) \
@@ -115,7 +118,7 @@ namespace Pillow
    };
 
    // Create 64-bytes-aligned memory.
-   ForceInline std::unique_ptr<CacheLine[]> CreateAlignedMemory(int32_t unalignedSize)
+   ForceInline std::unique_ptr<CacheLine[]> CreateAlignedMemory(int64_t unalignedSize)
    {
       return std::make_unique<CacheLine[]>((unalignedSize + sizeof(CacheLine) - 1) / sizeof(CacheLine));
    }
@@ -125,7 +128,42 @@ namespace Pillow
       return utf8::is_valid(str.begin(), str.end());
    }
 
+   // A hint for the core that it's spinning, which saves power and yields the pipeline to the sibling hyperthread.
+   ForceInline void SpinPause()
+   {
+#if defined(_XM_SSE_INTRINSICS_)
+      _mm_pause();
+#elif defined(_M_ARM64)
+      __yield();
+#elif defined(__aarch64__)
+      asm volatile("yield");
+#endif
+   }
+
+   // Runs job(i) for every i in [0, count) on up to threadCount threads(0 = all of them), taken from the job system once it's
+   // initialized, or started for the call otherwise. The calling thread takes part in the work, and the function returns after all jobs are done.
+   void ParallelFor(int32_t count, int32_t threadCount, const std::function<void(int32_t)>& job);
+   // The threads ParallelFor() runs count jobs on, for the stats of its callers.
+   int32_t GetParallelForThreadCount(int32_t count, int32_t threadCount);
+
+   // A read-only view of a whole file mapped into the address space, the pages are loaded on first touch.
+   class MappedFile
+   {
+      DeleteDefautedMethods(MappedFile)
+         ReadonlyProperty(int64_t, Size)
+
+   public:
+      MappedFile(const string& path);
+      ~MappedFile();
+
+      ForceInline const uint8_t* GetData() const { return view; }
+
+   private:
+      uint8_t* view{};
+   };
+
    string GetResourcePath(const string& name);
+   std::vector<uint8_t> ReadBinaryFile(const string& path);
    void LogSystem(const string& text);
    void LogGame(const string& text);
 
@@ -1,7 +1,10 @@
 #include "Constants.h"
+#include <thread>
+#include <algorithm>
 
 using namespace Pillow;
 
+int32_t Pillow::Constants::ThreadNumJobs{};
 int32_t Pillow::Constants::ThreadNumRenderer{};
 int32_t Pillow::Constants::ThreadNumPhysics{};
 int32_t Pillow::Constants::ThreadNumTick{};
@@ -10,6 +13,8 @@ void Constants::SetThreadNumbers()
 {
    if (ThreadNumRenderer != 0) throw std::runtime_error("Thread numbers have already been set.");
    int32_t threadNum = std::thread::hardware_concurrency();
+   // The main thread helps while waiting for the jobs.
+   ThreadNumJobs = std::max(threadNum - 1, 1);
    ThreadNumRenderer = std::clamp(threadNum / 4, 1, MaxThreadNumRenderer);
    ThreadNumTick = ThreadNumPhysics = std::clamp(threadNum / 4, 1, MaxThreadNumOther);
 }
\ No newline at end of file
@@ -24,8 +24,13 @@ namespace Pillow::Constants
 
    const int32_t MaxUIRenderItems = 1 << 8;
 
+   const int32_t MaxDrawPackets = 1 << 17;
+
    const int32_t MaxThreadNumRenderer = 4, MaxThreadNumOther = 8;
 
+   // The threads of the job system. The other numbers are the jobs a frame of each subsystem is split into,
+   // they all run on the threads of the job system.
+   extern int32_t ThreadNumJobs;
    extern int32_t ThreadNumRenderer, ThreadNumPhysics, ThreadNumTick;
 
    void SetThreadNumbers();
@@ -0,0 +1,416 @@
+#include "CookedTexture.h"
+#include "TextureCompression.h"
+#include "fstream"
+#include "vector"
+#include "cstring"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   ForceInline int64_t GetPayloadAlignedSize(int64_t size)
+   {
+      return (size + CookedPayloadAlignment - 1) / CookedPayloadAlignment * CookedPayloadAlignment;
+   }
+
+   const CookedTextureHeader& ReadHeader(const MappedFile& file)
+   {
+      if (file.GetSize() < int64_t(sizeof(CookedTextureHeader))) throw std::runtime_error("Invalid .ptex file");
+      const CookedTextureHeader& header = *reinterpret_cast<const CookedTextureHeader*>(file.GetData());
+      if (header.Magic != CookedTextureMagic) throw std::runtime_error("Invalid .ptex file");
+      if (header.Version != CookedTextureVersion) throw std::runtime_error("Unsupported .ptex version");
+      return header;
+   }
+
+   GenericTextureInfo ReadInfo(const MappedFile& file)
+   {
+      const CookedTextureHeader& header = ReadHeader(file);
+      bool wrongHeader = header.Format >= GenericTexFmt::Count || header.Compression >= CompressionMode::Count;
+      wrongHeader |= header.PlaneCount != 1 || header.ArrayCount == 0 || (header.IsCubemap && header.ArrayCount % 6);
+      if (wrongHeader) throw std::runtime_error("Invalid .ptex header");
+      GenericTextureInfo info(header.Format, header.Width, header.MipCount > 1, header.Compression, header.IsCubemap,
+         header.ArrayCount / (header.IsCubemap ? 6 : 1), header.IsSRGB);
+      if (info.GetMipCount() != header.MipCount) throw std::runtime_error("Invalid .ptex header");
+      return info;
+   }
+
+   // The layout of a mip level in the upload path, without the offset.
+   CookedSubresource ComputeLayout(const GenericTextureInfo& info, int32_t mip)
+   {
+      const int32_t width = info.GetMipWidth(mip);
+      if (info.GetCompressionMode() == CompressionMode::None)
+      {
+         return CookedSubresource{ 0, uint32_t(width * info.GetPixelSize()), uint32_t(info.GetMipSize(mip)) };
+      }
+      const int32_t blocks = GetBlockCount(info.GetCompressionMode(), width);
+      const int32_t blockSize = GetBlockSize(info.GetFormat(), info.GetCompressionMode());
+      return CookedSubresource{ 0, uint32_t(blocks * blockSize), uint32_t(GetCompressedMipSize(info.GetFormat(), info.GetCompressionMode(), width)) };
+   }
+
+   // The bytes of a mip level in .dds and .ktx2 files, the levels under 4x4 included.
+   int64_t GetFileMipSize(const GenericTextureInfo& info, int32_t width)
+   {
+      if (info.GetCompressionMode() == CompressionMode::None) return int64_t(width) * width * info.GetPixelSize();
+      return GetCompressedMipSize(info.GetFormat(), info.GetCompressionMode(), width);
+   }
+
+   GenericTextureInfo ReadPTEX(const MappedFile& file, std::vector<CookedSubresource>& table)
+   {
+      const GenericTextureInfo info = ReadInfo(file);
+      const CookedTextureHeader& header = ReadHeader(file);
+      const int32_t count = int32_t(info.GetArrayCount()) * info.GetMipCount();
+      const int64_t tableEnd = sizeof(CookedTextureHeader) + int64_t(count) * sizeof(CookedSubresource);
+      if (header.SubresourceCount != uint32_t(count) || file.GetSize() < tableEnd) throw std::runtime_error("Invalid .ptex subresource table");
+      const CookedSubresource* layouts = reinterpret_cast<const CookedSubresource*>(file.GetData() + sizeof(CookedTextureHeader));
+      const uint64_t fileSize = uint64_t(file.GetSize());
+      for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+      {
+         for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+         {
+            const CookedSubresource expected = ComputeLayout(info, mip);
+            const CookedSubresource& layout = layouts[slice * info.GetMipCount() + mip];
+            bool wrongLayout = layout.RowPitch != expected.RowPitch || layout.Size != expected.Size;
+            wrongLayout |= layout.Offset < uint64_t(tableEnd) || layout.Offset % CookedPayloadAlignment;
+            // Subtracted rather than added, a huge offset would wrap the sum around.
+            wrongLayout |= layout.Offset > fileSize || layout.Size > fileSize - layout.Offset;
+            if (wrongLayout) throw std::runtime_error("Invalid .ptex subresource table");
+         }
+      }
+      table.assign(layouts, layouts + count);
+      return info;
+   }
+
+   // A DXGI_FORMAT or VkFormat, and the format of GenericTextureInfo it stands for.
+   struct FormatMapping
+   {
+      uint32_t Code;
+      GenericTexFmt Format;
+      CompressionMode Compression;
+      bool IsSRGB;
+   };
+
+   const FormatMapping DXGIFormats[]
+   {
+      { 10, GenericTexFmt::Float_R16G16B16A16, CompressionMode::None, false }, // R16G16B16A16_FLOAT
+      { 26, GenericTexFmt::Float_R11G11B10, CompressionMode::None, false }, // R11G11B10_FLOAT
+      { 28, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::None, false }, // R8G8B8A8_UNORM
+      { 29, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::None, true }, // R8G8B8A8_UNORM_SRGB
+      { 49, GenericTexFmt::UnsignedNormalized_R8G8, CompressionMode::None, false }, // R8G8_UNORM
+      { 61, GenericTexFmt::UnsignedNormalized_R8, CompressionMode::None, false }, // R8_UNORM
+      { 71, GenericTexFmt::UnsignedNormalized_R8G8B8, CompressionMode::Hardware, false }, // BC1_UNORM
+      { 72, GenericTexFmt::UnsignedNormalized_R8G8B8, CompressionMode::Hardware, true }, // BC1_UNORM_SRGB
+      { 77, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::Hardware, false }, // BC3_UNORM
+      { 78, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::Hardware, true }, // BC3_UNORM_SRGB
+      { 80, GenericTexFmt::UnsignedNormalized_R8, CompressionMode::Hardware, false }, // BC4_UNORM
+      { 83, GenericTexFmt::UnsignedNormalized_R8G8, CompressionMode::Hardware, false }, // BC5_UNORM
+      { 95, GenericTexFmt::Float_R16G16B16A16, CompressionMode::Hardware, false }, // BC6H_UF16
+      { 98, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::BC7, false }, // BC7_UNORM
+      { 99, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::BC7, true }, // BC7_UNORM_SRGB
+   };
+
+   // ASTC textures get the RGBA format, the channels of its blocks are decided by their end point modes.
+   const FormatMapping VkFormats[]
+   {
+      { 9, GenericTexFmt::UnsignedNormalized_R8, CompressionMode::None, false }, // R8_UNORM
+      { 16, GenericTexFmt::UnsignedNormalized_R8G8, CompressionMode::None, false }, // R8G8_UNORM
+      { 37, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::None, false }, // R8G8B8A8_UNORM
+      { 43, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::None, true }, // R8G8B8A8_SRGB
+      { 97, GenericTexFmt::Float_R16G16B16A16, CompressionMode::None, false }, // R16G16B16A16_SFLOAT
+      { 122, GenericTexFmt::Float_R11G11B10, CompressionMode::None, false }, // B10G11R11_UFLOAT_PACK32
+      { 131, GenericTexFmt::UnsignedNormalized_R8G8B8, CompressionMode::Hardware, false }, // BC1_RGB_UNORM_BLOCK
+      { 132, GenericTexFmt::UnsignedNormalized_R8G8B8, CompressionMode::Hardware, true }, // BC1_RGB_SRGB_BLOCK
+      { 133, GenericTexFmt::UnsignedNormalized_R8G8B8, CompressionMode::Hardware, false }, // BC1_RGBA_UNORM_BLOCK
+      { 134, GenericTexFmt::UnsignedNormalized_R8G8B8, CompressionMode::Hardware, true }, // BC1_RGBA_SRGB_BLOCK
+      { 137, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::Hardware, false }, // BC3_UNORM_BLOCK
+      { 138, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::Hardware, true }, // BC3_SRGB_BLOCK
+      { 139, GenericTexFmt::UnsignedNormalized_R8, CompressionMode::Hardware, false }, // BC4_UNORM_BLOCK
+      { 141, GenericTexFmt::UnsignedNormalized_R8G8, CompressionMode::Hardware, false }, // BC5_UNORM_BLOCK
+      { 143, GenericTexFmt::Float_R16G16B16A16, CompressionMode::Hardware, false }, // BC6H_UFLOAT_BLOCK
+      { 145, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::BC7, false }, // BC7_UNORM_BLOCK
+      { 146, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::BC7, true }, // BC7_SRGB_BLOCK
+      { 147, GenericTexFmt::UnsignedNormalized_R8G8B8, CompressionMode::ETC2, false }, // ETC2_R8G8B8_UNORM_BLOCK
+      { 148, GenericTexFmt::UnsignedNormalized_R8G8B8, CompressionMode::ETC2, true }, // ETC2_R8G8B8_SRGB_BLOCK
+      { 151, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ETC2, false }, // ETC2_R8G8B8A8_UNORM_BLOCK
+      { 152, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ETC2, true }, // ETC2_R8G8B8A8_SRGB_BLOCK
+      { 153, GenericTexFmt::UnsignedNormalized_R8, CompressionMode::ETC2, false }, // EAC_R11_UNORM_BLOCK
+      { 155, GenericTexFmt::UnsignedNormalized_R8G8, CompressionMode::ETC2, false }, // EAC_R11G11_UNORM_BLOCK
+      { 157, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ASTC4x4, false }, // ASTC_4x4_UNORM_BLOCK
+      { 158, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ASTC4x4, true }, // ASTC_4x4_SRGB_BLOCK
+      { 165, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ASTC6x6, false }, // ASTC_6x6_UNORM_BLOCK
+      { 166, GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ASTC6x6, true }, // ASTC_6x6_SRGB_BLOCK
+   };
+
+   template<size_t Count>
+   const FormatMapping& FindFormat(const FormatMapping(&mappings)[Count], uint32_t code)
+   {
+      for (const FormatMapping& mapping : mappings)
+      {
+         if (mapping.Code == code) return mapping;
+      }
+      throw std::runtime_error("The format has no GenericTexFmt counterpart.");
+   }
+
+   // The info of a .dds or .ktx2 texture. It keeps a single mip, or the full chain of GenericTextureInfo when the file has as many.
+   GenericTextureInfo CreateContainerInfo(const FormatMapping& mapping, uint32_t width, uint32_t height, uint32_t mipCount, bool bCube, uint32_t arraySize)
+   {
+      if (width != height) throw std::runtime_error("The image should be square.");
+      if (width > UINT16_MAX || arraySize == 0 || arraySize * (bCube ? 6 : 1) > uint32_t(GenericTextureInfo::MaxArraySize)) throw std::runtime_error("The texture is too large.");
+      GenericTextureInfo info(mapping.Format, int32_t(width), mipCount > 1, mapping.Compression, bCube, int32_t(arraySize), mapping.IsSRGB);
+      if (mipCount > 1 && mipCount < uint32_t(info.GetMipCount())) throw std::runtime_error("The mip chain should reach 4x4.");
+      // 2x2 and 1x1 are the only levels under 4x4.
+      if (mipCount > uint32_t(info.GetMipCount()) + 2) throw std::runtime_error("Invalid mip count");
+      return info;
+   }
+
+   struct DDSPixelFormat
+   {
+      uint32_t Size;
+      uint32_t Flags;
+      uint32_t FourCC;
+      uint32_t RGBBitCount;
+      uint32_t RBitMask;
+      uint32_t GBitMask;
+      uint32_t BBitMask;
+      uint32_t ABitMask;
+   };
+
+   struct DDSHeader
+   {
+      uint32_t Magic;
+      uint32_t Size;
+      uint32_t Flags;
+      uint32_t Height;
+      uint32_t Width;
+      uint32_t PitchOrLinearSize;
+      uint32_t Depth;
+      uint32_t MipMapCount;
+      uint32_t Reserved1[11];
+      DDSPixelFormat PixelFormat;
+      uint32_t Caps;
+      uint32_t Caps2;
+      uint32_t Caps3;
+      uint32_t Caps4;
+      uint32_t Reserved2;
+   };
+
+   struct DDSHeaderDX10
+   {
+      uint32_t DXGIFormat;
+      uint32_t ResourceDimension;
+      uint32_t MiscFlag;
+      uint32_t ArraySize;
+      uint32_t MiscFlags2;
+   };
+
+   static_assert(sizeof(DDSHeader) == 128 && sizeof(DDSHeaderDX10) == 20, "The layout of .dds is fixed.");
+
+   constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+   {
+      return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+   }
+
+   // The pixel formats of the files without the DX10 header, as the DXGI_FORMAT they are.
+   uint32_t GetLegacyDXGIFormat(const DDSPixelFormat& format)
+   {
+      const uint32_t FourCCFlag = 0x4, RGBFlag = 0x40, LuminanceFlag = 0x20000;
+      if (format.Flags & FourCCFlag)
+      {
+         switch (format.FourCC)
+         {
+         case MakeFourCC('D', 'X', 'T', '1'): return 71;
+         case MakeFourCC('D', 'X', 'T', '5'): return 77;
+         case MakeFourCC('A', 'T', 'I', '1'):
+         case MakeFourCC('B', 'C', '4', 'U'): return 80;
+         case MakeFourCC('A', 'T', 'I', '2'):
+         case MakeFourCC('B', 'C', '5', 'U'): return 83;
+         case 113: return 10; // D3DFMT_A16B16G16R16F
+         default: return 0;
+         }
+      }
+      if ((format.Flags & RGBFlag) && format.RGBBitCount == 32 && format.RBitMask == 0xFF && format.GBitMask == 0xFF00 && format.BBitMask == 0xFF0000) return 28;
+      if ((format.Flags & LuminanceFlag) && format.RGBBitCount == 8 && format.RBitMask == 0xFF) return 61;
+      return 0;
+   }
+
+   // The subresources follow the headers in SubRes[Array][Mip] order, the cubemaps have their faces as array slices.
+   GenericTextureInfo ReadDDS(const MappedFile& file, std::vector<CookedSubresource>& table)
+   {
+      if (file.GetSize() < int64_t(sizeof(DDSHeader))) throw std::runtime_error("Invalid .dds file");
+      const DDSHeader& header = *reinterpret_cast<const DDSHeader*>(file.GetData());
+      if (header.Size != sizeof(DDSHeader) - sizeof(uint32_t) || header.PixelFormat.Size != sizeof(DDSPixelFormat)) throw std::runtime_error("Invalid .dds header");
+      const uint32_t MipMapCountFlag = 0x20000, CubemapCaps = 0x200, AllFacesCaps = 0xFC00, VolumeCaps = 0x200000;
+      const uint32_t Texture2DDimension = 3, TextureCubeFlag = 0x4;
+      int64_t offset = sizeof(DDSHeader);
+      uint32_t dxgiFormat = 0, arraySize = 1;
+      bool bCube = false;
+      if ((header.PixelFormat.Flags & 0x4) && header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+      {
+         if (file.GetSize() < offset + int64_t(sizeof(DDSHeaderDX10))) throw std::runtime_error("Invalid .dds file");
+         const DDSHeaderDX10& extension = *reinterpret_cast<const DDSHeaderDX10*>(file.GetData() + offset);
+         if (extension.ResourceDimension != Texture2DDimension) throw std::runtime_error("Only the 2D .dds textures are supported.");
+         offset += sizeof(DDSHeaderDX10);
+         dxgiFormat = extension.DXGIFormat;
+         arraySize = extension.ArraySize;
+         bCube = extension.MiscFlag & TextureCubeFlag;
+      }
+      else
+      {
+         if (header.Caps2 & VolumeCaps) throw std::runtime_error("Only the 2D .dds textures are supported.");
+         if ((header.Caps2 & CubemapCaps) && (header.Caps2 & AllFacesCaps) != AllFacesCaps) throw std::runtime_error("The cubemap should have all the faces.");
+         dxgiFormat = GetLegacyDXGIFormat(header.PixelFormat);
+         bCube = header.Caps2 & CubemapCaps;
+      }
+      const uint32_t mipCount = (header.Flags & MipMapCountFlag) && header.MipMapCount > 0 ? header.MipMapCount : 1;
+      const GenericTextureInfo info = CreateContainerInfo(FindFormat(DXGIFormats, dxgiFormat), header.Width, header.Height, mipCount, bCube, arraySize);
+      table.clear();
+      table.reserve(int32_t(info.GetArrayCount()) * info.GetMipCount());
+      for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+      {
+         for (uint32_t mip = 0; mip < mipCount; mip++)
+         {
+            const int32_t width = std::max(info.GetWidth() >> mip, 1);
+            if (mip < uint32_t(info.GetMipCount()))
+            {
+               CookedSubresource layout = ComputeLayout(info, int32_t(mip));
+               layout.Offset = uint64_t(offset);
+               table.push_back(layout);
+            }
+            offset += GetFileMipSize(info, width);
+         }
+      }
+      if (offset > file.GetSize()) throw std::runtime_error("Invalid .dds file");
+      return info;
+   }
+
+   struct KTX2Header
+   {
+      uint8_t Identifier[12];
+      uint32_t VkFormat;
+      uint32_t TypeSize;
+      uint32_t PixelWidth;
+      uint32_t PixelHeight;
+      uint32_t PixelDepth;
+      uint32_t LayerCount;
+      uint32_t FaceCount;
+      uint32_t LevelCount;
+      uint32_t SupercompressionScheme;
+      uint32_t DFDByteOffset;
+      uint32_t DFDByteLength;
+      uint32_t KVDByteOffset;
+      uint32_t KVDByteLength;
+      uint64_t SGDByteOffset;
+      uint64_t SGDByteLength;
+   };
+
+   struct KTX2Level
+   {
+      uint64_t ByteOffset;
+      uint64_t ByteLength;
+      uint64_t UncompressedByteLength;
+   };
+
+   static_assert(sizeof(KTX2Header) == 80 && sizeof(KTX2Level) == 24, "The layout of .ktx2 is fixed.");
+
+   const uint8_t KTX2Identifier[12]{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+   // The level index lists the mips from the largest. A level holds the images of all the layers, and all the faces of every layer.
+   GenericTextureInfo ReadKTX2(const MappedFile& file, std::vector<CookedSubresource>& table)
+   {
+      if (file.GetSize() < int64_t(sizeof(KTX2Header))) throw std::runtime_error("Invalid .ktx2 file");
+      const KTX2Header& header = *reinterpret_cast<const KTX2Header*>(file.GetData());
+      if (header.SupercompressionScheme != 0) throw std::runtime_error("Supercompressed .ktx2 files aren't supported.");
+      if (header.PixelDepth > 1 || (header.FaceCount != 1 && header.FaceCount != 6)) throw std::runtime_error("Only the 2D .ktx2 textures are supported.");
+      const uint32_t levelCount = std::max(header.LevelCount, 1u);
+      const uint32_t layerCount = std::max(header.LayerCount, 1u);
+      if (file.GetSize() < int64_t(sizeof(KTX2Header) + levelCount * sizeof(KTX2Level))) throw std::runtime_error("Invalid .ktx2 file");
+      const GenericTextureInfo info = CreateContainerInfo(FindFormat(VkFormats, header.VkFormat), header.PixelWidth, header.PixelHeight, levelCount,
+         header.FaceCount == 6, layerCount);
+      const KTX2Level* levels = reinterpret_cast<const KTX2Level*>(file.GetData() + sizeof(KTX2Header));
+      const uint64_t fileSize = uint64_t(file.GetSize());
+      for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+      {
+         const uint64_t imageSize = uint64_t(GetFileMipSize(info, info.GetMipWidth(mip)));
+         bool wrongLevel = levels[mip].ByteLength != imageSize * info.GetArrayCount();
+         // Subtracted rather than added, a huge offset would wrap the sum around.
+         wrongLevel |= levels[mip].ByteOffset > fileSize || levels[mip].ByteLength > fileSize - levels[mip].ByteOffset;
+         if (wrongLevel) throw std::runtime_error("Invalid .ktx2 level index");
+      }
+      table.clear();
+      table.reserve(int32_t(info.GetArrayCount()) * info.GetMipCount());
+      for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+      {
+         for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+         {
+            CookedSubresource layout = ComputeLayout(info, mip);
+            layout.Offset = levels[mip].ByteOffset + uint64_t(slice) * layout.Size;
+            table.push_back(layout);
+         }
+      }
+      return info;
+   }
+
+   GenericTextureInfo ReadContainer(const MappedFile& file, std::vector<CookedSubresource>& table)
+   {
+      if (file.GetSize() >= 4 && !std::memcmp(file.GetData(), "DDS ", 4)) return ReadDDS(file, table);
+      if (file.GetSize() >= 12 && !std::memcmp(file.GetData(), KTX2Identifier, 12)) return ReadKTX2(file, table);
+      return ReadPTEX(file, table);
+   }
+}
+
+CookedTexture::CookedTexture(const string& path) :
+   file(path),
+   Info(ReadContainer(file, table))
+{
+}
+
+void Pillow::Graphics::CookTexture(const GenericTexture& texture, const string& path, EncodeQuality quality, int32_t threadCount)
+{
+   const GenericTextureInfo& info = texture.Info;
+   // The payloads are consecutive in SubRes[Array][Mip] order, either the texels or their BC blocks.
+   const uint8_t* payload = reinterpret_cast<const uint8_t*>(texture.Data.get());
+   std::unique_ptr<CacheLine[]> blocks;
+   if (info.GetCompressionMode() != CompressionMode::None)
+   {
+      blocks = CreateAlignedMemory(int64_t(info.GetArrayCount()) * GetCompressedArraySliceSize(info));
+      CompressTexture(payload, reinterpret_cast<uint8_t*>(blocks.get()), info, quality, threadCount);
+      payload = reinterpret_cast<const uint8_t*>(blocks.get());
+   }
+   // Lay out the subresource table.
+   const int32_t count = int32_t(info.GetArrayCount()) * info.GetMipCount();
+   std::vector<CookedSubresource> table;
+   table.reserve(count);
+   int64_t offset = GetPayloadAlignedSize(sizeof(CookedTextureHeader) + int64_t(count) * sizeof(CookedSubresource));
+   const CookedTextureHeader header{ CookedTextureMagic, CookedTextureVersion, info.GetWidth(), info.GetFormat(), info.GetCompressionMode(),
+      info.GetMipCount(), info.GetArrayCount(), 1, info.GetIsCubemap(), info.GetIsSRGB(), 0, uint32_t(count), uint32_t(offset) };
+   for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+   {
+      for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+      {
+         CookedSubresource layout = ComputeLayout(info, mip);
+         layout.Offset = uint64_t(offset);
+         offset = GetPayloadAlignedSize(offset + layout.Size);
+         table.push_back(layout);
+      }
+   }
+   // Write the file, padding every payload to its offset.
+   std::ofstream file(path, std::ios::binary | std::ios::trunc);
+   if (!file.is_open()) throw std::runtime_error("Unable to create file");
+   const char padding[CookedPayloadAlignment]{};
+   int64_t position = sizeof(CookedTextureHeader) + int64_t(count) * sizeof(CookedSubresource);
+   file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   file.write(reinterpret_cast<const char*>(table.data()), int64_t(count) * sizeof(CookedSubresource));
+   for (const CookedSubresource& layout : table)
+   {
+      file.write(padding, int64_t(layout.Offset) - position);
+      file.write(reinterpret_cast<const char*>(payload), layout.Size);
+      payload += layout.Size;
+      position = int64_t(layout.Offset) + layout.Size;
+   }
+   if (!file) throw std::runtime_error("Error writing file");
+}
+
+std::unique_ptr<CookedTexture> Pillow::Graphics::LoadCookedTexture(const string& relativePath)
+{
+   return std::make_unique<CookedTexture>(GetResourcePath(relativePath));
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <span>
+#include "Auxiliaries.h"
+#include "Texture.h"
+
+namespace Pillow::Graphics
+{
+   //                    Cooked Texture Container(.ptex)                    //
+   //                                                                       //
+   // [CookedTextureHeader][CookedSubresource * SubresourceCount][Payloads] //
+   //                                                                       //
+   // 1.The subresource table follows the D3D12 order: SubRes[Plane][Array][Mip].
+   // 2.The payloads are encoded blocks of the CompressionMode, or raw texels with CompressionMode::None.
+   // 3.Every payload starts at a multiple of CookedPayloadAlignment in the file, which is
+   //   D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, so the mapped spans go to the upload path as they are.
+   // 4.All the numbers are little-endian, as on all the target platforms.
+   const uint32_t CookedTextureMagic = 'P' | 'T' << 8 | 'E' << 16 | 'X' << 24;
+   const uint16_t CookedTextureVersion = 1;
+   const int32_t CookedPayloadAlignment = 512;
+
+   struct CookedTextureHeader
+   {
+      uint32_t Magic;
+      uint16_t Version;
+      uint16_t Width;
+      GenericTexFmt Format;
+      CompressionMode Compression;
+      uint8_t MipCount;
+      uint8_t ArrayCount; // Including the 6 faces of cubemaps.
+      uint8_t PlaneCount;
+      bool IsCubemap;
+      bool IsSRGB;
+      uint8_t Reserved;
+      uint32_t SubresourceCount;
+      uint32_t PayloadOffset; // The first payload, after the header and the subresource table.
+   };
+
+   struct CookedSubresource
+   {
+      uint64_t Offset; // From the start of the file.
+      uint32_t RowPitch; // Bytes per row of texels, or per row of blocks.
+      uint32_t Size;
+   };
+
+   static_assert(sizeof(CookedTextureHeader) == 24 && sizeof(CookedSubresource) == 16, "The layout of .ptex is fixed.");
+
+   // A .ptex, .dds or .ktx2 file mapped into memory. The payloads are read in place, nothing is copied or decoded at load time.
+   // The .dds(the DX10 header included) and .ktx2 files are laid out into the same subresource table as .ptex:
+   // 1.The format should have a GenericTexFmt and CompressionMode counterpart, e.g. BC1, BC3, BC4, BC5, BC6H_UF16, BC7,
+   //   ETC2 / EAC, ASTC 4x4 / 6x6, or the uncompressed formats. The other formats throw.
+   // 2.The texture should be square, and have a single mip or at least the full chain down to 4x4, the smaller mips are ignored.
+   // 3.Their payloads aren't aligned to CookedPayloadAlignment, the copies of the upload paths don't need it.
+   // 4.Supercompressed .ktx2 files(BasisLZ, zstd) aren't supported.
+   class CookedTexture
+   {
+      DeleteDefautedMethods(CookedTexture)
+
+   private:
+      const MappedFile file;
+      std::vector<CookedSubresource> table;
+
+   public:
+      const GenericTextureInfo Info;
+
+      // The container is recognized by its magic. The header and the subresource table are validated, the payloads aren't touched.
+      CookedTexture(const string& path);
+
+      ForceInline int32_t GetSubresourceCount() const { return int32_t(Info.GetArrayCount()) * Info.GetMipCount(); }
+      ForceInline const CookedSubresource& GetLayout(int32_t arraySlice, int32_t mip) const { return table[arraySlice * Info.GetMipCount() + mip]; }
+      ForceInline std::span<const uint8_t> GetSubresource(int32_t arraySlice, int32_t mip) const
+      {
+         const CookedSubresource& layout = GetLayout(arraySlice, mip);
+         return std::span<const uint8_t>(file.GetData() + layout.Offset, layout.Size);
+      }
+   };
+
+   // Encode a texture with its own CompressionMode, and write it to path as a .ptex file.
+   // The block compression runs at quality on threadCount workers(0 = all hardware threads).
+   void CookTexture(const GenericTexture& texture, const string& path, EncodeQuality quality = EncodeQuality::Normal, int32_t threadCount = 0);
+
+   // Map a .ptex, .dds or .ktx2 file.
+   std::unique_ptr<CookedTexture> LoadCookedTexture(const string& relativePath);
+}
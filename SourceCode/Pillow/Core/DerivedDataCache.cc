@@ -0,0 +1,190 @@
+#include "DerivedDataCache.h"
+#include "CookedTexture.h"
+#include "HashLib/sha256.h"
+#include "vector"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+using namespace std::filesystem;
+
+namespace
+{
+   // Bump it when the decoder, the mip filter or the encoders change, so the stale entries are no longer found.
+   const uint32_t DerivedDataVersion = 2;
+
+   // The import settings hashed after the source bytes.
+   struct KeySettings
+   {
+      uint32_t DataVersion;
+      uint16_t ContainerVersion;
+      uint16_t Width;
+      GenericTexFmt Format;
+      CompressionMode Compression;
+      uint8_t MipCount;
+      uint8_t ArrayCount;
+      bool IsCubemap;
+      bool IsSRGB;
+      EncodeQuality Quality;
+      uint8_t Reserved;
+   };
+
+   static_assert(sizeof(KeySettings) == 16, "Padding bytes would be hashed.");
+
+   // Strings are UTF-8 in Pillow Basics, while a narrow path is in the system code page on Win.
+   ForceInline path ToPath(const string& text)
+   {
+      return path(std::u8string(text.begin(), text.end()));
+   }
+}
+
+DerivedDataCache::DerivedDataCache(const string& directory, int64_t capacity) :
+   _Directory(ToPath(directory)),
+   _Capacity(capacity)
+{
+   create_directories(_Directory);
+   // Order the entries by their last use, and clear the temporary files of interrupted writes.
+   std::vector<std::pair<file_time_type, Entry>> found;
+   for (const directory_entry& file : recursive_directory_iterator(_Directory))
+   {
+      if (!file.is_regular_file()) continue;
+      const path& filePath = file.path();
+      if (filePath.extension() == ".tmp")
+      {
+         std::error_code error;
+         remove(filePath, error);
+      }
+      else if (filePath.extension() == ".cache" && filePath.stem().string().size() == SHA256::HashBytes * 2)
+      {
+         found.emplace_back(file.last_write_time(), Entry{ filePath.stem().string(), int64_t(file.file_size()) });
+      }
+   }
+   std::sort(found.begin(), found.end(), [](const auto& left, const auto& right) { return left.first > right.first; });
+   for (const auto& [time, entry] : found)
+   {
+      index[entry.Key] = entries.insert(entries.end(), entry);
+      totalSize += entry.Size;
+   }
+   EvictOverCapacity();
+}
+
+string DerivedDataCache::ComputeKey(const uint8_t* source, int64_t sourceSize, const GenericTextureInfo& info, EncodeQuality quality)
+{
+   const KeySettings settings{ DerivedDataVersion, CookedTextureVersion, info.GetWidth(), info.GetFormat(), info.GetCompressionMode(),
+      info.GetMipCount(), info.GetArrayCount(), info.GetIsCubemap(), info.GetIsSRGB(), quality, 0 };
+   SHA256 hash;
+   hash.add(source, size_t(sourceSize));
+   hash.add(&settings, sizeof(settings));
+   return hash.getHash();
+}
+
+bool DerivedDataCache::Fetch(const string& key, const string& destinationPath)
+{
+   {
+      std::lock_guard guard(lock);
+      auto it = index.find(key);
+      if (it == index.end())
+      {
+         misses++;
+         return false;
+      }
+      entries.splice(entries.begin(), entries, it->second);
+   }
+   // Copy outside the lock, so the fetches don't wait for each other.
+   const path entryPath = GetEntryPath(key);
+   std::error_code error;
+   copy_file(entryPath, ToPath(destinationPath), copy_options::overwrite_existing, error);
+   if (error)
+   {
+      // Evicted meanwhile, or deleted from outside.
+      std::lock_guard guard(lock);
+      auto it = index.find(key);
+      if (it != index.end() && !exists(entryPath))
+      {
+         totalSize -= it->second->Size;
+         entries.erase(it->second);
+         index.erase(it);
+      }
+      misses++;
+      return false;
+   }
+   last_write_time(entryPath, file_time_type::clock::now(), error);
+   hits++;
+   return true;
+}
+
+void DerivedDataCache::Store(const string& key, const string& sourcePath)
+{
+   const path entryPath = GetEntryPath(key);
+   // Other threads or processes may store the same key, so every write has its own temporary file.
+   const string suffix = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "." + std::to_string(temporaryCount++) + ".tmp";
+   const path temporaryPath = entryPath.parent_path() / (key + "." + suffix);
+   std::error_code error;
+   create_directories(entryPath.parent_path(), error);
+   copy_file(ToPath(sourcePath), temporaryPath, copy_options::overwrite_existing, error);
+   const int64_t size = error ? 0 : int64_t(file_size(temporaryPath, error));
+   if (error)
+   {
+      remove(temporaryPath, error);
+      throw std::runtime_error("Unable to store the cache entry");
+   }
+   {
+      std::lock_guard guard(lock);
+      // The rename replaces an existing entry atomically.
+      rename(temporaryPath, entryPath);
+      Insert(key, size);
+      EvictOverCapacity();
+   }
+   stores++;
+}
+
+DerivedDataCacheStats DerivedDataCache::GetStats()
+{
+   std::lock_guard guard(lock);
+   return DerivedDataCacheStats{ hits, misses, stores, evictions, int64_t(entries.size()), totalSize };
+}
+
+path DerivedDataCache::GetEntryPath(const string& key) const
+{
+   // 256 sub folders keep the folders small.
+   return _Directory / key.substr(0, 2) / (key + ".cache");
+}
+
+void DerivedDataCache::Insert(const string& key, int64_t size)
+{
+   auto it = index.find(key);
+   if (it != index.end())
+   {
+      totalSize -= it->second->Size;
+      entries.erase(it->second);
+   }
+   entries.push_front(Entry{ key, size });
+   index[key] = entries.begin();
+   totalSize += size;
+}
+
+void DerivedDataCache::EvictOverCapacity()
+{
+   // The newest entry always stays, even if it's larger than the capacity.
+   while (totalSize > _Capacity && entries.size() > 1)
+   {
+      const Entry& oldest = entries.back();
+      std::error_code error;
+      remove(GetEntryPath(oldest.Key), error);
+      totalSize -= oldest.Size;
+      index.erase(oldest.Key);
+      entries.pop_back();
+      evictions++;
+   }
+}
+
+bool Pillow::Graphics::ImportTexture(DerivedDataCache& cache, const string& sourcePath, const string& destinationPath, bool bSRGB, CompressionMode compMode, EncodeQuality quality)
+{
+   const MappedFile source(sourcePath);
+   const GenericTextureInfo info = InspectTexture(source.GetData(), source.GetSize(), bSRGB, compMode);
+   const string key = DerivedDataCache::ComputeKey(source.GetData(), source.GetSize(), info, quality);
+   if (cache.Fetch(key, destinationPath)) return true;
+   auto texture = DecodeTexture(source.GetData(), source.GetSize(), bSRGB, compMode);
+   CookTexture(*texture, destinationPath, quality);
+   cache.Store(key, destinationPath);
+   return false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include "Auxiliaries.h"
+#include "Texture.h"
+
+namespace Pillow::Graphics
+{
+   struct DerivedDataCacheStats
+   {
+      int64_t Hits{};
+      int64_t Misses{};
+      int64_t Stores{};
+      int64_t Evictions{};
+      int64_t EntryCount{};
+      int64_t TotalSize{};
+   };
+
+   // A local on-disk store of cooked files, addressed by the SHA-256 of their source bytes and import settings.
+   // 1.Entries are written to temporary files first, then renamed, so a crash never leaves a partial entry.
+   // 2.When the total size exceeds the capacity, the least recently used entries are evicted.
+   //   The last write time of an entry marks its last use, so the order survives between runs.
+   // 3.All the methods are thread safe.
+   class DerivedDataCache
+   {
+      DeleteDefautedMethods(DerivedDataCache)
+         ReadonlyProperty(std::filesystem::path, Directory)
+         ReadonlyProperty(int64_t, Capacity)
+
+   public:
+      // Scan the existing entries of the directory, which is created if needed.
+      DerivedDataCache(const string& directory, int64_t capacity);
+
+      // 64 hex characters.
+      static string ComputeKey(const uint8_t* source, int64_t sourceSize, const GenericTextureInfo& info, EncodeQuality quality = EncodeQuality::Normal);
+
+      // Copy the entry of key to destinationPath. Returns false on a miss.
+      bool Fetch(const string& key, const string& destinationPath);
+      // Copy the file at sourcePath into the cache as the entry of key.
+      void Store(const string& key, const string& sourcePath);
+
+      DerivedDataCacheStats GetStats();
+
+   private:
+      struct Entry
+      {
+         string Key;
+         int64_t Size;
+      };
+
+      std::mutex lock;
+      // The most recently used entries are at the front.
+      std::list<Entry> entries;
+      std::unordered_map<string, std::list<Entry>::iterator> index;
+      int64_t totalSize{};
+      std::atomic<int64_t> hits{}, misses{}, stores{}, evictions{};
+      std::atomic<int32_t> temporaryCount{};
+
+      std::filesystem::path GetEntryPath(const string& key) const;
+      void Insert(const string& key, int64_t size);
+      void EvictOverCapacity();
+   };
+
+   // Cook a PNG file into a .ptex file at destinationPath through the cache.
+   // On a hit the source is only hashed and the entry is copied. Returns true on a hit.
+   bool ImportTexture(DerivedDataCache& cache, const string& sourcePath, const string& destinationPath,
+      bool bSRGB = false, CompressionMode compMode = CompressionMode::HardwareWithDithering, EncodeQuality quality = EncodeQuality::Normal);
+}
@@ -0,0 +1,326 @@
+#include "JobSystem.h"
+#include <deque>
+#include <thread>
+
+using namespace Pillow;
+using namespace std::chrono;
+
+namespace
+{
+   // The rounds an idle thread spins before parking, the jobs of a frame usually arrive within it.
+   const int32_t SpinLimit = 256;
+   const int32_t PriorityCount = int32_t(JobPriority::Count);
+
+   thread_local int32_t threadIndex = -1;
+
+   struct Job
+   {
+      // Shared by the jobs of a batch.
+      std::shared_ptr<const std::function<void(int32_t)>> Function;
+      int32_t Index;
+      JobCounter* Counter;
+   };
+
+   struct alignas(64) JobQueue
+   {
+      std::mutex Lock;
+      std::deque<Job> Jobs[PriorityCount];
+   };
+
+   struct alignas(64) ThreadCounters
+   {
+      std::atomic<uint64_t> Executed;
+      std::atomic<uint64_t> Stolen;
+      std::atomic<int64_t> BusyNanoseconds;
+      std::atomic<int64_t> SpinNanoseconds;
+      std::atomic<int64_t> ParkNanoseconds;
+      std::atomic<uint64_t> SpinWakeups;
+      std::atomic<uint64_t> ParkWakeups;
+   };
+
+   ForceInline int64_t GetNanoseconds(steady_clock::time_point start)
+   {
+      return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+   }
+}
+
+class Pillow::JobScheduler
+{
+   DeleteDefautedMethods(JobScheduler)
+
+public:
+   const int32_t ThreadCount;
+
+   JobScheduler(int32_t threadCount) :
+      ThreadCount(threadCount),
+      queues(std::make_unique<JobQueue[]>(threadCount + 1)),
+      counters(std::make_unique<ThreadCounters[]>(threadCount + 1))
+   {
+      signal_IsActive.store(true);
+      workers.reserve(threadCount);
+      for (int32_t i = 0; i < threadCount; i++) workers.emplace_back(&JobScheduler::Worker, this, i);
+   }
+
+   ~JobScheduler()
+   {
+      signal_IsActive.store(false, std::memory_order::release);
+      Wake(true);
+      for (auto& thread : workers) thread.join();
+   }
+
+   void Submit(int32_t count, std::function<void(int32_t)>&& function, JobCounter* counter, JobPriority priority)
+   {
+      if (count <= 0) return;
+      if (counter) counter->Add(count);
+      auto shared = std::make_shared<const std::function<void(int32_t)>>(std::move(function));
+      // Counted ahead, so the count never falls behind the queues.
+      queuedJobs[int32_t(priority)].fetch_add(count, std::memory_order::release);
+      const int32_t self = threadIndex;
+      JobQueue& queue = queues[self < 0 ? ThreadCount : self];
+      {
+         std::lock_guard guard(queue.Lock);
+         auto& jobs = queue.Jobs[int32_t(priority)];
+         // The owner takes the back and the thieves take the front, so the owner starts with job 0 and the thieves with the last ones.
+         // The queue of the outside threads is taken from the front only.
+         if (self < 0) for (int32_t i = 0; i < count; i++) jobs.push_back(Job{ shared, i, counter });
+         else for (int32_t i = count - 1; i >= 0; i--) jobs.push_back(Job{ shared, i, counter });
+      }
+      Wake(count > 1);
+   }
+
+   void Wait(JobCounter& counter)
+   {
+      const int32_t self = threadIndex;
+      while (true)
+      {
+         const uint32_t epoch = signal_Epoch.load(std::memory_order::acquire);
+         if (counter.IsFinished()) break;
+         if (TryRunJob(self)) continue;
+         Idle(epoch, self);
+      }
+      std::exception_ptr error;
+      {
+         std::lock_guard guard(counter.errorLock);
+         error = std::exchange(counter.error, nullptr);
+      }
+      if (error) std::rethrow_exception(error);
+   }
+
+   JobStats GetStats(int32_t self) const
+   {
+      const ThreadCounters& thread = counters[self < 0 ? ThreadCount : self];
+      JobStats stats{};
+      stats.Executed = thread.Executed.load(std::memory_order::relaxed);
+      stats.Stolen = thread.Stolen.load(std::memory_order::relaxed);
+      stats.BusyMilliseconds = thread.BusyNanoseconds.load(std::memory_order::relaxed) / 1e6;
+      stats.SpinMilliseconds = thread.SpinNanoseconds.load(std::memory_order::relaxed) / 1e6;
+      stats.ParkMilliseconds = thread.ParkNanoseconds.load(std::memory_order::relaxed) / 1e6;
+      stats.SpinWakeups = thread.SpinWakeups.load(std::memory_order::relaxed);
+      stats.ParkWakeups = thread.ParkWakeups.load(std::memory_order::relaxed);
+      return stats;
+   }
+
+private:
+   std::unique_ptr<JobQueue[]> queues; // A queue per worker thread, and the last one of the outside threads.
+   std::unique_ptr<ThreadCounters[]> counters; // The same layout as the queues.
+   std::atomic<int32_t> queuedJobs[PriorityCount]{};
+   // Bumped by every submission and by every finished counter, the idle threads are parked on it.
+   std::atomic<uint32_t> signal_Epoch{};
+   std::atomic<bool> signal_IsActive{};
+   std::vector<std::thread> workers;
+
+   void Wake(bool all)
+   {
+      signal_Epoch.fetch_add(1, std::memory_order::release);
+      if (all) signal_Epoch.notify_all();
+      else signal_Epoch.notify_one();
+   }
+
+   void Worker(int32_t self)
+   {
+      threadIndex = self;
+      while (true)
+      {
+         const uint32_t epoch = signal_Epoch.load(std::memory_order::acquire);
+         if (TryRunJob(self)) continue;
+         // The queues are drained before quitting.
+         if (!signal_IsActive.load(std::memory_order::acquire)) return;
+         Idle(epoch, self);
+      }
+   }
+
+   // Spin, then park until the epoch changes.
+   void Idle(uint32_t epoch, int32_t self)
+   {
+      // The outside threads share their counters, hence the atomic additions.
+      ThreadCounters& thread = counters[self < 0 ? ThreadCount : self];
+      const auto start = steady_clock::now();
+      for (int32_t i = 0; i < SpinLimit && signal_Epoch.load(std::memory_order::acquire) == epoch; i++) SpinPause();
+      const auto parked = steady_clock::now();
+      thread.SpinNanoseconds.fetch_add(duration_cast<nanoseconds>(parked - start).count(), std::memory_order::relaxed);
+      if (signal_Epoch.load(std::memory_order::acquire) != epoch)
+      {
+         thread.SpinWakeups.fetch_add(1, std::memory_order::relaxed);
+         return;
+      }
+      signal_Epoch.wait(epoch, std::memory_order::acquire);
+      thread.ParkNanoseconds.fetch_add(GetNanoseconds(parked), std::memory_order::relaxed);
+      thread.ParkWakeups.fetch_add(1, std::memory_order::relaxed);
+   }
+
+   bool TryPop(JobQueue& queue, int32_t priority, bool fromBack, Job& job)
+   {
+      std::lock_guard guard(queue.Lock);
+      auto& jobs = queue.Jobs[priority];
+      if (jobs.empty()) return false;
+      if (fromBack)
+      {
+         job = std::move(jobs.back());
+         jobs.pop_back();
+      }
+      else
+      {
+         job = std::move(jobs.front());
+         jobs.pop_front();
+      }
+      return true;
+   }
+
+   bool TryRunJob(int32_t self)
+   {
+      Job job{};
+      bool stolen = false, found = false;
+      for (int32_t priority = 0; priority < PriorityCount && !found; priority++)
+      {
+         if (queuedJobs[priority].load(std::memory_order::acquire) <= 0) continue;
+         // Its own newest job, then the oldest jobs of the outside threads, then the oldest jobs of the other workers.
+         found = (self >= 0 && TryPop(queues[self], priority, true, job)) || TryPop(queues[ThreadCount], priority, false, job);
+         for (int32_t i = 1; i <= ThreadCount && !found; i++)
+         {
+            const int32_t victim = (std::max(self, 0) + i) % ThreadCount;
+            if (victim != self) found = stolen = TryPop(queues[victim], priority, false, job);
+         }
+         if (found) queuedJobs[priority].fetch_sub(1, std::memory_order::relaxed);
+      }
+      if (!found) return false;
+      ThreadCounters& thread = counters[self < 0 ? ThreadCount : self];
+      const auto start = steady_clock::now();
+      std::exception_ptr error;
+      try
+      {
+         (*job.Function)(job.Index);
+      }
+      catch (...)
+      {
+         error = std::current_exception();
+      }
+      job.Function.reset();
+      thread.BusyNanoseconds.fetch_add(GetNanoseconds(start), std::memory_order::relaxed);
+      thread.Executed.fetch_add(1, std::memory_order::relaxed);
+      if (stolen) thread.Stolen.fetch_add(1, std::memory_order::relaxed);
+      if (job.Counter)
+      {
+         // The waiters of a finished counter may be parked.
+         if (job.Counter->Finish(error)) Wake(true);
+      }
+      else if (error)
+      {
+         try
+         {
+            std::rethrow_exception(error);
+         }
+         catch (const std::exception& exception)
+         {
+            LogSystem(string("A job without a counter threw: ") + exception.what());
+         }
+         catch (...)
+         {
+            LogSystem("A job without a counter threw an unknown exception.");
+         }
+      }
+      return true;
+   }
+};
+
+namespace
+{
+   std::unique_ptr<JobScheduler> scheduler;
+
+   ForceInline JobScheduler& GetScheduler()
+   {
+      if (!scheduler) throw std::runtime_error("The job system isn't initialized.");
+      return *scheduler;
+   }
+}
+
+JobCounter::JobCounter(JobCounter* parent) :
+   pending(0),
+   parent(parent)
+{
+}
+
+void JobCounter::Add(int32_t count)
+{
+   if (pending.fetch_add(count, std::memory_order::acq_rel) == 0 && parent) parent->Add(1);
+}
+
+bool JobCounter::Finish(const std::exception_ptr& jobError)
+{
+   // The errors go up the chain right away, a finished counter may be destroyed by its waiter at once.
+   if (jobError)
+   {
+      for (JobCounter* counter = this; counter; counter = counter->parent)
+      {
+         std::lock_guard guard(counter->errorLock);
+         if (!counter->error) counter->error = jobError;
+      }
+   }
+   JobCounter* const parentCounter = parent;
+   if (pending.fetch_sub(1, std::memory_order::acq_rel) != 1) return false;
+   if (parentCounter) parentCounter->Finish(nullptr);
+   return true;
+}
+
+void Pillow::InitializeJobSystem(int32_t threadCount)
+{
+   if (scheduler) throw std::runtime_error("The job system has already been initialized.");
+   if (threadCount <= 0) threadCount = std::max(int32_t(std::thread::hardware_concurrency()) - 1, 1);
+   scheduler = std::make_unique<JobScheduler>(threadCount);
+}
+
+void Pillow::TerminateJobSystem()
+{
+   scheduler.reset();
+}
+
+int32_t Pillow::GetJobThreadCount()
+{
+   return scheduler ? scheduler->ThreadCount : 0;
+}
+
+int32_t Pillow::GetJobThreadIndex()
+{
+   return threadIndex;
+}
+
+void Pillow::SubmitJob(std::function<void()> job, JobCounter* counter, JobPriority priority)
+{
+   GetScheduler().Submit(1, [job = std::move(job)](int32_t) { job(); }, counter, priority);
+}
+
+void Pillow::SubmitJobs(int32_t count, std::function<void(int32_t)> job, JobCounter* counter, JobPriority priority)
+{
+   GetScheduler().Submit(count, std::move(job), counter, priority);
+}
+
+void Pillow::WaitForCounter(JobCounter& counter)
+{
+   GetScheduler().Wait(counter);
+}
+
+JobStats Pillow::GetJobStats(int32_t threadIndex)
+{
+   JobScheduler& jobScheduler = GetScheduler();
+   if (threadIndex < -1 || threadIndex >= jobScheduler.ThreadCount) throw std::runtime_error("Invalid thread index.");
+   return jobScheduler.GetStats(threadIndex);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include "Auxiliaries.h"
+
+namespace Pillow
+{
+   class JobScheduler;
+
+   enum class JobPriority : int32_t
+   {
+      High, // The critical path of a frame, e.g. the renderer workers.
+      Normal,
+      Low, // Background work that may lag behind a few frames.
+      Count
+   };
+
+   // Counts the unfinished jobs submitted with it, the counter must outlive them.
+   // A counter with a parent keeps the parent unfinished while it has unfinished jobs, so waiting for
+   // the parent waits for the jobs of its children too. Submit to a child before its parent's jobs finish.
+   class JobCounter
+   {
+   public:
+      JobCounter(JobCounter* parent = nullptr);
+      JobCounter(const JobCounter&) = delete;
+      JobCounter(JobCounter&&) = delete;
+      JobCounter& operator=(const JobCounter&) = delete;
+      JobCounter& operator=(JobCounter&&) = delete;
+
+      ForceInline bool IsFinished() const { return pending.load(std::memory_order::acquire) == 0; }
+
+   private:
+      friend class JobScheduler;
+
+      std::atomic<int32_t> pending;
+      JobCounter* parent;
+      // The first exception thrown by the jobs, rethrown by WaitForCounter().
+      std::exception_ptr error;
+      std::mutex errorLock;
+
+      void Add(int32_t count);
+      // Returns true if the counter has finished.
+      bool Finish(const std::exception_ptr& jobError);
+   };
+
+   struct JobStats
+   {
+      uint64_t Executed{};
+      uint64_t Stolen{}; // The jobs taken from the queues of other threads.
+      double BusyMilliseconds{};
+      // The idle time, split into the spinning before parking and the parking.
+      double SpinMilliseconds{};
+      double ParkMilliseconds{};
+      uint64_t SpinWakeups{}; // The idle rounds that ended while spinning.
+      uint64_t ParkWakeups{}; // The idle rounds that parked the thread.
+   };
+
+   // A work-stealing scheduler shared by the subsystems. Every worker thread owns a queue per priority: it runs its own
+   // newest job first and steals the oldest jobs of the others when it runs dry. The threads outside the job system
+   // submit to a shared queue. Higher priorities are always taken first, across all the queues.
+   // Start threadCount worker threads(0 = all hardware threads but the calling one).
+   void InitializeJobSystem(int32_t threadCount = 0);
+   // Run all the submitted jobs and join the worker threads.
+   void TerminateJobSystem();
+   // 0 before InitializeJobSystem().
+   int32_t GetJobThreadCount();
+   // The worker thread running the caller, or -1 outside the job system.
+   int32_t GetJobThreadIndex();
+
+   // The counter is optional. The exceptions of the jobs without a counter are logged and dropped.
+   void SubmitJob(std::function<void()> job, JobCounter* counter = nullptr, JobPriority priority = JobPriority::Normal);
+   // Submit job(i) for every i in [0, count), the calling worker thread starts with the job of 0.
+   void SubmitJobs(int32_t count, std::function<void(int32_t)> job, JobCounter* counter = nullptr, JobPriority priority = JobPriority::Normal);
+   // Run other jobs until the counter finishes, then rethrow the first exception of its jobs.
+   void WaitForCounter(JobCounter& counter);
+
+   // The stats of a worker thread, or of the threads outside the job system with threadIndex = -1.
+   JobStats GetJobStats(int32_t threadIndex);
+}
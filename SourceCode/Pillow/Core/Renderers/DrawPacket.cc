@@ -0,0 +1,192 @@
+#include "Renderer.h"
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // 11-bit digits take 6 passes at most, the last digit has 9 bits.
+   const int32_t RadixBits = 11;
+   const int32_t RadixSize = 1 << RadixBits;
+   const int32_t DigitCount = (64 + RadixBits - 1) / RadixBits;
+   // The packets a job gets at least, smaller sorts don't pay for the jobs.
+   const int32_t MinPacketsPerJob = 8192;
+   // Below it, clearing and scanning the histograms costs more than a comparison sort.
+   const int32_t MinRadixSortPackets = 1536;
+
+   typedef std::array<int32_t, RadixSize> Histogram;
+
+   // Run job(i) for every i in [0, count) on the job system, or on the calling thread for a single job.
+   void RunJobs(int32_t count, const std::function<void(int32_t)>& job)
+   {
+      if (count == 1)
+      {
+         job(0);
+         return;
+      }
+      JobCounter counter;
+      SubmitJobs(count, job, &counter, JobPriority::High);
+      WaitForCounter(counter);
+   }
+
+   ForceInline int32_t GetJobBegin(int32_t count, int32_t jobCount, int32_t job)
+   {
+      return int32_t(int64_t(count) * job / jobCount);
+   }
+
+   ForceInline int32_t GetDigit(uint64_t key, int32_t digit)
+   {
+      return int32_t(key >> (digit * RadixBits)) & (RadixSize - 1);
+   }
+}
+
+void Pillow::Graphics::SortDrawPackets(DrawPacket* packets, DrawPacket* scratch, int32_t count, int32_t jobCount)
+{
+   if (count <= 1) return;
+   if (count < MinRadixSortPackets)
+   {
+      std::stable_sort(packets, packets + count, [](const DrawPacket& left, const DrawPacket& right) { return left.SortKey < right.SortKey; });
+      return;
+   }
+   if (jobCount <= 0) jobCount = GetJobThreadCount() + 1;
+   jobCount = GetJobThreadCount() > 0 ? std::clamp(count / MinPacketsPerJob, 1, jobCount) : 1;
+   // Every job counts the digits of its range, then scatters its range after the same digits of the jobs before it, which keeps the sort stable.
+   // The histograms of all the digits are counted in a single read first. They stay valid for the first pass, and for every pass of a single job,
+   // since the order inside a range doesn't change its counts. The digits all the packets share are skipped.
+   std::vector<std::array<Histogram, DigitCount>> histograms(jobCount);
+   RunJobs(jobCount, [&](int32_t job)
+      {
+         auto& jobHistograms = histograms[job];
+         for (auto& histogram : jobHistograms) histogram.fill(0);
+         for (int32_t i = GetJobBegin(count, jobCount, job), end = GetJobBegin(count, jobCount, job + 1); i < end; i++)
+         {
+            const uint64_t key = packets[i].SortKey;
+            for (int32_t digit = 0; digit < DigitCount; digit++) jobHistograms[digit][GetDigit(key, digit)]++;
+         }
+      });
+   DrawPacket* source = packets;
+   DrawPacket* destination = scratch;
+   bool isFirstPass = true;
+   for (int32_t digit = 0; digit < DigitCount; digit++)
+   {
+      const int32_t sharedDigit = GetDigit(packets[0].SortKey, digit);
+      int32_t sharedCount = 0;
+      for (int32_t job = 0; job < jobCount; job++) sharedCount += histograms[job][digit][sharedDigit];
+      if (sharedCount == count) continue;
+      if (!isFirstPass && jobCount > 1)
+      {
+         RunJobs(jobCount, [&](int32_t job)
+            {
+               Histogram& histogram = histograms[job][digit];
+               histogram.fill(0);
+               for (int32_t i = GetJobBegin(count, jobCount, job), end = GetJobBegin(count, jobCount, job + 1); i < end; i++)
+               {
+                  histogram[GetDigit(source[i].SortKey, digit)]++;
+               }
+            });
+      }
+      isFirstPass = false;
+      int32_t offset = 0;
+      for (int32_t value = 0; value < RadixSize; value++)
+      {
+         for (int32_t job = 0; job < jobCount; job++)
+         {
+            int32_t& cursor = histograms[job][digit][value];
+            const int32_t valueCount = cursor;
+            cursor = offset;
+            offset += valueCount;
+         }
+      }
+      RunJobs(jobCount, [&](int32_t job)
+         {
+            Histogram& cursors = histograms[job][digit];
+            for (int32_t i = GetJobBegin(count, jobCount, job), end = GetJobBegin(count, jobCount, job + 1); i < end; i++)
+            {
+               destination[cursors[GetDigit(source[i].SortKey, digit)]++] = source[i];
+            }
+         });
+      std::swap(source, destination);
+   }
+   if (source != packets)
+   {
+      RunJobs(jobCount, [&](int32_t job)
+         {
+            const int32_t begin = GetJobBegin(count, jobCount, job);
+            std::memcpy(packets + begin, source + begin, sizeof(DrawPacket) * (GetJobBegin(count, jobCount, job + 1) - begin));
+         });
+   }
+}
+
+void Pillow::Graphics::BenchmarkDrawPacketSort(int32_t count, int32_t jobCount)
+{
+   using namespace std::chrono;
+   if (count <= 0) throw std::runtime_error("The packet count must be positive.");
+   std::unique_ptr<CacheLine[]> memory = CreateAlignedMemory(int64_t(sizeof(DrawPacket)) * count * 4);
+   DrawPacket* original = reinterpret_cast<DrawPacket*>(memory.get());
+   DrawPacket* packets = original + count;
+   DrawPacket* scratch = packets + count;
+   DrawPacket* reference = scratch + count;
+   // A frame's worth of keys: a few passes and pipelines, more materials, and random depths.
+   uint64_t random = 1;
+   for (int32_t i = 0; i < count; i++)
+   {
+      random = random * 6364136223846793005ull + 1442695040888963407ull;
+      const uint32_t bits = uint32_t(random >> 32);
+      original[i] = DrawPacket{ MakeSortKey(bits & 3, (bits >> 2) & 63, (bits >> 8) & 1023, float(bits >> 20) / 4096), uint32_t(i), uint32_t(i) };
+   }
+   const int32_t repeats = std::max(1000000 / count, 8);
+   auto Measure = [&](auto sort) -> double
+      {
+         double milliseconds = 0;
+         for (int32_t i = 0; i < repeats; i++)
+         {
+            std::memcpy(packets, original, sizeof(DrawPacket) * count);
+            auto start = steady_clock::now();
+            sort();
+            milliseconds += duration_cast<duration<double, std::milli>>(steady_clock::now() - start).count();
+         }
+         return milliseconds / repeats;
+      };
+   const double radixTime = Measure([&]() { SortDrawPackets(packets, scratch, count, jobCount); });
+   std::memcpy(reference, original, sizeof(DrawPacket) * count);
+   std::stable_sort(reference, reference + count, [](const DrawPacket& left, const DrawPacket& right) { return left.SortKey < right.SortKey; });
+   const bool matches = std::memcmp(packets, reference, sizeof(DrawPacket) * count) == 0;
+   const double referenceTime = Measure([&]()
+      {
+         std::stable_sort(packets, packets + count, [](const DrawPacket& left, const DrawPacket& right) { return left.SortKey < right.SortKey; });
+      });
+   char line[128];
+   std::snprintf(line, sizeof(line), "Packets %d  Radix(ms) %.3f  stable_sort(ms) %.3f  %s", count, radixTime, referenceTime, matches ? "Matched" : "MISMATCHED");
+   LogSystem(line);
+}
+
+DrawPacketStream::DrawPacketStream(int32_t capacity) :
+   _Capacity(capacity),
+   packets(CreateAlignedMemory(int64_t(sizeof(DrawPacket)) * capacity)),
+   scratch(CreateAlignedMemory(int64_t(sizeof(DrawPacket)) * capacity)),
+   count(0)
+{
+   if (capacity <= 0) throw std::runtime_error("The capacity must be positive.");
+}
+
+bool DrawPacketStream::Append(const DrawPacket& packet)
+{
+   // The count may run over the capacity, GetCount() clamps it.
+   const int32_t index = count.fetch_add(1, std::memory_order::relaxed);
+   if (index >= _Capacity) return false;
+   reinterpret_cast<DrawPacket*>(packets.get())[index] = packet;
+   return true;
+}
+
+void DrawPacketStream::Clear()
+{
+   count.store(0, std::memory_order::relaxed);
+}
+
+void DrawPacketStream::Sort(int32_t jobCount)
+{
+   SortDrawPackets(reinterpret_cast<DrawPacket*>(packets.get()), reinterpret_cast<DrawPacket*>(scratch.get()), GetCount(), jobCount);
+}
@@ -0,0 +1,114 @@
+#include "Renderer.h"
+#include <chrono>
+#include <algorithm>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+using namespace std::chrono;
+
+namespace
+{
+   ForceInline int64_t GetNanoseconds(steady_clock::time_point start)
+   {
+      return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+   }
+
+   // Busy waiting rather than sleeping, so the cost occupies the core like recording command lists does.
+   ForceInline void Burn(double microseconds)
+   {
+      const auto deadline = steady_clock::now() + duration_cast<steady_clock::duration>(duration<double, std::micro>(microseconds));
+      while (steady_clock::now() < deadline);
+   }
+
+   // Single writer accumulation, the readers only need a torn-free value.
+   ForceInline void Accumulate(std::atomic<int64_t>& counter, int64_t value)
+   {
+      counter.store(counter.load(std::memory_order::relaxed) + value, std::memory_order::relaxed);
+   }
+}
+
+NullRenderer::NullRenderer(int32_t threadCount, double workerMicroseconds) : GenericRenderer(threadCount, "NullRenderer"),
+   frameIndex(0),
+   submittedCosts(threadCount, workerMicroseconds),
+   frameCosts(threadCount, workerMicroseconds),
+   workerNanoseconds(threadCount),
+   frames(0),
+   pioneerNanoseconds(0),
+   totalWorkerNanoseconds(0),
+   criticalWorkerNanoseconds(0),
+   assemblerNanoseconds(0)
+{
+   if (workerMicroseconds < 0) throw std::runtime_error("The worker cost cannot be negative.");
+}
+
+NullRenderer::~NullRenderer()
+{
+}
+
+uint64_t NullRenderer::GetFrameIndex()
+{
+   return frameIndex.load(std::memory_order::acquire);
+}
+
+void NullRenderer::ReleaseResource(uint32_t)
+{
+}
+
+void NullRenderer::SetWorkerCost(int32_t workerIndex, double microseconds)
+{
+   if (workerIndex < -1 || workerIndex >= _ThreadCount) throw std::runtime_error("Invalid worker index.");
+   if (microseconds < 0) throw std::runtime_error("The worker cost cannot be negative.");
+   if (workerIndex < 0) std::fill(submittedCosts.begin(), submittedCosts.end(), microseconds);
+   else submittedCosts[workerIndex] = microseconds;
+}
+
+void NullRenderer::SetChunkCosts(const std::vector<double>& microseconds)
+{
+   if (std::ranges::any_of(microseconds, [](double cost) { return cost < 0; })) throw std::runtime_error("The chunk cost cannot be negative.");
+   submittedChunkCosts = microseconds;
+}
+
+FrameStageStats NullRenderer::GetStageStats() const
+{
+   FrameStageStats stats{};
+   stats.Frames = frames.load(std::memory_order::relaxed);
+   stats.PioneerMilliseconds = pioneerNanoseconds.load(std::memory_order::relaxed) / 1e6;
+   stats.WorkerMilliseconds = totalWorkerNanoseconds.load(std::memory_order::relaxed) / 1e6;
+   stats.CriticalWorkerMilliseconds = criticalWorkerNanoseconds.load(std::memory_order::relaxed) / 1e6;
+   stats.AssemblerMilliseconds = assemblerNanoseconds.load(std::memory_order::relaxed) / 1e6;
+   return stats;
+}
+
+void NullRenderer::Worker(int32_t workerIndex)
+{
+   const auto start = steady_clock::now();
+   Burn(frameCosts[workerIndex]);
+   for (int32_t chunk = ClaimChunk(workerIndex); chunk >= 0; chunk = ClaimChunk(workerIndex)) Burn(frameChunkCosts[chunk]);
+   workerNanoseconds[workerIndex] = GetNanoseconds(start);
+}
+
+void NullRenderer::Pioneer()
+{
+   // The workers are parked here, so the costs of the frame can be replaced.
+   const auto start = steady_clock::now();
+   frameCosts = submittedCosts;
+   frameChunkCosts = submittedChunkCosts;
+   SetChunkCount(int32_t(frameChunkCosts.size()));
+   Accumulate(pioneerNanoseconds, GetNanoseconds(start));
+}
+
+void NullRenderer::Assembler()
+{
+   const auto start = steady_clock::now();
+   int64_t total = 0, critical = 0;
+   for (int64_t time : workerNanoseconds)
+   {
+      total += time;
+      critical = std::max(critical, time);
+   }
+   Accumulate(totalWorkerNanoseconds, total);
+   Accumulate(criticalWorkerNanoseconds, critical);
+   frames.store(frames.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+   frameIndex.fetch_add(1, std::memory_order::release);
+   Accumulate(assemblerNanoseconds, GetNanoseconds(start));
+}
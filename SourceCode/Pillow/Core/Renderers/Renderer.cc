@@ -24,13 +24,77 @@ namespace
    //
    // We choose the first method for a better performance.
 
-   std::vector<Drawcall> cachedDrawcalls;
-   std::vector<Drawcall> submittedDrawcalls;
+   // The packets submitted for the next frame, and the sorted packets of the frame in flight. Commit() swaps them.
+   std::unique_ptr<DrawPacketStream> cachedPackets;
+   std::unique_ptr<DrawPacketStream> submittedPackets;
 
-   std::vector<std::thread> workers;
-   std::optional<std::barrier<void(*)() noexcept>> frameBarrier;
    std::atomic<bool> signal_IsActive;
    std::atomic<bool> signal_IsComputing;
+   // The worker jobs of the frame in flight, the last one to finish assembles the frame.
+   std::atomic<int32_t> unfinishedWorkers;
+   // The first exception of the worker jobs, rethrown by the next Commit().
+   std::exception_ptr frameError;
+   std::mutex frameErrorLock;
+
+   // A wait spins for up to SpinLimit rounds before parking. The limit doubles when the spinning caught the signal,
+   // and halves when the thread had to park, so the threads of a throttled or minimized game end up parking right away.
+   const int32_t MinSpinLimit = 16;
+   const int32_t MaxSpinLimit = 4096;
+
+   struct WaitCounters
+   {
+      std::atomic<int64_t> SpinNanoseconds;
+      std::atomic<int64_t> SleepNanoseconds;
+      std::atomic<uint64_t> SpinWakeups;
+      std::atomic<uint64_t> SleepWakeups;
+      int32_t SpinLimit = MinSpinLimit; // Owned by the waiting thread.
+   };
+
+   // Written by the thread of Commit() only.
+   WaitCounters commitWaitCounters;
+
+   // The chunks of the frame in flight, set by Pioneer() and claimed by the workers in order.
+   int32_t chunkCount;
+   std::atomic<int32_t> chunkCursor;
+
+   struct WorkerCounters
+   {
+      // Of the frame in flight, written by the worker.
+      std::chrono::steady_clock::time_point Start;
+      std::chrono::steady_clock::time_point End;
+      int32_t FrameChunks;
+      // Accumulated by the last worker of every frame.
+      std::atomic<int64_t> BusyNanoseconds;
+      std::atomic<int64_t> IdleNanoseconds;
+      std::atomic<uint64_t> Chunks;
+   };
+
+   std::unique_ptr<WorkerCounters[]> workerCounters;
+
+   // Block while signal equals value: spin first, then park in atomic::wait() until a notify_all() of the signal.
+   template<typename T>
+   void WaitWhileEqual(const std::atomic<T>& signal, T value, WaitCounters& counters)
+   {
+      using namespace std::chrono;
+      if (signal.load(std::memory_order::acquire) != value) return;
+      const auto start = steady_clock::now();
+      for (int32_t i = 0; i < counters.SpinLimit && signal.load(std::memory_order::acquire) == value; i++) SpinPause();
+      const auto parked = steady_clock::now();
+      const int64_t spinNanoseconds = duration_cast<nanoseconds>(parked - start).count();
+      counters.SpinNanoseconds.store(counters.SpinNanoseconds.load(std::memory_order::relaxed) + spinNanoseconds, std::memory_order::relaxed);
+      if (signal.load(std::memory_order::acquire) != value)
+      {
+         counters.SpinWakeups.store(counters.SpinWakeups.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+         counters.SpinLimit = std::min(counters.SpinLimit * 2, MaxSpinLimit);
+         return;
+      }
+      // wait() only returns once the value differs, the spurious wakeups are handled inside.
+      signal.wait(value, std::memory_order::acquire);
+      const int64_t sleepNanoseconds = duration_cast<nanoseconds>(steady_clock::now() - parked).count();
+      counters.SleepNanoseconds.store(counters.SleepNanoseconds.load(std::memory_order::relaxed) + sleepNanoseconds, std::memory_order::relaxed);
+      counters.SleepWakeups.store(counters.SleepWakeups.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+      counters.SpinLimit = std::max(counters.SpinLimit / 2, MinSpinLimit);
+   }
 
    ForceInline std::vector<KeyValuePair> Sort(const std::vector<KeyValuePair>& macros)
    {
@@ -82,65 +146,153 @@ bool GenericPipelineConfig::EqualTo(const GenericPipelineConfig& right) const
    return this->ConfigName == right.ConfigName;
 }
 
-static void Pillow::Graphics::BarrierCompletionAction() noexcept
-{
-   if(Instance) Instance->Assembler();
-   signal_IsComputing.store(false, std::memory_order::release);
-}
-
 GenericRenderer::GenericRenderer(int32_t threadCount, std::string name) :
    _RendererName(name),
    _ThreadCount(threadCount)
 {
-   workers.reserve(threadCount);
-   frameBarrier.emplace(threadCount, BarrierCompletionAction);
-   signal_IsActive.store(true);
+   signal_IsActive.store(false);
    signal_IsComputing.store(false);
+   unfinishedWorkers.store(0);
+   frameError = nullptr;
+   commitWaitCounters.SpinNanoseconds.store(0);
+   commitWaitCounters.SleepNanoseconds.store(0);
+   commitWaitCounters.SpinWakeups.store(0);
+   commitWaitCounters.SleepWakeups.store(0);
+   commitWaitCounters.SpinLimit = MinSpinLimit;
+   chunkCount = 0;
+   chunkCursor.store(0);
+   workerCounters = std::make_unique<WorkerCounters[]>(threadCount);
+   cachedPackets = std::make_unique<DrawPacketStream>(Constants::MaxDrawPackets);
+   submittedPackets = std::make_unique<DrawPacketStream>(Constants::MaxDrawPackets);
 }
 
 GenericRenderer::~GenericRenderer()
 {
-   workers.clear();
-   frameBarrier.reset();
 }
 
 void GenericRenderer::Launch()
 {
-   for (int32_t i = 0; i < _ThreadCount; i++)
-   {
-      workers.emplace_back(std::thread(&GenericRenderer::BaseWorker, this, i));
-   }
+   if (GetJobThreadCount() == 0) throw std::runtime_error("The job system isn't initialized.");
+   signal_IsActive.store(true, std::memory_order::release);
 }
 
 void GenericRenderer::Terminate()
 {
    signal_IsActive.store(false, std::memory_order::release);
-   for (auto& thread : workers)
-   {
-      if (thread.joinable()) thread.join();
-   }
+   // Let the frame in flight finish, its jobs still refer to the renderer.
+   WaitWhileEqual(signal_IsComputing, true, commitWaitCounters);
 }
 
 void GenericRenderer::Commit()
 {
-   while (signal_IsComputing.load(std::memory_order::acquire)) std::this_thread::yield();
+   if (!signal_IsActive.load(std::memory_order::acquire)) throw std::runtime_error("The renderer isn't launched.");
+   WaitWhileEqual(signal_IsComputing, true, commitWaitCounters);
+   std::exception_ptr error = std::exchange(frameError, nullptr);
+   if (error) std::rethrow_exception(error);
+   std::swap(cachedPackets, submittedPackets);
+   cachedPackets->Clear();
+   submittedPackets->Sort();
+   chunkCount = 0;
+   chunkCursor.store(0, std::memory_order::relaxed);
    this->Pioneer();
    signal_IsComputing.store(true, std::memory_order::release);
+   // A job per worker index, on the threads of the job system. The frame isn't waited for, so the next Commit() overlaps with it.
+   unfinishedWorkers.store(_ThreadCount, std::memory_order::relaxed);
+   SubmitJobs(_ThreadCount, [this](int32_t workerIndex) { this->WorkerJob(workerIndex); }, nullptr, JobPriority::High);
+}
+
+WaitStats GenericRenderer::GetCommitWaitStats() const
+{
+   WaitStats stats{};
+   stats.SpinMilliseconds = commitWaitCounters.SpinNanoseconds.load(std::memory_order::relaxed) / 1e6;
+   stats.SleepMilliseconds = commitWaitCounters.SleepNanoseconds.load(std::memory_order::relaxed) / 1e6;
+   stats.SpinWakeups = commitWaitCounters.SpinWakeups.load(std::memory_order::relaxed);
+   stats.SleepWakeups = commitWaitCounters.SleepWakeups.load(std::memory_order::relaxed);
+   return stats;
+}
+
+WorkerStats GenericRenderer::GetWorkerStats(int32_t workerIndex) const
+{
+   if (workerIndex < 0 || workerIndex >= _ThreadCount) throw std::runtime_error("Invalid worker index.");
+   const WorkerCounters& counters = workerCounters[workerIndex];
+   WorkerStats stats{};
+   stats.BusyMilliseconds = counters.BusyNanoseconds.load(std::memory_order::relaxed) / 1e6;
+   stats.IdleMilliseconds = counters.IdleNanoseconds.load(std::memory_order::relaxed) / 1e6;
+   stats.Chunks = counters.Chunks.load(std::memory_order::relaxed);
+   return stats;
+}
+
+void GenericRenderer::SetChunkCount(int32_t count)
+{
+   if (count < 0) throw std::runtime_error("The chunk count cannot be negative.");
+   chunkCount = count;
+}
+
+int32_t GenericRenderer::ClaimChunk(int32_t workerIndex)
+{
+   const int32_t chunk = chunkCursor.fetch_add(1, std::memory_order::relaxed);
+   if (chunk >= chunkCount) return -1;
+   workerCounters[workerIndex].FrameChunks++;
+   return chunk;
+}
+
+bool GenericRenderer::SubmitDrawPacket(const DrawPacket& packet)
+{
+   return cachedPackets->Append(packet);
+}
+
+const DrawPacket* GenericRenderer::GetDrawPackets() const
+{
+   return submittedPackets->GetPackets();
+}
+
+int32_t GenericRenderer::GetDrawPacketCount() const
+{
+   return submittedPackets->GetCount();
 }
 
 //#include <Windows.h>
 //#include <format>
-void GenericRenderer::BaseWorker(int32_t workerIndex)
+void GenericRenderer::WorkerJob(int32_t workerIndex)
 {
-   while(true)
+   using namespace std::chrono;
+   //OutputDebugString(std::format(L"Frame={} Worker={}\n", this->GetFrameIndex(), workerIndex).c_str());
+   WorkerCounters& counters = workerCounters[workerIndex];
+   counters.Start = steady_clock::now();
+   counters.FrameChunks = 0;
+   try
    {
-      while (!signal_IsComputing.load(std::memory_order::acquire))
-      {
-         if (!signal_IsActive.load(std::memory_order::acquire)) return;
-         std::this_thread::yield();
-      }
-      //OutputDebugString(std::format(L"Frame={} Worker={}\n", this->GetFrameIndex(), workerIndex).c_str());
       this->Worker(workerIndex);
-      frameBarrier->arrive_and_wait();
    }
-}
\ No newline at end of file
+   catch (...)
+   {
+      std::lock_guard guard(frameErrorLock);
+      if (!frameError) frameError = std::current_exception();
+   }
+   counters.End = steady_clock::now();
+   // The last worker of the frame assembles it.
+   if (unfinishedWorkers.fetch_sub(1, std::memory_order::acq_rel) != 1) return;
+   // A worker is idle from its end to the latest end of the frame, the time a frame barrier would have held it.
+   // The last worker to finish isn't always the last to end, its clock was read before the decrement.
+   steady_clock::time_point frameEnd = counters.End;
+   for (int32_t i = 0; i < _ThreadCount; i++) frameEnd = std::max(frameEnd, workerCounters[i].End);
+   for (int32_t i = 0; i < _ThreadCount; i++)
+   {
+      WorkerCounters& worker = workerCounters[i];
+      worker.BusyNanoseconds.store(worker.BusyNanoseconds.load(std::memory_order::relaxed) +
+         duration_cast<nanoseconds>(worker.End - worker.Start).count(), std::memory_order::relaxed);
+      worker.IdleNanoseconds.store(worker.IdleNanoseconds.load(std::memory_order::relaxed) +
+         duration_cast<nanoseconds>(frameEnd - worker.End).count(), std::memory_order::relaxed);
+      worker.Chunks.store(worker.Chunks.load(std::memory_order::relaxed) + worker.FrameChunks, std::memory_order::relaxed);
+   }
+   try
+   {
+      if (!frameError) this->Assembler();
+   }
+   catch (...)
+   {
+      frameError = std::current_exception();
+   }
+   signal_IsComputing.store(false, std::memory_order::release);
+   signal_IsComputing.notify_all();
+}
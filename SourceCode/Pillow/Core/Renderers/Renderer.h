@@ -1,10 +1,12 @@
 #pragma once
 #include <thread>
-#include <barrier>
 #include <atomic>
 #include <vector>
 #include <functional>
+#include <bit>
+#include <algorithm>
 #include "../Auxiliaries.h"
+#include "../JobSystem.h"
 #include "../Constants.h"
 #include "../Texture.h"
 #include "../Mesh.h"
@@ -14,10 +16,6 @@ using namespace DirectX;
 
 namespace Pillow::Graphics
 {
-   // Perceptual weightings for the importance of each channel.
-   const XMVECTOR RGBLuminance = XMVectorSet(0.2125f / 0.7154f, 1, 0.0721f / 0.7154f, 1);
-   const XMVECTOR RGBLuminanceInv = XMVectorSet(0.7154f / 0.2125f, 1, 0.7154f / 0.0721f, 1);
-
    extern int32_t RefreshRate;
    extern XMINT2 ScreenSize;
    class GenericRenderer;
@@ -34,9 +32,56 @@ namespace Pillow::Graphics
       ConstantBuffer = 4 << 28,
    };
 
-   struct Drawcall
+   // The sort key of a draw packet: pass(4 bits) | pipeline(12 bits) | material(16 bits) | depth(32 bits).
+   // The packets of a pass are sorted by pipeline then material, so a backend recording them in order minimizes the pipeline and descriptor changes.
+   // The depth only orders the draws sharing a pipeline and a material, front to back or back to front.
+   ForceInline uint64_t MakeSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, bool backToFront = false)
+   {
+      // The bits of the non-negative floats ascend with them.
+      uint32_t depthBits = std::bit_cast<uint32_t>(std::max(depth, 0.f));
+      if (backToFront) depthBits = ~depthBits;
+      return uint64_t(pass & 0xF) << 60 | uint64_t(pipeline & 0xFFF) << 48 | uint64_t(material & 0xFFFF) << 32 | depthBits;
+   }
+
+   ForceInline uint32_t GetSortKeyPass(uint64_t key) { return uint32_t(key >> 60); }
+   ForceInline uint32_t GetSortKeyPipeline(uint64_t key) { return uint32_t(key >> 48) & 0xFFF; }
+   ForceInline uint32_t GetSortKeyMaterial(uint64_t key) { return uint32_t(key >> 32) & 0xFFFF; }
+
+   struct DrawPacket
+   {
+      uint64_t SortKey;
+      ResourceHandle Mesh;
+      uint32_t Constants; // The offset of the draw's constants in the constant buffer of the frame, in 256 bytes.
+   };
+
+   // Sort count packets by their keys with a stable LSD radix sort, 11 bits per pass. The passes of the digits all the keys share are skipped,
+   // and the small counts are sorted by std::stable_sort.
+   // Every pass is split into jobCount jobs on the job system(0 = a job per job thread and the calling thread).
+   // The scratch holds count packets, and the sorted packets end up in packets.
+   void SortDrawPackets(DrawPacket* packets, DrawPacket* scratch, int32_t count, int32_t jobCount = 0);
+
+   // Sort count packets of random keys repeatedly, and log the time of a sort.
+   void BenchmarkDrawPacketSort(int32_t count, int32_t jobCount = 0);
+
+   // The draw packets of a frame in one contiguous block.
+   class DrawPacketStream
    {
-      void* sth;
+      DeleteDefautedMethods(DrawPacketStream)
+         ReadonlyProperty(int32_t, Capacity)
+
+   public:
+      DrawPacketStream(int32_t capacity);
+      // Any thread can append, but not while the stream is cleared or sorted. Returns false if the stream is full.
+      bool Append(const DrawPacket& packet);
+      ForceInline int32_t GetCount() const { return std::min(count.load(std::memory_order::acquire), _Capacity); }
+      ForceInline const DrawPacket* GetPackets() const { return reinterpret_cast<const DrawPacket*>(packets.get()); }
+      void Clear();
+      void Sort(int32_t jobCount = 0);
+
+   private:
+      std::unique_ptr<CacheLine[]> packets;
+      std::unique_ptr<CacheLine[]> scratch;
+      std::atomic<int32_t> count;
    };
 
    class GenericPipelineConfig
@@ -59,6 +104,25 @@ namespace Pillow::Graphics
       bool EqualTo(const GenericPipelineConfig& right) const;
    };
 
+   // The time Commit() waited for the previous frame, split into the spinning before parking and the parking.
+   struct WaitStats
+   {
+      double SpinMilliseconds{};
+      double SleepMilliseconds{};
+      uint64_t SpinWakeups{}; // The waits that ended while spinning.
+      uint64_t SleepWakeups{}; // The waits that parked the thread.
+   };
+
+   // The time of a worker index over the frames.
+   struct WorkerStats
+   {
+      double BusyMilliseconds{}; // From the start of its job to its end.
+      double IdleMilliseconds{}; // From its end to the latest end of a worker in the frame.
+      uint64_t Chunks{};
+   };
+
+   // The frames run on the job system: Commit() submits a high priority job per worker index(ThreadCount of them),
+   // and the last one to finish runs Assembler(). The job system must be initialized before Launch(), and terminated after Terminate().
    class GenericRenderer
    {
       DeleteDefautedMethods(GenericRenderer)
@@ -71,18 +135,78 @@ namespace Pillow::Graphics
       ForceInline int32_t GetFrameArrayIdx() { return GetFrameIndex() % Constants::SwapChainSize; }
       virtual void ReleaseResource(uint32_t handle) = 0;
       void Launch();
+      // Waits for the frame in flight.
       void Terminate();
+      // Waits for the previous frame, rethrows the first exception of its jobs, and submits the next one.
       void Commit();
+      WaitStats GetCommitWaitStats() const;
+      WorkerStats GetWorkerStats(int32_t workerIndex) const;
+      // Draw in the next Commit(), which sorts the packets before Pioneer(). Any thread can submit, but not during Commit().
+      // Returns false if the Constants::MaxDrawPackets packets of the frame are used up.
+      bool SubmitDrawPacket(const DrawPacket& packet);
 
    protected:
       GenericRenderer(int32_t threadCount, string name);
+      // Split the next frame into chunks, call it in Pioneer(). The count is 0 for the frames that don't set it.
+      void SetChunkCount(int32_t count);
+      // The next chunk of the frame in order, or -1 once all of them are claimed.
+      // A worker keeps claiming chunks until -1, so a heavy chunk only holds up its own worker.
+      int32_t ClaimChunk(int32_t workerIndex);
+      // The sorted packets of the frame in flight.
+      const DrawPacket* GetDrawPackets() const;
+      int32_t GetDrawPacketCount() const;
       virtual void Worker(int32_t workerIndex) = 0;
       virtual void Pioneer() = 0;
       virtual void Assembler() = 0;
 
    private:
-      void BaseWorker(int32_t workerIndex);
-      friend static void BarrierCompletionAction() noexcept;
+      void WorkerJob(int32_t workerIndex);
+   };
+
+   // The time spent in the stages of the frame loop, accumulated over the frames.
+   struct FrameStageStats
+   {
+      uint64_t Frames{};
+      double PioneerMilliseconds{};
+      double WorkerMilliseconds{}; // Of all the workers.
+      double CriticalWorkerMilliseconds{}; // Of the slowest worker of every frame, the part the frame waits for.
+      double AssemblerMilliseconds{};
+   };
+
+   // A headless backend without a device, for running and profiling the frame loop on any platform.
+   // It keeps the threading model and the frame indexing of the other backends, and its workers burn a synthetic cost.
+   class NullRenderer final : public GenericRenderer
+   {
+      DeleteDefautedMethods(NullRenderer)
+
+   public:
+      NullRenderer(int32_t threadCount, double workerMicroseconds = 0);
+      ~NullRenderer();
+      uint64_t GetFrameIndex();
+      void ReleaseResource(uint32_t handle);
+      // The busy time of a worker per frame, or of all the workers with workerIndex = -1.
+      // Call it from the thread of Commit(), the costs are consumed by the next Commit().
+      void SetWorkerCost(int32_t workerIndex, double microseconds);
+      // The busy time of every chunk of a frame, claimed by the workers after their own cost. The same rules as SetWorkerCost().
+      void SetChunkCosts(const std::vector<double>& microseconds);
+      FrameStageStats GetStageStats() const;
+
+   private:
+      std::atomic<uint64_t> frameIndex;
+      std::vector<double> submittedCosts;
+      std::vector<double> frameCosts;
+      std::vector<double> submittedChunkCosts;
+      std::vector<double> frameChunkCosts;
+      std::vector<int64_t> workerNanoseconds; // Of the current frame, summed up by Assembler() after the last worker.
+      std::atomic<uint64_t> frames;
+      std::atomic<int64_t> pioneerNanoseconds;
+      std::atomic<int64_t> totalWorkerNanoseconds;
+      std::atomic<int64_t> criticalWorkerNanoseconds;
+      std::atomic<int64_t> assemblerNanoseconds;
+
+      void Worker(int32_t workerIndex);
+      void Pioneer();
+      void Assembler();
    };
 
 #if defined(_WIN64)
@@ -123,9 +247,15 @@ namespace Pillow::Graphics
 
    ForceInline bool IsValidHandle(ResourceHandle handle) { return (handle & !(7 << 28)) != 0; }
 
+   // A null parameter initializes a headless NullRenderer.
    ForceInline void InitializeRenderer(int32_t threadCount, const void* parameter)
    {
       if (Instance) throw std::runtime_error("Renderer has already been initialized.");
+      if (!parameter)
+      {
+         Instance = std::make_unique<Graphics::NullRenderer>(threadCount);
+         return;
+      }
 #if defined(_WIN64)
       HWND hwnd = *(const HWND*)parameter;
       Instance = std::make_unique<Graphics::D3D12Renderer>(hwnd, threadCount);
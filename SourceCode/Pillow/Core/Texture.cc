@@ -1,7 +1,13 @@
 #include "Texture.h"
-#include "fstream"
 #include "filesystem"
+#include "cstring"
+#include "cstdio"
+#include "cmath"
+#include "cstdlib"
+#include "array"
+#include "thread"
 #include "lodepng-apr2025/lodepng.h"
+#include "DirectXMath-apr2025/DirectXPackedVector.h"
 
 using namespace Pillow;
 using namespace Pillow::Graphics;
@@ -9,19 +15,35 @@ using namespace DirectX;
 
 namespace
 {
-   void BicubicDownsampling(const uint8_t* input, uint8_t* output, int32_t inputWidth, bool is4Channels = true)
-   {
-      //auto ToFloat_DecodeSRGB = [](uint8_t x) -> float
-      //   {
-      //      float output = (float)x / UINT8_MAX;
-      //      output = MathF.Pow(((output + 0.055f) / 1.055f), 2.4f);
-      //      output = MathF.Round(output * byte.MaxValue);
-      //      value = (byte)output;
-      //   };
-      //auto ToUNORM = [](float x) -> uint8_t
-      //   {
-
-      //   };
+   // Output bytes per tile of a mip level. Its input band(about 4x) stays in the L2 cache.
+   const int32_t MipTileSize = 32 * 1024;
+
+   ForceInline XMVECTOR XM_CALLCONV LoadTexel(const uint8_t* texel, int32_t channels)
+   {
+      switch (channels)
+      {
+      case 4: return PackedVector::XMLoadUByte4(reinterpret_cast<const PackedVector::XMUBYTE4*>(texel));
+      case 3: return XMVectorSet(texel[0], texel[1], texel[2], 0);
+      case 2: return XMVectorSet(texel[0], texel[1], 0, 0);
+      default: return XMVectorSet(texel[0], 0, 0, 0);
+      }
+   }
+
+   ForceInline void XM_CALLCONV StoreTexel(uint8_t* texel, FXMVECTOR color, int32_t channels)
+   {
+      // Catmull-Rom overshoots at the edges, clamp it back.
+      XMVECTOR result = XMVectorClamp(color, XMVectorZero(), XMVectorReplicate(UINT8_MAX));
+      result = XMVectorAdd(result, XMVectorReplicate(0.5f));
+      XMFLOAT4A _result;
+      XMStoreFloat4A(&_result, result);
+      const float* values = &_result.x;
+      for (int32_t i = 0; i < channels; i++) texel[i] = uint8_t(values[i]);
+   }
+
+   // Downsample the output rows [firstRow, firstRow + rowCount) of a (inputWidth / 2)^2 mip level.
+   // It evaluates the 4x4 kernel directly, and stays as the reference of the separable version.
+   void BicubicDownsamplingReference(const uint8_t* input, uint8_t* output, int32_t inputWidth, int32_t channels, int32_t firstRow, int32_t rowCount)
+   {
       // Catmull-Rom spline kernel. Renowned for high sharpness.
       auto constexpr Weight = [](float x) -> float
          {
@@ -38,119 +60,953 @@ namespace
          };
       // Const & constexpr params.
       const int32_t scale = 2;
-      const int32_t channels = is4Channels ? 4 : 1;
       const int32_t outputWidth = inputWidth / scale;
-      const int32_t count = outputWidth * outputWidth;
       constexpr float w[2]{ Weight(0.5f), Weight(1.5f) };
-      constexpr XMFLOAT4 _k0{ w[1] * w[0], w[0] * w[0], w[0] * w[0], w[1] * w[0] };
-      constexpr XMFLOAT4 _k1{ w[1] * w[1], w[0] * w[1], w[0] * w[1], w[1] * w[1] };
-      const XMVECTOR k0 = XMLoadFloat4(&_k0);
-      const XMVECTOR k1 = XMLoadFloat4(&_k1);     
+      // An output texel sits between 2 input texels, the 4 taps are 1.5, 0.5, 0.5, 1.5 texels away.
+      constexpr float kernel[4]{ w[1], w[0], w[0], w[1] };
       // Downsampling.
-      for (int32_t i = 0; i < count; i++)
+      for (int32_t v = firstRow; v < firstRow + rowCount; v++)
       {
-         // 1 Define the kernel and the coordinates of samples.
+         // 1 Define the coordinates of samples, clamped to the edges.
          // DirectX texture coordinate definition:
          // |---> (u)
          // |
          // v (v)
-         int32_t u = (i % outputWidth) * scale;
-         int32_t v = (i / outputWidth) * scale;
-         XMVECTOR min = XMVectorZero();
-         XMVECTOR max = XMVectorReplicateInt(inputWidth - 1);
-         XMVECTOR sample_u = XMVectorSetInt(u - 1, u, u + 1, u);
-         XMVECTOR sample_v = XMVectorSetInt(v - 1, v, v + 1, v);
-         sample_u = XMVectorClamp(sample_u, min, max);
-         sample_v = XMVectorClamp(sample_v, min, max);
-         XMVECTOR result = XMVectorZero();
-         // 2 Sampling and convolution.
-         for (int row = 0; row < 4; row++)
-         {
-            const XMVECTOR& kernel = (row == 0 || row == 3) ? k1 : k0;
-            XMVECTOR rowOffset = XMVectorReplicateInt(((int32_t*)&sample_v)[row] * inputWidth * channels);
-            XMVECTOR offset = XMVectorAdd(rowOffset, XMVectorMultiply(sample_u, XMVectorReplicateInt(channels)));
-            XMINT4 _offset;
-            XMStoreSInt4(&_offset, offset);
-            XMVECTOR sample = XMVectorZero();
-            if (is4Channels)
+         const uint8_t* rows[4];
+         for (int32_t i = 0; i < 4; i++)
+         {
+            rows[i] = input + std::clamp(v * scale - 1 + i, 0, inputWidth - 1) * inputWidth * channels;
+         }
+         for (int32_t u = 0; u < outputWidth; u++)
+         {
+            int32_t columns[4];
+            for (int32_t i = 0; i < 4; i++) columns[i] = std::clamp(u * scale - 1 + i, 0, inputWidth - 1) * channels;
+            // 2 Sampling and convolution.
+            XMVECTOR result = XMVectorZero();
+            for (int32_t row = 0; row < 4; row++)
             {
-               XMVECTOR channelIndex = XMVectorSet(0, 1, 2, 3);
-               for (int chl = 0; chl < 4; chl++)
+               XMVECTOR sample = XMVectorZero();
+               for (int32_t column = 0; column < 4; column++)
                {
-                  XMVECTOR singleChannel = XMVectorSet(input[_offset.x + chl], input[_offset.y + chl], input[_offset.z + chl], input[_offset.w + chl]);
-                  XMVECTOR channelMask = XMVectorEqual(XMVectorReplicate(chl), channelIndex);
-                  sample = XMVectorSelect(sample, XMVector4Dot(singleChannel, kernel), channelMask);
+                  sample = XMVectorMultiplyAdd(LoadTexel(rows[row] + columns[column], channels), XMVectorReplicate(kernel[column]), sample);
                }
+               result = XMVectorMultiplyAdd(sample, XMVectorReplicate(kernel[row]), result);
             }
-            else
+            // 3 Store the result.
+            StoreTexel(output + (v * outputWidth + u) * channels, result, channels);
+         }
+      }
+   }
+
+   // Catmull-Rom weights of the taps 0.5 and 1.5 texels away, see BicubicDownsamplingReference().
+   constexpr float NearWeight = 0.625f;
+   constexpr float FarWeight = -0.125f;
+
+   // 8-bit to float with integer SIMD: widen 8 -> 16 -> 32 bits, then convert.
+   void ConvertBytesToFloats(const uint8_t* input, float* output, int32_t count)
+   {
+      int32_t i = 0;
+#if defined(_XM_SSE_INTRINSICS_)
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 16 <= count; i += 16)
+      {
+         const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+         const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+         const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+         _mm_storeu_ps(output + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)));
+         _mm_storeu_ps(output + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)));
+         _mm_storeu_ps(output + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)));
+         _mm_storeu_ps(output + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)));
+      }
+#elif defined(_XM_ARM_NEON_INTRINSICS_)
+      for (; i + 16 <= count; i += 16)
+      {
+         const uint8x16_t bytes = vld1q_u8(input + i);
+         const uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+         const uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+         vst1q_f32(output + i, vcvtq_f32_u32(vmovl_u16(vget_low_u16(low))));
+         vst1q_f32(output + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(low))));
+         vst1q_f32(output + i + 8, vcvtq_f32_u32(vmovl_u16(vget_low_u16(high))));
+         vst1q_f32(output + i + 12, vcvtq_f32_u32(vmovl_u16(vget_high_u16(high))));
+      }
+#endif
+      for (; i < count; i++) output[i] = input[i];
+   }
+
+   // Clamp to [0, 255], round, and narrow 4 floats into 4 bytes.
+   ForceInline void XM_CALLCONV StoreBytes(uint8_t* output, FXMVECTOR values)
+   {
+      XMVECTOR result = XMVectorClamp(values, XMVectorZero(), XMVectorReplicate(UINT8_MAX));
+      result = XMVectorAdd(result, XMVectorReplicate(0.5f));
+#if defined(_XM_SSE_INTRINSICS_)
+      __m128i integers = _mm_cvttps_epi32(result);
+      integers = _mm_packs_epi32(integers, integers);
+      integers = _mm_packus_epi16(integers, integers);
+      const int32_t packed = _mm_cvtsi128_si32(integers);
+      std::memcpy(output, &packed, 4);
+#elif defined(_XM_ARM_NEON_INTRINSICS_)
+      const uint16x4_t shorts = vmovn_u32(vcvtq_u32_f32(result));
+      const uint8x8_t bytes = vmovn_u16(vcombine_u16(shorts, shorts));
+      vst1_lane_u32(reinterpret_cast<uint32_t*>(output), vreinterpret_u32_u8(bytes), 0);
+#else
+      XMFLOAT4A _result;
+      XMStoreFloat4A(&_result, result);
+      output[0] = uint8_t(_result.x);
+      output[1] = uint8_t(_result.y);
+      output[2] = uint8_t(_result.z);
+      output[3] = uint8_t(_result.w);
+#endif
+   }
+
+   // sRGB to linear in [0, 255]. The alpha channel is always linear.
+   const std::array<float, 256> SRGBDecodeTable = []()
+      {
+         std::array<float, 256> table{};
+         for (int32_t i = 0; i < 256; i++)
+         {
+            const float c = i / float(UINT8_MAX);
+            table[i] = (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f)) * UINT8_MAX;
+         }
+         return table;
+      }();
+
+   // The bytes as floats, a load is cheaper than a scalar conversion between the lookups.
+   const std::array<float, 256> ByteFloatTable = []()
+      {
+         std::array<float, 256> table{};
+         for (int32_t i = 0; i < 256; i++) table[i] = float(i);
+         return table;
+      }();
+
+   // Every byte takes a lookup, which bounds the cost of the sRGB mode. SIMD curves are slower than the loads with SSE2.
+   void DecodeSRGBBytesToFloats(const uint8_t* input, float* output, int32_t count, int32_t channels)
+   {
+      if (channels == 4)
+      {
+         for (int32_t i = 0; i < count; i += 4)
+         {
+            output[i] = SRGBDecodeTable[input[i]];
+            output[i + 1] = SRGBDecodeTable[input[i + 1]];
+            output[i + 2] = SRGBDecodeTable[input[i + 2]];
+            output[i + 3] = ByteFloatTable[input[i + 3]];
+         }
+      }
+      else
+      {
+         for (int32_t i = 0; i < count; i++) output[i] = SRGBDecodeTable[input[i]];
+      }
+   }
+
+   // The entries of the linear to sRGB table, 12 bits keep a step of the table under 0.8 of a byte.
+   const int32_t SRGBEncodeSize = 4096;
+
+   // Linear in [0, 255] to sRGB bytes, indexed by the rounded linear * (SRGBEncodeSize - 1) / 255.
+   const std::array<uint8_t, SRGBEncodeSize> SRGBEncodeTable = []()
+      {
+         std::array<uint8_t, SRGBEncodeSize> table{};
+         for (int32_t i = 0; i < SRGBEncodeSize; i++)
+         {
+            const float c = i / float(SRGBEncodeSize - 1);
+            table[i] = uint8_t((c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1 / 2.4f) - 0.055f) * UINT8_MAX + 0.5f);
+         }
+         return table;
+      }();
+
+   // StoreBytes() of linear floats encoded to sRGB through the table, the alpha of a texel is rounded instead.
+   ForceInline void XM_CALLCONV StoreSRGBBytes(uint8_t* output, FXMVECTOR linear, bool hasAlpha)
+   {
+      // The color lanes are scaled to the table indices, the alpha lane stays a byte.
+      const XMVECTOR isAlpha = XMVectorSelectControl(0, 0, 0, hasAlpha);
+      const XMVECTOR limit = XMVectorSelect(XMVectorReplicate(SRGBEncodeSize - 1), XMVectorReplicate(UINT8_MAX), isAlpha);
+      const XMVECTOR scale = XMVectorSelect(XMVectorReplicate((SRGBEncodeSize - 1) / float(UINT8_MAX)), XMVectorReplicate(1), isAlpha);
+      const XMVECTOR result = XMVectorAdd(XMVectorClamp(XMVectorMultiply(linear, scale), XMVectorZero(), limit), XMVectorReplicate(0.5f));
+      alignas(16) int32_t integers[4];
+#if defined(_XM_SSE_INTRINSICS_)
+      _mm_store_si128(reinterpret_cast<__m128i*>(integers), _mm_cvttps_epi32(result));
+#elif defined(_XM_ARM_NEON_INTRINSICS_)
+      vst1q_s32(integers, vcvtq_s32_f32(result));
+#else
+      for (int32_t i = 0; i < 4; i++) integers[i] = int32_t(XMVectorGetByIndex(result, i));
+#endif
+      output[0] = SRGBEncodeTable[integers[0]];
+      output[1] = SRGBEncodeTable[integers[1]];
+      output[2] = SRGBEncodeTable[integers[2]];
+      output[3] = hasAlpha ? uint8_t(integers[3]) : SRGBEncodeTable[integers[3]];
+   }
+
+   // The largest finite values of the float formats: 65504 of halves, 65024 of the 6-bit and 64512 of the 5-bit mantissas.
+   const XMVECTORF32 MaxHalf4 = { { { 65504.f, 65504.f, 65504.f, 65504.f } } };
+   const XMVECTORF32 MaxFloat3PK = { { { 65024.f, 65024.f, 64512.f, 0 } } };
+
+#if defined(_XM_SSE_INTRINSICS_)
+   // Round non-negative floats to the nearest even floats of a 5-bit exponent(bias 15), and 23 - Shift mantissa bits.
+   // The bits of the small floats are returned in the integer lanes. The floats shouldn't exceed the largest value of the format.
+   template<int32_t Shift>
+   ForceInline __m128i XM_CALLCONV RoundToSmallFloats(__m128 value, __m128 magic)
+   {
+      // Below 2^-14 the small floats are denormal, adding a magic number makes the FPU round the mantissa into the low bits.
+      const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(value, magic)), _mm_castps_si128(magic));
+      const __m128i bits = _mm_castps_si128(value);
+      const __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, Shift), _mm_set1_epi32(1));
+      __m128i normal = _mm_add_epi32(bits, _mm_set1_epi32(-(112 << 23) + (1 << (Shift - 1)) - 1));
+      normal = _mm_srli_epi32(_mm_add_epi32(normal, odd), Shift);
+      const __m128i isDenormal = _mm_castps_si128(_mm_cmplt_ps(value, _mm_set1_ps(1 / 16384.f)));
+      return _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+   }
+
+   // Halves in the integer lanes to floats, the denormals, infinities and NaNs included.
+   ForceInline __m128 XM_CALLCONV ConvertHalvesToFloats(__m128i halves)
+   {
+      const __m128i shiftedExponent = _mm_set1_epi32(0x7C00 << 13);
+      __m128i bits = _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x7FFF)), 13);
+      const __m128i exponent = _mm_and_si128(bits, shiftedExponent);
+      bits = _mm_add_epi32(bits, _mm_set1_epi32((127 - 15) << 23));
+      // The infinities and NaNs keep the largest exponent.
+      bits = _mm_add_epi32(bits, _mm_and_si128(_mm_cmpeq_epi32(exponent, shiftedExponent), _mm_set1_epi32((128 - 16) << 23)));
+      // The denormals are normalized by the FPU.
+      const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(113 << 23));
+      const __m128i denormal = _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(1 << 23))), magic));
+      const __m128i isDenormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+      bits = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, bits));
+      return _mm_castsi128_ps(_mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(halves, _mm_set1_epi32(0x8000)), 16)));
+   }
+#endif
+
+   // A texel of RGBE: an 8-bit mantissa per color and a shared exponent, the value is mantissa * 2^(exponent - 136).
+   // The alpha is 1.
+   ForceInline XMVECTOR XM_CALLCONV LoadRGBE(const uint8_t* texel)
+   {
+#if defined(_XM_SSE_INTRINSICS_)
+      int32_t packed;
+      std::memcpy(&packed, texel, 4);
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i integers = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+      // 2^(exponent - 136) is built as the float exponent field exponent - 9. The exponents below 10 give values
+      // under 2^-126, they are flushed to 0 like the exponent 0 of black.
+      const __m128i exponent = _mm_shuffle_epi32(integers, _MM_SHUFFLE(3, 3, 3, 3));
+      const __m128i nine = _mm_set1_epi32(9);
+      const __m128i scale = _mm_and_si128(_mm_slli_epi32(_mm_sub_epi32(exponent, nine), 23), _mm_cmpgt_epi32(exponent, nine));
+      const __m128 color = _mm_mul_ps(_mm_cvtepi32_ps(integers), _mm_castsi128_ps(scale));
+      return XMVectorSelect(g_XMOne, color, g_XMSelect1110);
+#elif defined(_XM_ARM_NEON_INTRINSICS_)
+      uint32_t packed;
+      std::memcpy(&packed, texel, 4);
+      const uint32x4_t integers = vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(packed)))));
+      const uint32x4_t exponent = vdupq_n_u32(texel[3]);
+      const uint32x4_t nine = vdupq_n_u32(9);
+      const uint32x4_t scale = vandq_u32(vshlq_n_u32(vsubq_u32(exponent, nine), 23), vcgtq_u32(exponent, nine));
+      const float32x4_t color = vmulq_f32(vcvtq_f32_u32(integers), vreinterpretq_f32_u32(scale));
+      return XMVectorSelect(g_XMOne, color, g_XMSelect1110);
+#else
+      if (texel[3] < 10) return XMVectorSet(0, 0, 0, 1);
+      const float scale = std::ldexp(1.f, texel[3] - 136);
+      return XMVectorSet(texel[0] * scale, texel[1] * scale, texel[2] * scale, 1);
+#endif
+   }
+
+   ForceInline XMVECTOR XM_CALLCONV LoadHalf4(const uint8_t* texel)
+   {
+#if defined(_XM_SSE_INTRINSICS_)
+      const __m128i halves = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(texel));
+      return ConvertHalvesToFloats(_mm_unpacklo_epi16(halves, _mm_setzero_si128()));
+#elif defined(_XM_ARM_NEON_INTRINSICS_) && (defined(_M_ARM64) || defined(__aarch64__))
+      return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(texel))));
+#else
+      return PackedVector::XMLoadHalf4(reinterpret_cast<const PackedVector::XMHALF4*>(texel));
+#endif
+   }
+
+   // Clamp to [0, 65504], and round to the nearest even halves.
+   ForceInline void XM_CALLCONV StoreHalf4(uint8_t* texel, FXMVECTOR color)
+   {
+      const XMVECTOR value = XMVectorClamp(color, XMVectorZero(), MaxHalf4);
+#if defined(_XM_SSE_INTRINSICS_)
+      const __m128i halves = RoundToSmallFloats<13>(value, _mm_castsi128_ps(_mm_set1_epi32(126 << 23)));
+      // The halves are positive 16-bit integers, the signed saturation keeps them.
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(texel), _mm_packs_epi32(halves, halves));
+#elif defined(_XM_ARM_NEON_INTRINSICS_) && (defined(_M_ARM64) || defined(__aarch64__))
+      vst1_u16(reinterpret_cast<uint16_t*>(texel), vreinterpret_u16_f16(vcvt_f16_f32(value)));
+#else
+      PackedVector::XMStoreHalf4(reinterpret_cast<PackedVector::XMHALF4*>(texel), value);
+#endif
+   }
+
+   // R11G11B10 has the exponent and the top mantissa bits of halves, so its channels are unpacked as halves. The alpha is 0.
+   ForceInline XMVECTOR XM_CALLCONV LoadFloat3PK(const uint8_t* texel)
+   {
+#if defined(_XM_SSE_INTRINSICS_)
+      uint32_t packed;
+      std::memcpy(&packed, texel, 4);
+      return ConvertHalvesToFloats(_mm_setr_epi32((packed & 0x7FF) << 4, (packed >> 11 & 0x7FF) << 4, (packed >> 22) << 5, 0));
+#else
+      return PackedVector::XMLoadFloat3PK(reinterpret_cast<const PackedVector::XMFLOAT3PK*>(texel));
+#endif
+   }
+
+   // Clamp to [0, the largest value], and round to the nearest even R11G11B10.
+   ForceInline void XM_CALLCONV StoreFloat3PK(uint8_t* texel, FXMVECTOR color)
+   {
+      const XMVECTOR value = XMVectorClamp(color, XMVectorZero(), MaxFloat3PK);
+#if defined(_XM_SSE_INTRINSICS_)
+      // R and G are rounded at the bit 17 of floats, B at the bit 18. Their magic numbers differ by the mantissa bits.
+      const __m128i r11g11 = RoundToSmallFloats<17>(value, _mm_set1_ps(8));
+      const __m128i b10 = RoundToSmallFloats<18>(value, _mm_set1_ps(16));
+      const uint32_t packed = uint32_t(_mm_cvtsi128_si32(r11g11)) | uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(r11g11, 4))) << 11 |
+         uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(b10, 8))) << 22;
+      std::memcpy(texel, &packed, 4);
+#else
+      PackedVector::XMStoreFloat3PK(reinterpret_cast<PackedVector::XMFLOAT3PK*>(texel), value);
+#endif
+   }
+
+   // Horizontal pass: the output texel u takes the input texels 2u-1, 2u, 2u+1, 2u+2.
+   // The padded row starts with a copy of texel 0, and ends with a copy of the last texel, so no clamping is needed.
+   void HorizontalPass(const float* padded, float* output, int32_t outputWidth, int32_t channels)
+   {
+      const XMVECTOR nearWeight = XMVectorReplicate(NearWeight);
+      const XMVECTOR farWeight = XMVectorReplicate(FarWeight);
+      // The kernel is symmetric: near * (tap1 + tap2) + far * (tap0 + tap3).
+      auto Filter = [&](FXMVECTOR tap0, FXMVECTOR tap1, FXMVECTOR tap2, GXMVECTOR tap3)
+         {
+            return XMVectorMultiplyAdd(XMVectorAdd(tap1, tap2), nearWeight, XMVectorMultiply(XMVectorAdd(tap0, tap3), farWeight));
+         };
+      switch (channels)
+      {
+      case 4:
+         // A texel per vector.
+         for (int32_t u = 0; u < outputWidth; u++)
+         {
+            const float* taps = padded + u * 8;
+            XMVECTOR result = Filter(XMLoadFloat4A((const XMFLOAT4A*)taps), XMLoadFloat4A((const XMFLOAT4A*)(taps + 4)),
+               XMLoadFloat4A((const XMFLOAT4A*)(taps + 8)), XMLoadFloat4A((const XMFLOAT4A*)(taps + 12)));
+            XMStoreFloat4A((XMFLOAT4A*)(output + u * 4), result);
+         }
+         break;
+      case 2:
+         // 2 texels per vector, the taps of the next output texel are 2 input texels further.
+         for (int32_t u = 0; u < outputWidth; u += 2)
+         {
+            const float* taps = padded + u * 4;
+            XMVECTOR tap[4];
+            for (int32_t i = 0; i < 4; i++)
+            {
+               tap[i] = XMVectorPermute<0, 1, 4, 5>(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(taps + i * 2)), XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(taps + i * 2 + 4)));
+            }
+            XMStoreFloat4A((XMFLOAT4A*)(output + u * 2), Filter(tap[0], tap[1], tap[2], tap[3]));
+         }
+         break;
+      case 1:
+         // 4 texels per vector, the taps are the even and the odd texels.
+         for (int32_t u = 0; u < outputWidth; u += 4)
+         {
+            const float* taps = padded + u * 2;
+            const XMVECTOR a = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(taps));
+            const XMVECTOR b = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(taps + 4));
+            const XMVECTOR c = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(taps + 2));
+            const XMVECTOR d = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(taps + 6));
+            XMVECTOR result = Filter(XMVectorPermute<0, 2, 4, 6>(a, b), XMVectorPermute<1, 3, 5, 7>(a, b),
+               XMVectorPermute<0, 2, 4, 6>(c, d), XMVectorPermute<1, 3, 5, 7>(c, d));
+            XMStoreFloat4A((XMFLOAT4A*)(output + u), result);
+         }
+         break;
+      default:
+         for (int32_t u = 0; u < outputWidth; u++)
+         {
+            for (int32_t c = 0; c < channels; c++)
+            {
+               const float* taps = padded + u * 2 * channels + c;
+               output[u * channels + c] = (taps[channels] + taps[channels * 2]) * NearWeight + (taps[0] + taps[channels * 3]) * FarWeight;
+            }
+         }
+         break;
+      }
+   }
+
+   // Separable version of BicubicDownsamplingReference(): a horizontal pass per input row, then a vertical pass per output row.
+   // Neighbouring output rows share 2 of their 4 input rows, so a rolling buffer of 4 horizontally filtered rows
+   // is kept, and every input row is converted and filtered once.
+   // LoadRow(row, floats) converts an input row into floats, StoreFloats(row, i, values) stores the floats [i, i + 4) of an output row.
+   template<typename LoadRow, typename StoreFloats>
+   void SeparableDownsampling(int32_t inputWidth, int32_t channels, int32_t firstRow, int32_t rowCount, const LoadRow& loadRow, const StoreFloats& storeFloats)
+   {
+      const int32_t scale = 2;
+      const int32_t outputWidth = inputWidth / scale;
+      const int32_t rowLength = outputWidth * channels; // A multiple of 4, since mips are at least 4 texels wide.
+      const int32_t paddedLength = GetAlignedSize((inputWidth + 2) * channels + 4, 16);
+      const int32_t bufferLength = GetAlignedSize(rowLength, 16);
+      std::unique_ptr<CacheLine[]> memory = CreateAlignedMemory(int64_t(paddedLength + bufferLength * 4) * sizeof(float));
+      float* padded = reinterpret_cast<float*>(memory.get());
+      float* buffer[4];
+      int32_t bufferRow[4];
+      for (int32_t i = 0; i < 4; i++)
+      {
+         buffer[i] = padded + paddedLength + bufferLength * i;
+         bufferRow[i] = INT32_MIN;
+      }
+      // Get a horizontally filtered row, -1 and inputWidth are clamped to the edges.
+      auto FetchRow = [&](int32_t row) -> const float*
+         {
+            const int32_t slot = row & 3;
+            if (bufferRow[slot] == row) return buffer[slot];
+            loadRow(std::clamp(row, 0, inputWidth - 1), padded + channels);
+            for (int32_t c = 0; c < channels; c++)
+            {
+               padded[c] = padded[channels + c];
+               padded[(inputWidth + 1) * channels + c] = padded[inputWidth * channels + c];
+            }
+            HorizontalPass(padded, buffer[slot], outputWidth, channels);
+            bufferRow[slot] = row;
+            return buffer[slot];
+         };
+      const XMVECTOR nearWeight = XMVectorReplicate(NearWeight);
+      const XMVECTOR farWeight = XMVectorReplicate(FarWeight);
+      for (int32_t v = firstRow; v < firstRow + rowCount; v++)
+      {
+         const float* rows[4];
+         for (int32_t i = 0; i < 4; i++) rows[i] = FetchRow(v * scale - 1 + i);
+         // Vertical pass, it runs over contiguous floats regardless of the channels.
+         for (int32_t i = 0; i < rowLength; i += 4)
+         {
+            const XMVECTOR r0 = XMLoadFloat4A((const XMFLOAT4A*)(rows[0] + i));
+            const XMVECTOR r1 = XMLoadFloat4A((const XMFLOAT4A*)(rows[1] + i));
+            const XMVECTOR r2 = XMLoadFloat4A((const XMFLOAT4A*)(rows[2] + i));
+            const XMVECTOR r3 = XMLoadFloat4A((const XMFLOAT4A*)(rows[3] + i));
+            storeFloats(v, i, XMVectorMultiplyAdd(XMVectorAdd(r1, r2), nearWeight, XMVectorMultiply(XMVectorAdd(r0, r3), farWeight)));
+         }
+      }
+   }
+
+   // SeparableDownsampling() of 8-bit texels. With sRGB, the color channels are filtered in linear light.
+   void BicubicDownsampling(const uint8_t* input, uint8_t* output, int32_t inputWidth, int32_t channels, bool sRGB, int32_t firstRow, int32_t rowCount)
+   {
+      const int32_t rowLength = inputWidth / 2 * channels;
+      // 4 floats are a whole texel of RGBA, whose alpha stays linear. Otherwise all the channels are colors.
+      const bool hasAlpha = channels == 4;
+      SeparableDownsampling(inputWidth, channels, firstRow, rowCount,
+         [&](int32_t row, float* floats)
+         {
+            const uint8_t* source = input + row * inputWidth * channels;
+            if (sRGB) DecodeSRGBBytesToFloats(source, floats, inputWidth * channels, channels);
+            else ConvertBytesToFloats(source, floats, inputWidth * channels);
+         },
+         [&](int32_t row, int32_t i, FXMVECTOR values)
+         {
+            if (sRGB) StoreSRGBBytes(output + row * rowLength + i, values, hasAlpha);
+            else StoreBytes(output + row * rowLength + i, values);
+         });
+   }
+
+   // SeparableDownsampling() of the float formats, a texel is unpacked into 4 floats.
+   void BicubicDownsamplingHDR(const uint8_t* input, uint8_t* output, int32_t inputWidth, GenericTexFmt format, int32_t firstRow, int32_t rowCount)
+   {
+      const int32_t pixelSize = PixelSize[int32_t(format)];
+      const int32_t outputWidth = inputWidth / 2;
+      const bool bHalf = format == GenericTexFmt::Float_R16G16B16A16;
+      SeparableDownsampling(inputWidth, 4, firstRow, rowCount,
+         [&](int32_t row, float* floats)
+         {
+            const uint8_t* source = input + int64_t(row) * inputWidth * pixelSize;
+            for (int32_t x = 0; x < inputWidth; x++)
+            {
+               const XMVECTOR texel = bHalf ? LoadHalf4(source + x * pixelSize) : LoadFloat3PK(source + x * pixelSize);
+               XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(floats + x * 4), texel);
+            }
+         },
+         [&](int32_t row, int32_t i, FXMVECTOR values)
+         {
+            uint8_t* texel = output + (int64_t(row) * outputWidth + i / 4) * pixelSize;
+            if (bHalf) StoreHalf4(texel, values);
+            else StoreFloat3PK(texel, values);
+         });
+   }
+
+   // Decode a normal from the [0, 1] of its color, renormalize it, and encode its X and Y back.
+   ForceInline void RenormalizeNormal(const uint8_t* input, uint8_t* output)
+   {
+      const float x = input[0] / 127.5f - 1, y = input[1] / 127.5f - 1;
+      // A tangent space normal never points into the surface.
+      const float z = std::max(input[2] / 127.5f - 1, 0.f);
+      const float length = std::sqrt(x * x + y * y + z * z);
+      if (length < 1e-6f)
+      {
+         output[0] = output[1] = 128;
+         return;
+      }
+      ColorFloat2Byte(output[0], x / length * 0.5f + 0.5f);
+      ColorFloat2Byte(output[1], y / length * 0.5f + 0.5f);
+   }
+
+   // Inspect the header to choose the format, then set up lodepng to convert the texels into it.
+   GenericTextureInfo InspectPNG(const uint8_t* fileData, int64_t fileSize, bool bSRGB, CompressionMode compMode, lodepng::State& state)
+   {
+      uint32_t w, h;
+      //state.decoder.ignore_crc = 1;
+      //state.decoder.zlibsettings.ignore_adler32 = 1;
+      if (lodepng_inspect(&w, &h, &state, fileData, size_t(fileSize))) throw std::runtime_error("Invalid PNG file");
+      if (state.info_png.color.bitdepth > 8) throw std::runtime_error("Bitdepth shouldn't exceed 8.");
+      if (w != h) throw std::runtime_error("The image should be square.");
+      GenericTexFmt format = GenericTexFmt::UnsignedNormalized_R8G8B8A8;
+      state.info_raw.colortype = LCT_RGBA;
+      if (state.info_png.color.colortype == LCT_GREY)
+      {
+         format = GenericTexFmt::UnsignedNormalized_R8;
+         state.info_raw.colortype = LCT_GREY;
+      }
+      state.info_raw.bitdepth = 8;
+      return GenericTextureInfo(format, w, true, compMode, false, 1, bSRGB);
+   }
+
+   ForceInline uint8_t PaethPredictor(int16_t a, int16_t b, int16_t c)
+   {
+      const int16_t pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - c - c);
+      if (pa <= pb && pa <= pc) return uint8_t(a);
+      return uint8_t(pb <= pc ? b : c);
+   }
+
+   // Reconstruct a row of filtered bytes. prior is the previous reconstructed row, null for the first row.
+   void UnfilterScanline(uint8_t* row, const uint8_t* scanline, const uint8_t* prior, int32_t length, int32_t bpp, uint8_t filter)
+   {
+      switch (filter)
+      {
+      case 0: // None
+         std::memcpy(row, scanline, length);
+         break;
+      case 1: // Sub
+         for (int32_t i = 0; i < bpp; i++) row[i] = scanline[i];
+         for (int32_t i = bpp; i < length; i++) row[i] = scanline[i] + row[i - bpp];
+         break;
+      case 2: // Up
+         if (!prior) std::memcpy(row, scanline, length);
+         else for (int32_t i = 0; i < length; i++) row[i] = scanline[i] + prior[i];
+         break;
+      case 3: // Average
+         if (!prior)
+         {
+            for (int32_t i = 0; i < bpp; i++) row[i] = scanline[i];
+            for (int32_t i = bpp; i < length; i++) row[i] = scanline[i] + (row[i - bpp] >> 1);
+         }
+         else
+         {
+            for (int32_t i = 0; i < bpp; i++) row[i] = scanline[i] + (prior[i] >> 1);
+            for (int32_t i = bpp; i < length; i++) row[i] = scanline[i] + ((row[i - bpp] + prior[i]) >> 1);
+         }
+         break;
+      case 4: // Paeth, which is Sub for the first row.
+         if (!prior)
+         {
+            for (int32_t i = 0; i < bpp; i++) row[i] = scanline[i];
+            for (int32_t i = bpp; i < length; i++) row[i] = scanline[i] + row[i - bpp];
+         }
+         else
+         {
+            for (int32_t i = 0; i < bpp; i++) row[i] = scanline[i] + prior[i];
+            for (int32_t i = bpp; i < length; i++) row[i] = scanline[i] + PaethPredictor(row[i - bpp], prior[i], prior[i - bpp]);
+         }
+         break;
+      default:
+         throw std::runtime_error("Invalid PNG filter");
+      }
+   }
+
+   // The common PNGs(8 bits, not interlaced, without palettes or color keys) are inflated, then unfiltered row by row into mip 0.
+   // RGB and gray-alpha rows are expanded to RGBA on the way, so the inflated scanlines are the only copy of the image.
+   // Returns false for the other PNGs.
+   bool DecodePNGIntoMipZero(const uint8_t* fileData, int64_t fileSize, const lodepng::State& state, uint8_t* destination, int32_t width)
+   {
+      const LodePNGColorMode& color = state.info_png.color;
+      if (color.bitdepth != 8 || color.key_defined || state.info_png.interlace_method != 0) return false;
+      int32_t bpp;
+      switch (color.colortype)
+      {
+      case LCT_GREY: bpp = 1; break;
+      case LCT_GREY_ALPHA: bpp = 2; break;
+      case LCT_RGB: bpp = 3; break;
+      case LCT_RGBA: bpp = 4; break;
+      default: return false;
+      }
+      // The zlib stream may be split over IDAT chunks. A single chunk, the usual case, is used in place.
+      const uint8_t* end = fileData + fileSize;
+      const uint8_t* stream = nullptr;
+      size_t streamSize = 0;
+      std::vector<uint8_t> gathered;
+      for (const uint8_t* chunk = fileData + 8; chunk + 12 <= end; chunk = lodepng_chunk_next_const(chunk, end))
+      {
+         const uint32_t length = lodepng_chunk_length(chunk);
+         if (length > size_t(end - chunk) - 12) throw std::runtime_error("Invalid PNG file");
+         if (lodepng_chunk_type_equals(chunk, "IEND")) break;
+         if (!lodepng_chunk_type_equals(chunk, "IDAT")) continue;
+         if (!state.decoder.ignore_crc && lodepng_chunk_check_crc(chunk)) throw std::runtime_error("Invalid PNG file");
+         const uint8_t* data = lodepng_chunk_data_const(chunk);
+         if (stream && gathered.empty()) gathered.assign(stream, stream + streamSize);
+         if (stream) gathered.insert(gathered.end(), data, data + length);
+         else stream = data;
+         streamSize += length;
+      }
+      if (!gathered.empty()) stream = gathered.data();
+      // A filter byte leads every row of the scanlines.
+      const int32_t length = width * bpp;
+      uint8_t* scanlines = nullptr;
+      size_t scanlinesSize = 0;
+      const unsigned error = lodepng_zlib_decompress(&scanlines, &scanlinesSize, stream, streamSize, &state.decoder.zlibsettings);
+      // lodepng allocates with malloc by default.
+      std::unique_ptr<uint8_t, decltype(&std::free)> scanlineMemory(scanlines, &std::free);
+      if (!stream || error || scanlinesSize < size_t(length + 1) * width) throw std::runtime_error("Error decoding PNG file");
+      gathered = std::vector<uint8_t>();
+      // Gray and RGBA rows are unfiltered into mip 0 directly, the others into 2 alternating rows before the expansion.
+      const int32_t channels = bpp == 1 ? 1 : 4;
+      std::vector<uint8_t> rows(bpp == 2 || bpp == 3 ? length * 2 : 0);
+      const uint8_t* prior = nullptr;
+      for (int32_t y = 0; y < width; y++)
+      {
+         const uint8_t* scanline = scanlines + size_t(y) * (length + 1);
+         uint8_t* output = destination + size_t(y) * width * channels;
+         uint8_t* row = rows.empty() ? output : rows.data() + (y & 1) * length;
+         UnfilterScanline(row, scanline + 1, prior, length, bpp, scanline[0]);
+         if (bpp == 3)
+         {
+            for (int32_t x = 0; x < width; x++)
             {
-               sample = XMVectorSet(input[_offset.x], input[_offset.y], input[_offset.z], input[_offset.w]);
-               sample = XMVector4Dot(sample, kernel);
+               output[x * 4] = row[x * 3];
+               output[x * 4 + 1] = row[x * 3 + 1];
+               output[x * 4 + 2] = row[x * 3 + 2];
+               output[x * 4 + 3] = UINT8_MAX;
             }
-            result = XMVectorAdd(result, sample);
          }
-         // 3 Store the result.
-         if (is4Channels)
+         else if (bpp == 2)
          {
-            XMStoreFloat4((XMFLOAT4*)(output + i * channels), result);
+            for (int32_t x = 0; x < width; x++)
+            {
+               output[x * 4] = output[x * 4 + 1] = output[x * 4 + 2] = row[x * 2];
+               output[x * 4 + 3] = row[x * 2 + 1];
+            }
+         }
+         prior = row;
+      }
+      return true;
+   }
+
+   // Radiance .hdr files start with "#?RADIANCE", or "#?RGBE" written by some tools.
+   bool IsHDRFile(const uint8_t* fileData, int64_t fileSize)
+   {
+      return (fileSize >= 10 && !std::memcmp(fileData, "#?RADIANCE", 10)) || (fileSize >= 6 && !std::memcmp(fileData, "#?RGBE", 6));
+   }
+
+   // The header is lines of variables ended by an empty line, then the resolution line. Only the standard orientation
+   // "-Y h +X w", rows from the top and texels from the left, is supported. offset is set to the first scanline.
+   GenericTextureInfo InspectHDR(const uint8_t* fileData, int64_t fileSize, CompressionMode compMode, GenericTexFmt format, int64_t& offset)
+   {
+      if (!IsFloatFormat(format)) throw std::runtime_error("HDR files are decoded into the float formats only.");
+      offset = 0;
+      auto ReadLine = [&]() -> string
+         {
+            const uint8_t* begin = fileData + offset;
+            const uint8_t* end = reinterpret_cast<const uint8_t*>(std::memchr(begin, '\n', size_t(fileSize - offset)));
+            if (!end) throw std::runtime_error("Invalid HDR file");
+            offset = end - fileData + 1;
+            if (end > begin && end[-1] == '\r') end--;
+            return string(reinterpret_cast<const char*>(begin), reinterpret_cast<const char*>(end));
+         };
+      ReadLine();
+      for (string line = ReadLine(); !line.empty(); line = ReadLine())
+      {
+         if (line.starts_with("FORMAT=") && line != "FORMAT=32-bit_rle_rgbe") throw std::runtime_error("Only the RGBE HDR files are supported.");
+      }
+      int32_t w = 0, h = 0;
+      char rest;
+      if (std::sscanf(ReadLine().c_str(), "-Y %d +X %d %c", &h, &w, &rest) != 2) throw std::runtime_error("Only the -Y h +X w HDR files are supported.");
+      if (w != h) throw std::runtime_error("The image should be square.");
+      return GenericTextureInfo(format, w, true, compMode, false, 1, false);
+   }
+
+   // Decode a scanline of RGBE texels. The run-length encoded ones start with 2, 2 and the width in 2 bytes, then the 4 components
+   // are encoded one after another, as runs(count - 128 copies of a byte) and literals(count bytes). The flat ones are texels,
+   // where (1, 1, 1, n) repeats the last texel n times, shifted by 8 bits more for every repeat just before.
+   const uint8_t* DecodeRGBEScanline(const uint8_t* data, const uint8_t* end, uint8_t* texels, int32_t width)
+   {
+      auto Check = [&](int64_t size) { if (end - data < size) throw std::runtime_error("Error decoding HDR file"); };
+      Check(4);
+      if (width >= 8 && width < 0x8000 && data[0] == 2 && data[1] == 2 && (data[2] << 8 | data[3]) == width)
+      {
+         data += 4;
+         for (int32_t c = 0; c < 4; c++)
+         {
+            for (int32_t x = 0; x < width;)
+            {
+               Check(2);
+               int32_t count = *data++;
+               if (count > 128)
+               {
+                  count -= 128;
+                  if (count > width - x) throw std::runtime_error("Error decoding HDR file");
+                  for (const uint8_t value = *data++; count > 0; count--, x++) texels[x * 4 + c] = value;
+               }
+               else
+               {
+                  if (count == 0 || count > width - x) throw std::runtime_error("Error decoding HDR file");
+                  Check(count);
+                  for (; count > 0; count--, x++) texels[x * 4 + c] = *data++;
+               }
+            }
+         }
+         return data;
+      }
+      int32_t shift = 0;
+      for (int32_t x = 0; x < width;)
+      {
+         Check(4);
+         if (data[0] == 1 && data[1] == 1 && data[2] == 1)
+         {
+            const int64_t count = int64_t(data[3]) << shift;
+            if (x == 0 || shift > 16 || count > width - x) throw std::runtime_error("Error decoding HDR file");
+            for (int64_t i = 0; i < count; i++, x++) std::memcpy(texels + x * 4, texels + (x - 1) * 4, 4);
+            shift += 8;
          }
          else
          {
-            *(output + i) = XMVectorGetX(result);
+            std::memcpy(texels + x * 4, data, 4);
+            x++;
+            shift = 0;
+         }
+         data += 4;
+      }
+      return data;
+   }
+
+   // Scanlines are decoded into a row of RGBE, and converted into the float format a texel per vector.
+   void DecodeHDRIntoMipZero(const uint8_t* fileData, int64_t fileSize, int64_t offset, GenericTexFmt format, uint8_t* destination, int32_t width)
+   {
+      const int32_t pixelSize = PixelSize[int32_t(format)];
+      std::vector<uint8_t> texels(size_t(width) * 4);
+      const uint8_t* data = fileData + offset;
+      for (int32_t y = 0; y < width; y++)
+      {
+         data = DecodeRGBEScanline(data, fileData + fileSize, texels.data(), width);
+         uint8_t* output = destination + int64_t(y) * width * pixelSize;
+         if (format == GenericTexFmt::Float_R16G16B16A16)
+         {
+            for (int32_t x = 0; x < width; x++) StoreHalf4(output + x * 8, LoadRGBE(&texels[x * 4]));
+         }
+         else
+         {
+            for (int32_t x = 0; x < width; x++) StoreFloat3PK(output + x * 4, LoadRGBE(&texels[x * 4]));
          }
       }
    }
 }
 
-GenericTextureInfo::GenericTextureInfo(GenericTexFmt format, int32_t width, bool bMips, CompressionMode compMode, bool bCube, int32_t arraySize) :
+GenericTextureInfo::GenericTextureInfo(GenericTexFmt format, int32_t width, bool bMips, CompressionMode compMode, bool bCube, int32_t arraySize, bool bSRGB) :
    _Format(format),
    _PixelSize(uint8_t(PixelSize[int32_t(format)])),
    _Width(uint16_t(width)),
    _ArrayCount(uint8_t(arraySize* (bCube ? 6 : 1))),
    _IsCubemap(bCube),
+   _IsSRGB(bSRGB),
    _CompressionMode(compMode)
 {
-   if (width < 4 || (width & (width - 1))) throw std::exception("Texture width restriction: w=2^n and w>=4");
+   if (width < 4 || (width & (width - 1))) throw std::runtime_error("Texture width restriction: w=2^n and w>=4");
    int32_t power = std::log2f(width);
    // The lowest mipmap limit is 4x4, needed by block compression.
    _MipCount = bMips ? power - 1 : 1;
-   _ArraySliceSize = bMips ? (((1 << (2 * _MipCount + 4)) - 16) / 3) * GetPixelSize() : GetMipZeroSize();
-   _MipZeroSize = _Width * _Width * _PixelSize;
-   _TotalSize = _ArrayCount * _ArraySliceSize;
+   _MipZeroSize = int64_t(_Width) * _Width * _PixelSize;
+   _ArraySliceSize = bMips ? ((int64_t(1) << (2 * _MipCount + 4)) - 16) / 3 * GetPixelSize() : GetMipZeroSize();
+   _TotalSize = int64_t(_ArrayCount) * _ArraySliceSize;
 }
 
-void Pillow::Graphics::LoadTexture(const string& relativePath)
+GenericTexture::GenericTexture(const GenericTextureInfo& info) :
+   Info(info),
+   Data(CreateAlignedMemory(info.GetTotalSize()))
 {
-   // Read the binary file.
-   string path = GetResourcePath(relativePath);
-   std::ifstream file(path, std::ios::binary | std::ios::ate);
-   if (!file.is_open()) throw std::runtime_error("Unable to open file");
-   std::streamsize size = file.tellg();
-   file.seekg(0, std::ios::beg);
-   std::vector<unsigned char> fileData(size);
-   if (size > 0 && !file.read((char*)fileData.data(), size)) throw std::runtime_error("Error reading file");
-   file.close();
-   // Decode it.
-   std::vector<unsigned char> imageData;
-   uint32_t w, h;
+}
+
+GenericTextureInfo Pillow::Graphics::InspectTexture(const uint8_t* fileData, int64_t fileSize, bool bSRGB, CompressionMode compMode, GenericTexFmt HDRFormat)
+{
+   int64_t offset;
+   if (IsHDRFile(fileData, fileSize)) return InspectHDR(fileData, fileSize, compMode, HDRFormat, offset);
    lodepng::State state;
-   //state.decoder.ignore_crc = 1;
-   //state.decoder.zlibsettings.ignore_adler32 = 1;
-   lodepng::decode(imageData, w, h, state, fileData);
-   if (state.info_raw.bitdepth != 8) throw std::exception("Bitdepth should be 8.");
-   if (w!=h) throw std::exception("The image should be square.");
-   GenericTextureInfo texInfo;
-   if (state.info_raw.colortype == LCT_GREY)
+   return InspectPNG(fileData, fileSize, bSRGB, compMode, state);
+}
+
+std::unique_ptr<GenericTexture> Pillow::Graphics::DecodeMipZero(const uint8_t* fileData, int64_t fileSize, bool bSRGB, CompressionMode compMode, GenericTexFmt HDRFormat)
+{
+   if (IsHDRFile(fileData, fileSize))
    {
-      texInfo = GenericTextureInfo(GenericTexFmt::UnsignedNormalized_R8, w);
+      int64_t offset;
+      auto texture = std::make_unique<GenericTexture>(InspectHDR(fileData, fileSize, compMode, HDRFormat, offset));
+      DecodeHDRIntoMipZero(fileData, fileSize, offset, HDRFormat, texture->GetSubresource(0, 0), texture->Info.GetWidth());
+      return texture;
    }
-   else if (state.info_raw.colortype == LCT_RGB)
+   lodepng::State state;
+   auto texture = std::make_unique<GenericTexture>(InspectPNG(fileData, fileSize, bSRGB, compMode, state));
+   if (DecodePNGIntoMipZero(fileData, fileSize, state, texture->GetSubresource(0, 0), texture->Info.GetWidth())) return texture;
+   // Palettes, color keys, low bit depths and interlacing go through the conversions of lodepng.
+   uint32_t w, h;
+   std::vector<unsigned char> imageData;
+   if (lodepng::decode(imageData, w, h, state, fileData, size_t(fileSize))) throw std::runtime_error("Error decoding PNG file");
+   std::memcpy(texture->GetSubresource(0, 0), imageData.data(), texture->Info.GetMipZeroSize());
+   return texture;
+}
+
+std::unique_ptr<GenericTexture> Pillow::Graphics::DecodeTexture(const uint8_t* fileData, int64_t fileSize, bool bSRGB, CompressionMode compMode, GenericTexFmt HDRFormat)
+{
+   auto texture = DecodeMipZero(fileData, fileSize, bSRGB, compMode, HDRFormat);
+   GenerateMips(*texture);
+   return texture;
+}
+
+std::unique_ptr<GenericTexture> Pillow::Graphics::LoadTexture(const string& relativePath, bool bSRGB, GenericTexFmt HDRFormat)
+{
+   // The file is mapped rather than read, the decoder reads it in place.
+   const MappedFile file(GetResourcePath(relativePath));
+   return DecodeTexture(file.GetData(), file.GetSize(), bSRGB, CompressionMode::HardwareWithDithering, HDRFormat);
+}
+
+std::vector<TextureLoadResult> Pillow::Graphics::LoadTextures(const std::vector<string>& relativePaths, const std::vector<bool>& sRGBFlags,
+   int32_t inFlightLimit, int32_t threadCount)
+{
+   using namespace std::chrono;
+   if (!sRGBFlags.empty() && sRGBFlags.size() != relativePaths.size()) throw std::runtime_error("The sRGB flags don't match the files.");
+   if (threadCount <= 0) threadCount = std::max(int32_t(std::thread::hardware_concurrency()), 1);
+   if (inFlightLimit > 0) threadCount = std::min(threadCount, inFlightLimit);
+   std::vector<TextureLoadResult> results(relativePaths.size());
+   ParallelFor(int32_t(relativePaths.size()), threadCount, [&](int32_t i)
+      {
+         TextureLoadResult& result = results[i];
+         auto Lap = [last = steady_clock::now()]() mutable
+            {
+               const steady_clock::time_point now = steady_clock::now();
+               const double milliseconds = duration<double, std::milli>(now - last).count();
+               last = now;
+               return milliseconds;
+            };
+         try
+         {
+            // The workers are busy with other files, so the mips take a single thread.
+            auto file = std::make_unique<MappedFile>(GetResourcePath(relativePaths[i]));
+            result.ReadMilliseconds = Lap();
+            result.Texture = DecodeMipZero(file->GetData(), file->GetSize(), !sRGBFlags.empty() && sRGBFlags[i]);
+            file.reset();
+            result.DecodeMilliseconds = Lap();
+            GenerateMips(*result.Texture, 1);
+            result.MipMilliseconds = Lap();
+         }
+         catch (...)
+         {
+            result.Texture.reset();
+            result.Error = std::current_exception();
+         }
+      });
+   return results;
+}
+
+std::unique_ptr<GenericTexture> Pillow::Graphics::CreateNormalMap(const GenericTexture& source, int32_t threadCount)
+{
+   const GenericTextureInfo& info = source.Info;
+   if (info.GetPixelSize() < 3 || info.GetIsSRGB() || IsFloatFormat(info.GetFormat())) throw std::runtime_error("A normal map needs linear X, Y and Z channels.");
+   auto normalMap = std::make_unique<GenericTexture>(GenericTextureInfo(GenericTexFmt::UnsignedNormalized_R8G8, info.GetWidth(), info.GetMipCount() > 1,
+      info.GetCompressionMode(), info.GetIsCubemap(), info.GetArrayCount() / (info.GetIsCubemap() ? 6 : 1)));
+   // Every subresource is split into tiles of rows, so mip 0 doesn't end up on a single worker.
+   struct Tile
    {
-      texInfo = GenericTextureInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, w);
+      int32_t Slice;
+      int32_t Mip;
+      int32_t FirstRow;
+   };
+   std::vector<Tile> tiles;
+   for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+   {
+      for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+      {
+         const int32_t width = info.GetMipWidth(mip);
+         const int32_t tileRows = std::clamp(MipTileSize / (width * info.GetPixelSize()), 1, width);
+         for (int32_t row = 0; row < width; row += tileRows) tiles.push_back(Tile{ slice, mip, row });
+      }
    }
-   else if (state.info_raw.colortype == LCT_RGBA)
+   ParallelFor(int32_t(tiles.size()), threadCount, [&](int32_t job)
+      {
+         const Tile& tile = tiles[job];
+         const int32_t width = info.GetMipWidth(tile.Mip);
+         const int32_t tileRows = std::clamp(MipTileSize / (width * info.GetPixelSize()), 1, width);
+         const int32_t first = tile.FirstRow * width, last = std::min(tile.FirstRow + tileRows, width) * width;
+         const uint8_t* input = source.GetSubresource(tile.Slice, tile.Mip);
+         uint8_t* output = normalMap->GetSubresource(tile.Slice, tile.Mip);
+         for (int32_t i = first; i < last; i++) RenormalizeNormal(input + i * info.GetPixelSize(), output + i * 2);
+      });
+   return normalMap;
+}
+
+std::unique_ptr<GenericTexture> Pillow::Graphics::LoadNormalMap(const string& relativePath)
+{
+   return CreateNormalMap(*LoadTexture(relativePath, false));
+}
+
+void Pillow::Graphics::GenerateMips(GenericTexture& texture, int32_t threadCount)
+{
+   const GenericTextureInfo& info = texture.Info;
+   const int32_t channels = info.GetPixelSize();
+   // Levels depend on their previous ones, so they go one by one. The tiles of all the array slices run together.
+   for (int32_t mip = 1; mip < info.GetMipCount(); mip++)
    {
-      texInfo = GenericTextureInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, w);
+      const int32_t width = info.GetMipWidth(mip);
+      const int32_t tileRows = std::clamp(MipTileSize / (width * channels), 1, width);
+      const int32_t tileCount = (width + tileRows - 1) / tileRows;
+      ParallelFor(info.GetArrayCount() * tileCount, threadCount, [&](int32_t job)
+         {
+            const int32_t slice = job / tileCount;
+            const int32_t firstRow = (job % tileCount) * tileRows;
+            if (IsFloatFormat(info.GetFormat()))
+            {
+               BicubicDownsamplingHDR(texture.GetSubresource(slice, mip - 1), texture.GetSubresource(slice, mip), info.GetMipWidth(mip - 1), info.GetFormat(),
+                  firstRow, std::min(tileRows, width - firstRow));
+            }
+            else
+            {
+               BicubicDownsampling(texture.GetSubresource(slice, mip - 1), texture.GetSubresource(slice, mip), info.GetMipWidth(mip - 1), channels,
+                  info.GetIsSRGB(), firstRow, std::min(tileRows, width - firstRow));
+            }
+         });
    }
+}
 
-}
\ No newline at end of file
+void Pillow::Graphics::BenchmarkDownsampling(int32_t channels)
+{
+   using namespace std::chrono;
+   LogSystem("Width  Reference(ms)  Separable(ms)  Speedup  MaxDiff  sRGB(ms)");
+   for (int32_t width = 256; width <= 8192; width *= 2)
+   {
+      const int32_t inputSize = width * width * channels;
+      const int32_t outputSize = inputSize / 4;
+      std::unique_ptr<CacheLine[]> memory = CreateAlignedMemory(int64_t(inputSize) + outputSize * 2);
+      uint8_t* input = reinterpret_cast<uint8_t*>(memory.get());
+      uint8_t* reference = input + inputSize;
+      uint8_t* separable = reference + outputSize;
+      // Gradients with noise, so that both the smooth areas and the overshoots are covered.
+      uint32_t random = 1;
+      for (int32_t i = 0; i < inputSize; i++)
+      {
+         random = random * 1664525u + 1013904223u;
+         input[i] = uint8_t(((i / channels) % width + (i / channels) / width) / 4 + (random >> 28));
+      }
+      // Small levels are repeated, to get measurable times.
+      const int32_t repeats = std::max(1024 / width, 1);
+      auto Measure = [&](auto downsampling, uint8_t* output) -> double
+         {
+            auto start = steady_clock::now();
+            for (int32_t i = 0; i < repeats; i++) downsampling(input, output, width, channels, 0, width / 2);
+            return duration_cast<duration<double, std::milli>>(steady_clock::now() - start).count() / repeats;
+         };
+      const double referenceTime = Measure(BicubicDownsamplingReference, reference);
+      const double sRGBTime = Measure([](const uint8_t* input, uint8_t* output, int32_t inputWidth, int32_t channels, int32_t firstRow, int32_t rowCount)
+         {
+            BicubicDownsampling(input, output, inputWidth, channels, true, firstRow, rowCount);
+         }, separable);
+      const double separableTime = Measure([](const uint8_t* input, uint8_t* output, int32_t inputWidth, int32_t channels, int32_t firstRow, int32_t rowCount)
+         {
+            BicubicDownsampling(input, output, inputWidth, channels, false, firstRow, rowCount);
+         }, separable);
+      int32_t maxDiff = 0;
+      for (int32_t i = 0; i < outputSize; i++) maxDiff = std::max(maxDiff, std::abs(int32_t(reference[i]) - separable[i]));
+      char line[128];
+      std::snprintf(line, sizeof(line), "%5d  %13.3f  %13.3f  %6.2fx  %7d  %8.3f", width, referenceTime, separableTime, referenceTime / separableTime, maxDiff, sRGBTime);
+      LogSystem(line);
+   }
+}
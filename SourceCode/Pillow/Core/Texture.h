@@ -9,18 +9,40 @@ namespace Pillow::Graphics
    enum class CompressionMode : uint8_t
    {
       None,
+      // BC1 to BC5, for D3D12.
       Hardware,
-      HardwareWithDithering
+      HardwareWithDithering,
+      // ETC2 and EAC, or ASTC of 4x4 / 6x6 texel blocks, for GLES32 where the BC formats aren't available.
+      ETC2,
+      ASTC4x4,
+      ASTC6x6,
+      // BC7 of UnsignedNormalized_R8G8B8A8 for D3D12, the size of BC3 at a higher quality. The other formats throw.
+      BC7,
+      Count
+   };
+
+   // The search effort of the BC encoders, the comments of the values are about BC6H and BC7.
+   // BC1 to BC5: Fast keeps the range of the block(the oriented diagonal of its bounding box), Normal refines the end points
+   // by 8 Newton steps, Slow by 16, trying every orientation of the diagonal, both BC4 codecs and the neighbors of the end points.
+   enum class EncodeQuality : uint8_t
+   {
+      Fast, // A single mode, with the end points of the principal axis.
+      Normal, // The common modes and the best estimated partitions, with a refinement of the end points.
+      Slow // All the supported modes, more partitions and more refinements.
    };
 
    enum class GenericTexFmt : uint8_t
    {
-      // 1.Supports .hdr files.
+      // 1.Supports .hdr files, they are decoded into one of the float formats.
       // 2.R8G8B8 isn't supported in DXGI_FORMAT, use R8G8B8A8 to store it.
       UnsignedNormalized_R8G8B8A8,
       UnsignedNormalized_R8G8B8,
       UnsignedNormalized_R8G8,
       UnsignedNormalized_R8,
+      // Linear HDR colors in [0, 65504], the alpha of .hdr files is 1.
+      Float_R16G16B16A16,
+      // Half the size of the above, without alpha. R and G have 6 mantissa bits, B has 5.
+      Float_R11G11B10,
       Count
    };
 
@@ -30,8 +52,15 @@ namespace Pillow::Graphics
       3, // UnsignedNormalized_R8G8B8
       2, // UnsignedNormalized_R8G8
       1, // UnsignedNormalized_R8
+      8, // Float_R16G16B16A16
+      4, // Float_R11G11B10
    };
 
+   ForceInline bool IsFloatFormat(GenericTexFmt format)
+   {
+      return format == GenericTexFmt::Float_R16G16B16A16 || format == GenericTexFmt::Float_R11G11B10;
+   }
+
    //                     Subresource Indexing                       //
    //                                         ______________________ //
    // subres(0) subres(3) -> Row: Mip Slice 0 |subres(6) subres(9) | //
@@ -50,11 +79,14 @@ namespace Pillow::Graphics
          ReadonlyProperty(uint8_t, MipCount)
          ReadonlyProperty(uint8_t, ArrayCount)
          ReadonlyProperty(bool, IsCubemap)
+         // The color channels are sRGB encoded, and filtered in linear light.
+         ReadonlyProperty(bool, IsSRGB)
          ReadonlyProperty(CompressionMode, CompressionMode)
          // Size
-         ReadonlyProperty(uint16_t, MipZeroSize)
-         ReadonlyProperty(uint16_t, ArraySliceSize)
-         ReadonlyProperty(uint16_t, TotalSize)
+         // 64-bit, a 16384^2 Float_R16G16B16A16 mip is 2GB.
+         ReadonlyProperty(int64_t, MipZeroSize)
+         ReadonlyProperty(int64_t, ArraySliceSize)
+         ReadonlyProperty(int64_t, TotalSize)
 
    public:
       static const int32_t MaxArraySize = UINT8_MAX;
@@ -62,16 +94,86 @@ namespace Pillow::Graphics
 
       GenericTextureInfo() = default;
       GenericTextureInfo(const GenericTextureInfo&) = default;
-      GenericTextureInfo(GenericTexFmt format, int32_t width,  bool bMips = true, CompressionMode compMode = CompressionMode::HardwareWithDithering, bool bCube = false, int32_t arraySize = 1);
+      GenericTextureInfo(GenericTexFmt format, int32_t width,  bool bMips = true, CompressionMode compMode = CompressionMode::HardwareWithDithering, bool bCube = false, int32_t arraySize = 1, bool bSRGB = false);
+
+      ForceInline int32_t GetMipWidth(int32_t mip) const { return _Width >> mip; }
+      ForceInline int64_t GetMipSize(int32_t mip) const { return int64_t(GetMipWidth(mip)) * GetMipWidth(mip) * _PixelSize; }
+      // The offset of a mip level from the start of its array slice: sum of (w/2^i)^2 for i < mip = (w^2 - (w/2^mip)^2) * 4/3.
+      ForceInline int64_t GetMipOffset(int32_t mip) const
+      {
+         const int64_t mipWidth = GetMipWidth(mip);
+         return (int64_t(_Width) * _Width - mipWidth * mipWidth) * 4 / 3 * _PixelSize;
+      }
+      ForceInline int64_t GetSubresourceOffset(int32_t arraySlice, int32_t mip) const { return int64_t(arraySlice) * _ArraySliceSize + GetMipOffset(mip); }
    };
 
    class GenericTexture
    {
+      DeleteDefautedMethods(GenericTexture)
+
    public:
       const GenericTextureInfo Info;
+      // Texels in SubRes[Array][Mip] order, ArraySliceSize bytes per array slice.
+      const std::unique_ptr<CacheLine[]> Data;
+
+      GenericTexture(const GenericTextureInfo& info);
+
+      ForceInline uint8_t* GetSubresource(int32_t arraySlice, int32_t mip) const
+      {
+         return reinterpret_cast<uint8_t*>(Data.get()) + Info.GetSubresourceOffset(arraySlice, mip);
+      }
+   };
+
+   // Decode a PNG file, or a Radiance .hdr file(RGBE, flat or run-length encoded, in the -Y h +X w orientation), and generate its full mip chain.
+   // Color textures like albedo should be sRGB, so their mips are filtered in linear light. The .hdr files are linear already,
+   // bSRGB doesn't apply to them, and they are decoded into HDRFormat.
+   std::unique_ptr<GenericTexture> LoadTexture(const string& relativePath, bool bSRGB = false, GenericTexFmt HDRFormat = GenericTexFmt::Float_R16G16B16A16);
+
+   struct TextureLoadResult
+   {
+      // Null if the load failed, then Error is set.
+      std::unique_ptr<GenericTexture> Texture;
+      std::exception_ptr Error;
+      double ReadMilliseconds{};
+      double DecodeMilliseconds{};
+      double MipMilliseconds{};
    };
 
-   void LoadTexture(const string& relativePath);
+   // LoadTexture() for many files at once, the results are in the order of relativePaths.
+   // Every file is read, decoded and mipmapped by a single worker, so the reads and decodes of different files overlap.
+   // At most inFlightLimit files are loaded at a time(0 = no limit besides threadCount), which bounds the memory of
+   // the file data and the decoding buffers. sRGBFlags is per file, empty means none of them.
+   std::vector<TextureLoadResult> LoadTextures(const std::vector<string>& relativePaths, const std::vector<bool>& sRGBFlags = {},
+      int32_t inFlightLimit = 0, int32_t threadCount = 0);
+
+   // The same as LoadTexture(), for a PNG or .hdr file already in memory.
+   std::unique_ptr<GenericTexture> DecodeTexture(const uint8_t* fileData, int64_t fileSize, bool bSRGB = false, CompressionMode compMode = CompressionMode::HardwareWithDithering,
+      GenericTexFmt HDRFormat = GenericTexFmt::Float_R16G16B16A16);
+
+   // The same as DecodeTexture(), but only mip 0 is filled.
+   std::unique_ptr<GenericTexture> DecodeMipZero(const uint8_t* fileData, int64_t fileSize, bool bSRGB = false, CompressionMode compMode = CompressionMode::HardwareWithDithering,
+      GenericTexFmt HDRFormat = GenericTexFmt::Float_R16G16B16A16);
+
+   // The info DecodeTexture() would give, read from the PNG or .hdr header only.
+   GenericTextureInfo InspectTexture(const uint8_t* fileData, int64_t fileSize, bool bSRGB = false, CompressionMode compMode = CompressionMode::HardwareWithDithering,
+      GenericTexFmt HDRFormat = GenericTexFmt::Float_R16G16B16A16);
+
+   // Convert a tangent space normal map in R8G8B8(A8) into UnsignedNormalized_R8G8, which compresses to BC5.
+   // Every texel, the filtered ones of the mips too, is renormalized before Z is dropped, see ReconstructNormal().
+   // The texels are split into tiles, processed by threadCount workers(0 = all hardware threads).
+   std::unique_ptr<GenericTexture> CreateNormalMap(const GenericTexture& source, int32_t threadCount = 0);
+
+   // LoadTexture() in linear space, then CreateNormalMap().
+   std::unique_ptr<GenericTexture> LoadNormalMap(const string& relativePath);
+
+   // Fill the mips [1, MipCount) of every array slice from mip 0, with a Catmull-Rom 2x downsampling per level.
+   // The float formats are filtered in floats, and clamped to [0, the largest value of the format].
+   // A level is split into horizontal tiles, processed by threadCount workers(0 = all hardware threads).
+   void GenerateMips(GenericTexture& texture, int32_t threadCount = 0);
+
+   // Time the separable downsampling against the direct 4x4 kernel on a single thread, for widths 256 to 8192.
+   // Logs the milliseconds per level, the speedup, the largest difference of a channel, and the time of the sRGB mode.
+   void BenchmarkDownsampling(int32_t channels = 4);
 
 
    ForceInline void ColorFloat2Byte(uint8_t& destination, float color)
@@ -103,6 +205,14 @@ namespace Pillow::Graphics
       destination = XMVectorMultiply(v1, v2);
    }
 
+   // The unit normal of the X and Y in [0, 1] of an R8G8 or BC5 texel, the shaders reconstruct Z the same way.
+   ForceInline XMVECTOR XM_CALLCONV ReconstructNormal(float x, float y)
+   {
+      x = x * 2 - 1;
+      y = y * 2 - 1;
+      return XMVectorSet(x, y, std::sqrt(std::max(1 - x * x - y * y, 0.f)), 0);
+   }
+
    ForceInline XMVECTOR XM_CALLCONV DecodeRGB565(const uint16_t color)
    {
       XMVECTOR result = XMVectorSet((color >> 11) & 31, (color >> 5) & 63, (color >> 0) & 31, 0);
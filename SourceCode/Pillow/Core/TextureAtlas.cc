@@ -0,0 +1,71 @@
+#include "TextureAtlas.h"
+#include "cstring"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   ForceInline bool IsCompatible(const GenericTextureInfo& left, const GenericTextureInfo& right)
+   {
+      return left.GetFormat() == right.GetFormat() && left.GetWidth() == right.GetWidth() && left.GetMipCount() == right.GetMipCount() &&
+         left.GetCompressionMode() == right.GetCompressionMode() && left.GetIsSRGB() == right.GetIsSRGB() && left.GetIsCubemap() == right.GetIsCubemap();
+   }
+
+   // A cube array holds whole cubes.
+   ForceInline int32_t GetSliceCapacity(const GenericTextureInfo& info)
+   {
+      return info.GetIsCubemap() ? GenericTextureInfo::MaxArraySize / 6 * 6 : GenericTextureInfo::MaxArraySize;
+   }
+}
+
+TextureArrayPlan Pillow::Graphics::PlanTextureArrays(const std::vector<GenericTextureInfo>& sources)
+{
+   struct OpenArray
+   {
+      GenericTextureInfo Info;
+      int32_t SliceCount;
+   };
+
+   std::vector<OpenArray> arrays;
+   TextureArrayPlan plan;
+   plan.Remap.reserve(sources.size());
+   for (const GenericTextureInfo& source : sources)
+   {
+      const int32_t slices = source.GetArrayCount();
+      auto it = std::find_if(arrays.begin(), arrays.end(), [&](const OpenArray& array)
+         {
+            return IsCompatible(array.Info, source) && array.SliceCount + slices <= GetSliceCapacity(source);
+         });
+      if (it == arrays.end()) it = arrays.insert(arrays.end(), OpenArray{ source, 0 });
+      plan.Remap.push_back(TextureArraySlice{ int32_t(it - arrays.begin()), it->SliceCount });
+      it->SliceCount += slices;
+   }
+   plan.Arrays.reserve(arrays.size());
+   for (const OpenArray& array : arrays)
+   {
+      const GenericTextureInfo& info = array.Info;
+      plan.Arrays.emplace_back(info.GetFormat(), info.GetWidth(), info.GetMipCount() > 1, info.GetCompressionMode(), info.GetIsCubemap(),
+         array.SliceCount / (info.GetIsCubemap() ? 6 : 1), info.GetIsSRGB());
+   }
+   return plan;
+}
+
+TextureArrayAtlas Pillow::Graphics::BuildTextureArrays(const std::vector<const GenericTexture*>& sources)
+{
+   std::vector<GenericTextureInfo> infos;
+   infos.reserve(sources.size());
+   for (const GenericTexture* source : sources) infos.push_back(source->Info);
+   TextureArrayPlan plan = PlanTextureArrays(infos);
+   TextureArrayAtlas atlas;
+   atlas.Arrays.reserve(plan.Arrays.size());
+   for (const GenericTextureInfo& info : plan.Arrays) atlas.Arrays.push_back(std::make_unique<GenericTexture>(info));
+   // The array slices of a source, with all their mips, are contiguous in SubRes[Array][Mip] order.
+   for (size_t i = 0; i < sources.size(); i++)
+   {
+      const TextureArraySlice& slice = plan.Remap[i];
+      std::memcpy(atlas.Arrays[slice.Array]->GetSubresource(slice.FirstSlice, 0), sources[i]->Data.get(), sources[i]->Info.GetTotalSize());
+   }
+   atlas.Remap = std::move(plan.Remap);
+   return atlas;
+}
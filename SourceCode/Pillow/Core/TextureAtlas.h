@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include "Auxiliaries.h"
+#include "Texture.h"
+
+namespace Pillow::Graphics
+{
+   // Where a source texture ended up: materials bind Arrays[Array], and sample from its array slice FirstSlice on.
+   // For cubemaps, FirstSlice / 6 is the index of the cube.
+   struct TextureArraySlice
+   {
+      int32_t Array;
+      int32_t FirstSlice;
+   };
+
+   struct TextureArrayPlan
+   {
+      std::vector<GenericTextureInfo> Arrays;
+      // One per source, in the order of the sources.
+      std::vector<TextureArraySlice> Remap;
+   };
+
+   struct TextureArrayAtlas
+   {
+      std::vector<std::unique_ptr<GenericTexture>> Arrays;
+      std::vector<TextureArraySlice> Remap;
+   };
+
+   // Group the textures with the same format, width, mips, compression, color space and cubemap flag,
+   // into arrays of up to MaxArraySize slices, so they share a descriptor and a binding.
+   // The sources are packed first fit in their order, and the arrays are in the order they're opened,
+   // so the same sources always give the same plan.
+   TextureArrayPlan PlanTextureArrays(const std::vector<GenericTextureInfo>& sources);
+
+   // PlanTextureArrays(), then copy the sources with their mips into the arrays.
+   TextureArrayAtlas BuildTextureArrays(const std::vector<const GenericTexture*>& sources);
+}
@@ -0,0 +1,1228 @@
+#include "TextureCompression.h"
+#include "DirectXMath-apr2025/DirectXPackedVector.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+using namespace DirectX;
+using namespace std::chrono;
+
+namespace
+{
+   // A mip level of an array slice, whose block rows are compressed independently.
+   struct MipTask
+   {
+      const uint8_t* texels;
+      uint8_t* destination;
+      int32_t width;
+      int32_t firstRow; // The index of its first block row among all the tasks.
+   };
+
+   // The diagonal of the bounding box is oriented along direction(0 to 3), or the one fitting the block best if it's negative.
+   // Then the end points are refined by up to iterations Newton steps.
+   void XM_CALLCONV OptimizeRGB(XMVECTOR& color0, XMVECTOR& color1, const XMVECTOR* block, int32_t iterations, int32_t direction)
+   {
+      const uint32_t steps = 4;
+      constexpr float fEpsilon = (0.25f / 64.f) * (0.25f / 64.f);
+      static constexpr float pC[] = { 1, 2.f / 3.f, 1.f / 3.f, 0 };
+      static constexpr float pD[] = { pC[3], pC[2], pC[1], pC[0] };
+      // Find Min and Max points, as starting point
+      XMVECTOR c0 = RGBLuminance;
+      XMVECTOR c1 = XMVectorZero();
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         XMVECTOR select = XMVectorLess(block[i], c0);
+         c0 = XMVectorSelect(c0, block[i], select);
+         select = XMVectorGreater(block[i], c1);
+         c1 = XMVectorSelect(c1, block[i], select);
+      }
+      // Diagonal axis
+      const XMVECTOR AB = XMVectorSubtract(c1, c0);
+      const float fAB = XMVectorGetX(XMVector3Dot(AB, AB));
+      // Single color block.. no need to root-find
+      if (fAB < FLT_MIN)
+      {
+         color0 = c0;
+         color1 = c1;
+         return;
+      }
+      // Try all four axis directions, to determine which diagonal best fits data
+      XMVECTOR dir = XMVectorScale(AB, 1.f / fAB);
+      int32_t iDirMax = direction;
+      if (direction < 0)
+      {
+         const XMVECTOR Mid = XMVectorLerp(c0, c1, 0.5f);
+         XMVECTOR fDir = XMVectorZero();
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            XMVECTOR pt = XMVectorMultiply(XMVectorSubtract(block[i], Mid), dir);
+            XMFLOAT3A _pt;
+            XMStoreFloat3A(&_pt, pt);
+            XMVECTOR f = XMVectorReplicate(_pt.x);
+            f = XMVectorAdd(f, XMVectorSet(_pt.y, _pt.y, -_pt.y, -_pt.y));
+            f = XMVectorAdd(f, XMVectorSet(_pt.z, -_pt.z, _pt.z, -_pt.z));
+            fDir = XMVectorMultiplyAdd(f, f, fDir);
+         }
+         XMFLOAT4A _fDir {};
+         XMStoreFloat4A(&_fDir, fDir);
+         float fDirMax = _fDir.x;
+         iDirMax = 0;
+         const float* dirs = &_fDir.x;
+         for (int32_t i = 1; i < 4; i++)
+         {
+            if (dirs[i] <= fDirMax) continue;
+            fDirMax = dirs[i];
+            iDirMax = i;
+         }
+      }
+      if (iDirMax & 2)
+      {
+         const XMVECTOR select = XMVectorSelectControl(0, 1, 0, 0);
+         XMVECTOR temp = c0;
+         c0 = XMVectorSelect(c0, c1, select);
+         c1 = XMVectorSelect(c1, temp, select);
+      }
+      if (iDirMax & 1)
+      {
+         const XMVECTOR select = XMVectorSelectControl(0, 0, 1, 0);
+         XMVECTOR temp = c0;
+         c0 = XMVectorSelect(c0, c1, select);
+         c1 = XMVectorSelect(c1, temp, select);
+      }
+      // Two color block.. no need to root-find
+      if (fAB < 1.f / 4096.f)
+      {
+         color0 = c0;
+         color1 = c1;
+         return;
+      }
+      // Use Newton's Method to find local minima of sum-of-squares error.
+      const float fSteps = steps - 1;
+      for (int32_t i = 0; i < iterations; i++)
+      {
+         // Calculate new steps
+         XMVECTOR pSteps[4];
+         for (size_t iStep = 0; iStep < steps; iStep++)
+         {
+            pSteps[iStep] = XMVectorAdd(XMVectorScale(c0, pC[iStep]), XMVectorScale(c1, pD[iStep]));
+         }
+         // Calculate color direction
+         dir = XMVectorSubtract(c1, c0);
+         const float fLen = XMVectorGetX(XMVector3Dot(dir, dir));
+         if (fLen < (1.0f / 4096.0f)) break;
+         dir = XMVectorScale(dir, fSteps / fLen);
+         // Evaluate function, and derivatives
+         float d2X = 0;
+         float d2Y = 0;
+         XMVECTOR dX = XMVectorZero();
+         XMVECTOR dY = XMVectorZero();
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            const float fDot = XMVectorGetX(XMVector3Dot(XMVectorSubtract(block[i], c0), dir));
+            uint32_t iStep;
+            if (fDot <= 0) iStep = 0;
+            else if (fDot >= fSteps) iStep = steps - 1;
+            else iStep = fDot + 0.5f;
+            XMVECTOR diff = XMVectorSubtract(pSteps[iStep], block[i]);
+            const float fC = pC[iStep] * (1.f / 8.f);
+            const float fD = pD[iStep] * (1.f / 8.f);
+            d2X += fC * pC[iStep];
+            dX = XMVectorAdd(dX, XMVectorScale(diff, fC));
+            d2Y += fD * pD[iStep];
+            dY = XMVectorAdd(dY, XMVectorScale(diff, fD));
+         }
+         // Move endpoints
+         if (d2X > 0) c0 = XMVectorAdd(c0, XMVectorScale(dX, -1 / d2X));
+         if (d2Y > 0) c1 = XMVectorAdd(c1, XMVectorScale(dY, -1 / d2Y));
+         XMVECTOR cmp1 = XMVectorLess(XMVectorMultiply(dX, dX), XMVectorReplicate(fEpsilon));
+         XMVECTOR cmp2 = XMVectorLess(XMVectorMultiply(dY, dY), XMVectorReplicate(fEpsilon));
+         XMVECTOR cmp = XMVectorAndInt(cmp1, cmp2);
+         cmp = XMVectorAndInt(XMVectorAndInt(cmp, XMVectorSplatY(cmp)), XMVectorSplatZ(cmp));
+         if (XMVectorGetIntX(cmp)) break;
+      }
+      color0 = c0;
+      color1 = c1;
+   }
+
+   void OptimizeAlpha(float& colorMin, float& colorMax, const float* block, uint32_t steps, int32_t iterations)
+   {
+      static constexpr float pC6[] = { 1, 4.f / 5.f, 3.f / 5.f, 2.f / 5.f, 1.f / 5.f, 0 };
+      static constexpr float pD6[] = { pC6[5], pC6[4], pC6[3], pC6[2], pC6[1], pC6[0] };
+      static constexpr float pC8[] = { 1, 6.f / 7.f, 5.f / 7.f, 4.f / 7.f, 3.f / 7.f, 2.f / 7.f, 1.f / 7.f, 0 };
+      static constexpr float pD8[] = { pC8[7], pC8[6], pC8[5], pC8[4], pC8[3], pC8[2], pC8[1], pC8[0] };
+      const float* pC = (6 == steps) ? pC6 : pC8;
+      const float* pD = (6 == steps) ? pD6 : pD8;
+      // Find Min and Max points, as starting point
+      float _min = 1;
+      float _max = 0;
+      for (size_t i = 0; i < BCBlockLength; i++)
+      {
+         if (block[i] < _min) _min = block[i];
+         if (block[i] > _max) _max = block[i];
+      }
+      if (steps == 6 && _min == _max) _max = 1;
+      // Use Newton's Method to find local minima of sum-of-squares error.
+      const float fSteps = steps - 1;
+      for (int32_t i = 0; i < iterations; i++)
+      {
+         if ((_max - _min) < (1.0f / 256.0f)) break;
+         float const fScale = fSteps / (_max - _min);
+         // Calculate new steps
+         float pSteps[8];
+         for (size_t iStep = 0; iStep < steps; iStep++)
+            pSteps[iStep] = pC[iStep] * _min + pD[iStep] * _max;
+         if (steps == 6)
+         {
+            pSteps[6] = 0;
+            pSteps[7] = 1;
+         }
+         // Evaluate function, and derivatives
+         float dX = 0.0f;
+         float dY = 0.0f;
+         float d2X = 0.0f;
+         float d2Y = 0.0f;
+         for (int32_t iPoint = 0; iPoint < BCBlockLength; iPoint++)
+         {
+            const float fDot = (block[iPoint] - _min) * fScale;
+            uint32_t iStep;
+            if (fDot <= 0.0f)
+            {
+               iStep = (steps == 6 && block[iPoint] <= _min * 0.5f) ? 6u : 0u;
+            }
+            else if (fDot >= fSteps)
+            {
+               iStep = (steps == 6 && block[iPoint] >= (_max + 1) * 0.5f) ? 7u : (steps - 1);
+            }
+            else
+            {
+               iStep = fDot + 0.5f;
+            }
+            if (iStep < steps)
+            {
+               // D3DX had this computation backwards (pPoints[iPoint] - pSteps[iStep])
+               // this fix improves RMS of the alpha component
+               const float fDiff = pSteps[iStep] - block[iPoint];
+               dX += pC[iStep] * fDiff;
+               d2X += pC[iStep] * pC[iStep];
+               dY += pD[iStep] * fDiff;
+               d2Y += pD[iStep] * pD[iStep];
+            }
+         }
+         // Move endpoints
+         if (d2X > 0.0f) _min -= dX / d2X;
+         if (d2Y > 0.0f) _max -= dY / d2Y;
+         if (_min > _max) std::swap(_min, _max);
+         if (dX * dX < 1.f / 64.f && dY * dY < 1.f / 64.f) break;
+      }
+      colorMin = std::clamp(_min, 0.f, 1.f);
+      colorMax = std::clamp(_max, 0.f, 1.f);
+   }
+
+   // Quantize the end points of OptimizeRGB(), and encode the block with them.
+   // Returns the squared error of the block in the perceptual space, the dithering isn't counted.
+   float XM_CALLCONV EncodeBC1EndPoints(const XMFLOAT4A* blockRGB, FXMVECTOR color0, FXMVECTOR color1, uint8_t* destination, bool RGBDithering)
+   {
+      const uint32_t uSteps = 4;
+      XMVECTOR ColorA, ColorB, ColorC, ColorD;
+      ColorC = XMVectorMultiply(color0, RGBLuminanceInv);
+      ColorD = XMVectorMultiply(color1, RGBLuminanceInv);
+      uint16_t wColorA = EncodeRGB565(ColorC);
+      uint16_t wColorB = EncodeRGB565(ColorD);
+      float error = 0;
+      if (wColorA == wColorB)
+      {
+         reinterpret_cast<uint16_t*>(destination)[0] = wColorA;
+         reinterpret_cast<uint16_t*>(destination)[1] = wColorA;
+         reinterpret_cast<uint32_t*>(destination)[1] = 0x0;
+         const XMVECTOR color = XMVectorMultiply(DecodeRGB565(wColorA), RGBLuminance);
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            const XMVECTOR diff = XMVectorSubtract(XMVectorMultiply(XMLoadFloat4A(&blockRGB[i]), RGBLuminance), color);
+            error += XMVectorGetX(XMVector3Dot(diff, diff));
+         }
+         return error;
+      }
+      // The 4-color mode requires C0 > C1, otherwise the block is decoded in the 3-color mode.
+      if (wColorA > wColorB) std::swap(wColorA, wColorB);
+      ColorC = DecodeRGB565(wColorA);
+      ColorD = DecodeRGB565(wColorB);
+      ColorA = XMVectorMultiply(ColorC, RGBLuminance);
+      ColorB = XMVectorMultiply(ColorD, RGBLuminance);
+      // Calculate color steps
+      XMVECTOR Step[4];
+      reinterpret_cast<uint16_t*>(destination)[0] = wColorB;
+      reinterpret_cast<uint16_t*>(destination)[1] = wColorA;
+      Step[0] = ColorB;
+      Step[1] = ColorA;
+      static const int32_t pSteps[] = { 0, 2, 3, 1 };
+      Step[2] = XMVectorLerp(Step[0], Step[1], 1 / 3.f);
+      Step[3] = XMVectorLerp(Step[0], Step[1], 2 / 3.f);
+      // Calculate color direction
+      XMVECTOR Dir;
+      Dir = Step[1] - Step[0];
+      const float fSteps = uSteps - 1;
+      const float fScale = fSteps / XMVectorGetX(XMVector3Dot(Dir, Dir));
+      Dir = XMVectorScale(Dir, fScale);
+      // Encode colors, 2 bits per pixel
+      uint32_t encodedIndices = 0;
+      XMVECTOR errors[BCBlockLength];
+      if (RGBDithering) for (int32_t i = 0; i < BCBlockLength; i++) errors[i] = XMVectorZero();
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         XMVECTOR c = XMLoadFloat4A(&blockRGB[i]);
+         c = XMVectorMultiply(c, RGBLuminance);
+         const XMVECTOR original = c;
+         if (RGBDithering) c = XMVectorAdd(c, errors[i]);
+         const float fDot = XMVectorGetX(XMVector3Dot(XMVectorSubtract(c, Step[0]), Dir));
+         uint32_t iStep;
+         if (fDot <= 0.0f) iStep = 0;
+         else if (fDot >= fSteps) iStep = 1;
+         else iStep = pSteps[uint32_t(fDot + 0.5f)];
+         encodedIndices = (iStep << 30) | (encodedIndices >> 2);
+         const XMVECTOR quantizationError = XMVectorSubtract(original, Step[iStep]);
+         error += XMVectorGetX(XMVector3Dot(quantizationError, quantizationError));
+         if (!RGBDithering) continue;
+         XMVECTOR diff = XMVectorSubtract(c, Step[iStep]);
+         if (3 != (i & 3))
+         {
+            const XMVECTOR factor = XMVectorReplicate(7.f / 16.f);
+            errors[i + 1] = XMVectorMultiplyAdd(diff, factor, errors[i + 1]);
+         }
+         if (i < 12)
+         {
+            const XMVECTOR factor = XMVectorReplicate(5.f / 16.f);
+            errors[i + 4] = XMVectorMultiplyAdd(diff, factor, errors[i + 4]);
+            if (i & 3)
+            {
+               const XMVECTOR factor = XMVectorReplicate(3.f / 16.f);
+               errors[i + 3] = XMVectorMultiplyAdd(diff, factor, errors[i + 3]);
+            }
+            if (3 != (i & 3))
+            {
+               const XMVECTOR factor = XMVectorReplicate(1.f / 16.f);
+               errors[i + 5] = XMVectorMultiplyAdd(diff, factor, errors[i + 5]);
+            }
+         }
+      }
+      reinterpret_cast<uint32_t*>(destination)[1] = encodedIndices;
+      return error;
+   }
+
+   // Solve the end points which fit the block best with the indices of an encoded BC1 block, by least squares.
+   // Returns false if the indices can't determine both end points.
+   bool XM_CALLCONV SolveBC1EndPoints(const XMFLOAT4A* blockRGB, const uint8_t* encoded, XMVECTOR& color0, XMVECTOR& color1)
+   {
+      // The position on the axis of every index.
+      static constexpr float weights[] = { 0, 1, 1 / 3.f, 2 / 3.f };
+      uint32_t indices;
+      memcpy(&indices, encoded + 4, sizeof(indices));
+      float aa = 0, ab = 0, bb = 0;
+      XMVECTOR ax = XMVectorZero(), bx = XMVectorZero();
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const float b = weights[(indices >> (2 * i)) & 3], a = 1 - b;
+         const XMVECTOR x = XMVectorMultiply(XMLoadFloat4A(&blockRGB[i]), RGBLuminance);
+         aa += a * a;
+         ab += a * b;
+         bb += b * b;
+         ax = XMVectorMultiplyAdd(x, XMVectorReplicate(a), ax);
+         bx = XMVectorMultiplyAdd(x, XMVectorReplicate(b), bx);
+      }
+      const float determinant = aa * bb - ab * ab;
+      if (determinant < FLT_EPSILON) return false;
+      color0 = XMVectorScale(XMVectorSubtract(XMVectorScale(ax, bb), XMVectorScale(bx, ab)), 1 / determinant);
+      color1 = XMVectorScale(XMVectorSubtract(XMVectorScale(bx, aa), XMVectorScale(ax, ab)), 1 / determinant);
+      return true;
+   }
+
+   // Encode a BC4 block with the quantized end points, whose order selects the codec.
+   // Returns the squared error of the block in 8-bit units.
+   float EncodeBC4EndPoints(const float* block, uint8_t c0, uint8_t c1, uint8_t* destination)
+   {
+      destination[0] = c0;
+      destination[1] = c1;
+      // Step 2: Compute indices, which follows the below mapping:
+      // 0:C0, 1:C1, 2:Interpolation1, ..., 5:Interpolation4, 6:Interpolation5/0.0f, 7:Interpolation6/1.0f
+      float palette[8]{ float(c0), float(c1) };
+      if (c0 > c1)
+      {
+         for (int32_t i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * palette[0] + i * palette[1]) / 7.f;
+      }
+      else
+      {
+         for (int32_t i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * palette[0] + i * palette[1]) / 5.f;
+         palette[6] = 0;
+         palette[7] = UINT8_MAX;
+      }
+      // 16 indices * 3 bits straddle the byte boundaries, so gather them in a 64-bit integer.
+      uint64_t indices = 0;
+      float error = 0;
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const float value = block[i] * UINT8_MAX;
+         uint32_t index = 0;
+         float minError = std::abs(palette[0] - value);
+         for (uint32_t j = 1; j < 8; j++)
+         {
+            float error = std::abs(palette[j] - value);
+            if (error >= minError) continue;
+            minError = error;
+            index = j;
+         }
+         indices |= uint64_t(index) << (3 * i);
+         error += minError * minError;
+      }
+      for (int32_t i = 0; i < 6; i++) destination[2 + i] = uint8_t(indices >> (8 * i)); // +2: Point it to the index block
+      return error;
+   }
+
+   const int32_t BatchLength = 8; // Blocks gathered at a time for the batch encoders.
+
+   // Gather a 4x4 block from the texels, into the channels which the format is encoded from.
+   void GatherBlock(const uint8_t* texels, GenericTexFmt format, int32_t rowPitch, XMFLOAT4A* blockRGB, float* blockR, float* blockG, float* blockA)
+   {
+      const int32_t pixelSize = PixelSize[int32_t(format)];
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const uint8_t* texel = texels + (i / BCBlockWidth) * rowPitch + (i % BCBlockWidth) * pixelSize;
+         switch (format)
+         {
+         case GenericTexFmt::UnsignedNormalized_R8G8B8A8:
+            ColorByte2Float(blockA[i], texel[3]);
+            [[fallthrough]];
+         case GenericTexFmt::UnsignedNormalized_R8G8B8:
+            ColorByte2Float(blockRGB[i].x, texel[0]);
+            ColorByte2Float(blockRGB[i].y, texel[1]);
+            ColorByte2Float(blockRGB[i].z, texel[2]);
+            blockRGB[i].w = 0;
+            break;
+         case GenericTexFmt::UnsignedNormalized_R8G8:
+            ColorByte2Float(blockG[i], texel[1]);
+            [[fallthrough]];
+         case GenericTexFmt::UnsignedNormalized_R8:
+            ColorByte2Float(blockR[i], texel[0]);
+            break;
+         default:
+            throw std::runtime_error("The batch encoders take the 8-bit formats only.");
+         }
+      }
+   }
+
+#if defined(PILLOW_DEBUG) && defined(_M_X64)
+   // The batch encoders are bit-identical to the single block encoders on x64, spot check it.
+   void VerifyBatch(const XMFLOAT4A* blockRGB, const float* blockR, const float* blockG, const float* blockA, const uint8_t* encoded, GenericTexFmt format, bool RGBDithering, EncodeQuality quality)
+   {
+      uint8_t expected[BC3BlockSize];
+      switch (format)
+      {
+      case GenericTexFmt::UnsignedNormalized_R8G8B8A8:
+         EncodeBC3RGBA(blockRGB, blockA, expected, RGBDithering, quality);
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8G8B8:
+         EncodeBC1RGB(blockRGB, expected, RGBDithering, quality);
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8G8:
+         EncodeBC5Normal(blockR, blockG, expected, quality);
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8:
+         EncodeBC4Alpha(blockR, expected, quality);
+         break;
+      default:
+         throw std::runtime_error("The batch encoders take the 8-bit formats only.");
+      }
+      if (memcmp(expected, encoded, BCBlockSize[int32_t(format)])) throw std::runtime_error("The batch encoder diverges from the single block encoder.");
+   }
+#endif
+
+   // Encode a block row in batches, every lane of the batch encoders handles a block.
+   void EncodeBlockRow(const MipTask& task, GenericTexFmt format, int32_t row, bool RGBDithering, EncodeQuality quality)
+   {
+      const int32_t pixelSize = PixelSize[int32_t(format)];
+      const int32_t blockSize = BCBlockSize[int32_t(format)];
+      const int32_t rowPitch = task.width * pixelSize;
+      const int32_t blocks = task.width / BCBlockWidth;
+      const uint8_t* texels = task.texels + int64_t(row) * BCBlockWidth * rowPitch;
+      uint8_t* destination = task.destination + row * blocks * blockSize;
+      XMFLOAT4A blocksRGB[BatchLength * BCBlockLength];
+      float blocksR[BatchLength * BCBlockLength];
+      float blocksG[BatchLength * BCBlockLength];
+      float blocksA[BatchLength * BCBlockLength];
+      for (int32_t first = 0; first < blocks; first += BatchLength)
+      {
+         const int32_t count = std::min(BatchLength, blocks - first);
+         for (int32_t i = 0; i < count; i++)
+         {
+            const int32_t offset = i * BCBlockLength;
+            GatherBlock(texels + (first + i) * BCBlockWidth * pixelSize, format, rowPitch, blocksRGB + offset, blocksR + offset, blocksG + offset, blocksA + offset);
+         }
+         uint8_t* batch = destination + first * blockSize;
+         switch (format)
+         {
+         case GenericTexFmt::UnsignedNormalized_R8G8B8A8:
+            EncodeBC4AlphaBatch(blocksA, batch, blockSize, count, quality);
+            EncodeBC1RGBBatch(blocksRGB, batch + BC4BlockSize, blockSize, count, RGBDithering, quality);
+            break;
+         case GenericTexFmt::UnsignedNormalized_R8G8B8:
+            EncodeBC1RGBBatch(blocksRGB, batch, blockSize, count, RGBDithering, quality);
+            break;
+         case GenericTexFmt::UnsignedNormalized_R8G8:
+            EncodeBC4AlphaBatch(blocksR, batch, blockSize, count, quality);
+            EncodeBC4AlphaBatch(blocksG, batch + BC4BlockSize, blockSize, count, quality);
+            break;
+         case GenericTexFmt::UnsignedNormalized_R8:
+            EncodeBC4AlphaBatch(blocksR, batch, blockSize, count, quality);
+            break;
+         default:
+            throw std::runtime_error("The batch encoders take the 8-bit formats only.");
+         }
+#if defined(PILLOW_DEBUG) && defined(_M_X64)
+         const int32_t last = (count - 1) * BCBlockLength;
+         VerifyBatch(blocksRGB + last, blocksR + last, blocksG + last, blocksA + last, batch + (count - 1) * blockSize, format, RGBDithering, quality);
+#endif
+      }
+   }
+
+   // Gather a block of blockWidth x blockWidth texels in row-major order, the texels over the edge repeat the edge.
+   // The channels missing from the format are 0, the alpha is 1.
+   void GatherPaddedBlock(const uint8_t* texels, GenericTexFmt format, int32_t width, int32_t blockX, int32_t blockY, int32_t blockWidth, XMFLOAT4A* block)
+   {
+      const int32_t pixelSize = PixelSize[int32_t(format)];
+      for (int32_t y = 0; y < blockWidth; y++)
+      {
+         const int32_t row = std::min(blockY * blockWidth + y, width - 1);
+         for (int32_t x = 0; x < blockWidth; x++)
+         {
+            const uint8_t* texel = texels + (int64_t(row) * width + std::min(blockX * blockWidth + x, width - 1)) * pixelSize;
+            float color[4]{ 0, 0, 0, 1 };
+            for (int32_t c = 0; c < pixelSize; c++) ColorByte2Float(color[c], texel[c]);
+            block[y * blockWidth + x] = XMFLOAT4A(color);
+         }
+      }
+   }
+
+   // Encode a block row of ETC2 / EAC or ASTC.
+   void EncodePaddedBlockRow(const MipTask& task, GenericTexFmt format, CompressionMode compMode, int32_t row)
+   {
+      const int32_t blockWidth = GetBlockWidth(compMode);
+      const int32_t blockSize = GetBlockSize(format, compMode);
+      const int32_t blocks = GetBlockCount(compMode, task.width);
+      // ASTC has no two channel end points, RG is stored as RGB.
+      const int32_t channels = format == GenericTexFmt::UnsignedNormalized_R8 ? 1 : (format == GenericTexFmt::UnsignedNormalized_R8G8B8A8 ? 4 : 3);
+      XMFLOAT4A block[ASTCMaxBlockLength];
+      float channel[BCBlockLength];
+      auto Channel = [&](int32_t c)
+         {
+            for (int32_t i = 0; i < BCBlockLength; i++) channel[i] = (&block[i].x)[c];
+            return channel;
+         };
+      for (int32_t x = 0; x < blocks; x++)
+      {
+         GatherPaddedBlock(task.texels, format, task.width, x, row, blockWidth, block);
+         uint8_t* destination = task.destination + (int64_t(row) * blocks + x) * blockSize;
+         if (compMode != CompressionMode::ETC2)
+         {
+            EncodeASTC(block, blockWidth, channels, destination);
+            continue;
+         }
+         switch (format)
+         {
+         case GenericTexFmt::UnsignedNormalized_R8G8B8A8:
+            EncodeEACAlpha(Channel(3), destination);
+            EncodeETC2RGB(block, destination + EACBlockSize);
+            break;
+         case GenericTexFmt::UnsignedNormalized_R8G8B8:
+            EncodeETC2RGB(block, destination);
+            break;
+         case GenericTexFmt::UnsignedNormalized_R8G8:
+            EncodeEACR11(Channel(0), destination);
+            EncodeEACR11(Channel(1), destination + EACBlockSize);
+            break;
+         case GenericTexFmt::UnsignedNormalized_R8:
+            EncodeEACR11(Channel(0), destination);
+            break;
+         default:
+            throw std::runtime_error("ETC2 takes the 8-bit formats only.");
+         }
+      }
+   }
+
+   // Decode a block of EncodePaddedBlockRow(), the channels missing from the format are 0, the alpha is 1.
+   void DecodePaddedBlock(const uint8_t* source, GenericTexFmt format, CompressionMode compMode, XMFLOAT4A* block)
+   {
+      if (compMode != CompressionMode::ETC2)
+      {
+         DecodeASTC(source, GetBlockWidth(compMode), block);
+         return;
+      }
+      float first[BCBlockLength], second[BCBlockLength];
+      switch (format)
+      {
+      case GenericTexFmt::UnsignedNormalized_R8G8B8A8:
+         DecodeETC2RGB(source + EACBlockSize, block);
+         DecodeEACAlpha(source, first);
+         for (int32_t i = 0; i < BCBlockLength; i++) block[i].w = first[i];
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8G8B8:
+         DecodeETC2RGB(source, block);
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8G8:
+         DecodeEACR11(source, first);
+         DecodeEACR11(source + EACBlockSize, second);
+         for (int32_t i = 0; i < BCBlockLength; i++) block[i] = XMFLOAT4A(first[i], second[i], 0, 1);
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8:
+         DecodeEACR11(source, first);
+         for (int32_t i = 0; i < BCBlockLength; i++) block[i] = XMFLOAT4A(first[i], 0, 0, 1);
+         break;
+      default:
+         throw std::runtime_error("ETC2 takes the 8-bit formats only.");
+      }
+   }
+
+   // The 4 colors of a BC1 block as R8G8B8A8 texels, computed a color per vector.
+   // C0 <= C1 selects the 3-color mode whose last color is transparent black, but the color blocks of BC3 always have 4 colors.
+   void DecodeBC1Palette(const uint8_t* block, bool bFourColors, uint32_t* palette)
+   {
+      uint16_t color0, color1;
+      memcpy(&color0, block, sizeof(color0));
+      memcpy(&color1, block + sizeof(color0), sizeof(color1));
+      const XMVECTOR c0 = XMVectorSetW(DecodeRGB565(color0), 1);
+      const XMVECTOR c1 = XMVectorSetW(DecodeRGB565(color1), 1);
+      XMVECTOR colors[4]{ c0, c1 };
+      if (bFourColors || color0 > color1)
+      {
+         colors[2] = XMVectorLerp(c0, c1, 1 / 3.f);
+         colors[3] = XMVectorLerp(c0, c1, 2 / 3.f);
+      }
+      else
+      {
+         colors[2] = XMVectorLerp(c0, c1, 0.5f);
+         colors[3] = XMVectorZero();
+      }
+      for (int32_t i = 0; i < 4; i++) ColorFloat2Byte(reinterpret_cast<uint8_t*>(palette + i), colors[i]);
+   }
+
+   // The 8 values of a BC4 block, computed 4 values per vector.
+   void DecodeBC4Palette(const uint8_t* block, uint8_t* palette)
+   {
+      static const XMVECTORF32 weights8[2]{ { 0, 1, 1 / 7.f, 2 / 7.f }, { 3 / 7.f, 4 / 7.f, 5 / 7.f, 6 / 7.f } };
+      static const XMVECTORF32 weights6[2]{ { 0, 1, 1 / 5.f, 2 / 5.f }, { 3 / 5.f, 4 / 5.f, 0, 0 } };
+      const bool bEightValues = block[0] > block[1];
+      const XMVECTORF32* weights = bEightValues ? weights8 : weights6;
+      float c0, c1;
+      ColorByte2Float(c0, block[0]);
+      ColorByte2Float(c1, block[1]);
+      const XMVECTOR base = XMVectorReplicate(c0), delta = XMVectorReplicate(c1 - c0);
+      XMVECTOR high = XMVectorMultiplyAdd(delta, weights[1], base);
+      // The 6-value mode ends with 0 and 1.
+      if (!bEightValues) high = XMVectorSelect(high, g_XMIdentityR3, XMVectorSelectControl(0, 0, 1, 1));
+      ColorFloat2Byte(palette, XMVectorMultiplyAdd(delta, weights[0], base));
+      ColorFloat2Byte(palette + 4, high);
+   }
+
+   ForceInline uint64_t LoadBC4Indices(const uint8_t* block)
+   {
+      uint64_t indices = 0;
+      memcpy(&indices, block + 2, 6);
+      return indices;
+   }
+
+   // Decode a BC block into 16 R8G8B8A8 texels in row-major order, the channels missing from the format are 0, the alpha is 1.
+   void DecodeBCBlock(const uint8_t* block, GenericTexFmt format, uint32_t* texels)
+   {
+      uint32_t colors[4];
+      uint8_t first[8], second[8];
+      uint32_t colorIndices;
+      uint64_t indices, secondIndices;
+      switch (format)
+      {
+      case GenericTexFmt::UnsignedNormalized_R8G8B8A8:
+         DecodeBC4Palette(block, first);
+         DecodeBC1Palette(block + BC4BlockSize, true, colors);
+         indices = LoadBC4Indices(block);
+         memcpy(&colorIndices, block + BC4BlockSize + 4, sizeof(colorIndices));
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            texels[i] = (colors[(colorIndices >> (2 * i)) & 3] & 0x00FFFFFF) | uint32_t(first[(indices >> (3 * i)) & 7]) << 24;
+         }
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8G8B8:
+         DecodeBC1Palette(block, false, colors);
+         memcpy(&colorIndices, block + 4, sizeof(colorIndices));
+         for (int32_t i = 0; i < BCBlockLength; i++) texels[i] = colors[(colorIndices >> (2 * i)) & 3];
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8G8:
+         DecodeBC4Palette(block, first);
+         DecodeBC4Palette(block + BC4BlockSize, second);
+         indices = LoadBC4Indices(block);
+         secondIndices = LoadBC4Indices(block + BC4BlockSize);
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            texels[i] = 0xFF000000 | uint32_t(second[(secondIndices >> (3 * i)) & 7]) << 8 | first[(indices >> (3 * i)) & 7];
+         }
+         break;
+      case GenericTexFmt::UnsignedNormalized_R8:
+         DecodeBC4Palette(block, first);
+         indices = LoadBC4Indices(block);
+         for (int32_t i = 0; i < BCBlockLength; i++) texels[i] = 0xFF000000 | first[(indices >> (3 * i)) & 7];
+         break;
+      default:
+         throw std::runtime_error("The BC decoder takes the 8-bit formats only.");
+      }
+   }
+
+   // Decode a block row of any CompressionMode into R8G8B8A8, the texels over the edge are dropped.
+   void DecodeBlockRow(const uint8_t* blocks, uint8_t* destination, GenericTexFmt format, CompressionMode compMode, int32_t width, int32_t row)
+   {
+      const int32_t blockWidth = GetBlockWidth(compMode);
+      const int32_t blockSize = GetBlockSize(format, compMode);
+      const int32_t blockCount = GetBlockCount(compMode, width);
+      const int32_t rows = std::min(blockWidth, width - row * blockWidth);
+      const bool bBC = compMode == CompressionMode::Hardware || compMode == CompressionMode::HardwareWithDithering;
+      uint32_t texels[ASTCMaxBlockLength];
+      XMFLOAT4A decoded[ASTCMaxBlockLength];
+      for (int32_t x = 0; x < blockCount; x++)
+      {
+         const uint8_t* block = blocks + (int64_t(row) * blockCount + x) * blockSize;
+         if (bBC)
+         {
+            DecodeBCBlock(block, format, texels);
+         }
+         else
+         {
+            DecodePaddedBlock(block, format, compMode, decoded);
+            for (int32_t i = 0; i < blockWidth * blockWidth; i++) ColorFloat2Byte(reinterpret_cast<uint8_t*>(texels + i), XMLoadFloat4A(&decoded[i]));
+         }
+         const int32_t columns = std::min(blockWidth, width - x * blockWidth);
+         for (int32_t y = 0; y < rows; y++)
+         {
+            uint8_t* texel = destination + ((int64_t(row) * blockWidth + y) * width + x * blockWidth) * 4;
+            memcpy(texel, texels + y * blockWidth, columns * sizeof(uint32_t));
+         }
+      }
+   }
+
+   // The squared error of a row of texels against their R8G8B8A8 decoding, over the channels of the format.
+   double GetRowSquaredError(const uint8_t* texels, const uint8_t* decoded, int32_t width, int32_t pixelSize)
+   {
+      double sum = 0;
+      for (int32_t x = 0; x < width; x++)
+      {
+         for (int32_t c = 0; c < pixelSize; c++)
+         {
+            const double difference = double(decoded[x * 4 + c]) - texels[x * pixelSize + c];
+            sum += difference * difference;
+         }
+      }
+      return sum;
+   }
+
+   // Encode a block row of a float format into BC6H_UF16, R11G11B10 is unpacked into floats losslessly.
+   void EncodeHDRBlockRow(const MipTask& task, GenericTexFmt format, int32_t row, EncodeQuality quality)
+   {
+      const int32_t pixelSize = PixelSize[int32_t(format)];
+      const int32_t blocks = task.width / BCBlockWidth;
+      XMFLOAT4A block[BCBlockLength];
+      for (int32_t x = 0; x < blocks; x++)
+      {
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            const uint8_t* texel = task.texels + (int64_t(row * BCBlockWidth + i / BCBlockWidth) * task.width + x * BCBlockWidth + i % BCBlockWidth) * pixelSize;
+            if (format == GenericTexFmt::Float_R16G16B16A16) XMStoreFloat4A(&block[i], PackedVector::XMLoadHalf4(reinterpret_cast<const PackedVector::XMHALF4*>(texel)));
+            else XMStoreFloat4A(&block[i], PackedVector::XMLoadFloat3PK(reinterpret_cast<const PackedVector::XMFLOAT3PK*>(texel)));
+         }
+         EncodeBC6HRGB(block, task.destination + (int64_t(row) * blocks + x) * BC6HBlockSize, quality);
+      }
+   }
+
+   // Encode a block row of R8G8B8A8 into BC7.
+   void EncodeBC7BlockRow(const MipTask& task, int32_t row, EncodeQuality quality)
+   {
+      const int32_t blocks = task.width / BCBlockWidth;
+      XMFLOAT4A block[BCBlockLength];
+      for (int32_t x = 0; x < blocks; x++)
+      {
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            const uint8_t* texel = task.texels + (int64_t(row * BCBlockWidth + i / BCBlockWidth) * task.width + x * BCBlockWidth + i % BCBlockWidth) * 4;
+            ColorByte2Float(block[i].x, texel[0]);
+            ColorByte2Float(block[i].y, texel[1]);
+            ColorByte2Float(block[i].z, texel[2]);
+            ColorByte2Float(block[i].w, texel[3]);
+         }
+         EncodeBC7RGBA(block, task.destination + (int64_t(row) * blocks + x) * BC7BlockSize, quality);
+      }
+   }
+
+   CompressionStats CompressTasks(const std::vector<MipTask>& tasks, GenericTexFmt format, CompressionMode compMode, EncodeQuality quality, int32_t threadCount)
+   {
+      const bool bBC = compMode == CompressionMode::Hardware || compMode == CompressionMode::HardwareWithDithering;
+      if (compMode == CompressionMode::BC7 && format != GenericTexFmt::UnsignedNormalized_R8G8B8A8) throw std::runtime_error("BC7 takes UnsignedNormalized_R8G8B8A8 only.");
+      if (IsFloatFormat(format) && !bBC) throw std::runtime_error("The float formats are compressed by the BC modes only.");
+      CompressionStats stats{};
+      int32_t rowCount = 0;
+      for (const MipTask& task : tasks)
+      {
+         int32_t blocks = GetBlockCount(compMode, task.width);
+         rowCount += blocks;
+         stats.BlockCount += blocks * blocks;
+      }
+      stats.ThreadCount = GetParallelForThreadCount(rowCount, threadCount);
+      auto start = steady_clock::now();
+      // Small mips own a few block rows, so rows of all the tasks are flattened into one job list.
+      ParallelFor(rowCount, threadCount, [&](int32_t row)
+         {
+            auto it = std::upper_bound(tasks.begin(), tasks.end(), row, [](int32_t value, const MipTask& task) { return value < task.firstRow; });
+            const MipTask& task = *(it - 1);
+            if (bBC && IsFloatFormat(format))
+            {
+               EncodeHDRBlockRow(task, format, row - task.firstRow, quality);
+            }
+            else if (bBC)
+            {
+               EncodeBlockRow(task, format, row - task.firstRow, compMode == CompressionMode::HardwareWithDithering, quality);
+            }
+            else if (compMode == CompressionMode::BC7)
+            {
+               EncodeBC7BlockRow(task, row - task.firstRow, quality);
+            }
+            else
+            {
+               EncodePaddedBlockRow(task, format, compMode, row - task.firstRow);
+            }
+         });
+      stats.Seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+      return stats;
+   }
+}
+
+void Pillow::Graphics::EncodeBC1RGB(const XMFLOAT4A* blockRGB, uint8_t* destination, bool RGBDithering, EncodeQuality quality)
+{
+   // Quantize block to R56B5, using Floyd Stienberg error diffusion. This
+   // increases the chance that colors will map directly to the quantized
+   // axis endpoints.
+   XMVECTOR colors[BCBlockLength];
+   XMVECTOR errors[BCBlockLength];
+   if (RGBDithering) for (int32_t i = 0; i < BCBlockLength; i++) errors[i] = XMVectorZero();
+   for (int32_t i = 0; i < BCBlockLength; i++)
+   {
+      XMVECTOR c = XMLoadFloat4A(&blockRGB[i]);
+      if (RGBDithering) c = XMVectorAdd(c, errors[i]);
+      const XMVECTOR v2 = XMVectorSet(31.f, 63.f, 31.f, 0);
+      const XMVECTOR v3 = XMVectorReplicate(0.5f);
+      const XMVECTOR factor = XMVectorSet(1 / 31.f, 1 / 63.f, 1 / 31.f, 0);
+      c = XMVectorSaturate(c);
+      colors[i] = XMVectorMultiply(XMVectorFloor(XMVectorMultiplyAdd(c, v2, v3)), factor);
+      // The error is diffused before the perceptual weighting, the same space as the input.
+      XMVECTOR diff = XMVectorSubtract(c, colors[i]);
+      colors[i] = XMVectorMultiply(colors[i], RGBLuminance);
+      if (!RGBDithering) continue;
+      if (3 != (i & 3))
+      {
+         const XMVECTOR factor = XMVectorReplicate(7.f / 16.f);
+         errors[i + 1] = XMVectorMultiplyAdd(diff, factor, errors[i + 1]);
+      }
+      if (i < 12)
+      {
+         const XMVECTOR factor = XMVectorReplicate(5.f / 16.f);
+         errors[i + 4] = XMVectorMultiplyAdd(diff, factor, errors[i + 4]);
+         if (i & 3)
+         {
+            const XMVECTOR factor = XMVectorReplicate(3.f / 16.f);
+            errors[i + 3] = XMVectorMultiplyAdd(diff, factor, errors[i + 3]);
+         }
+         if (3 != (i & 3))
+         {
+            const XMVECTOR factor = XMVectorReplicate(1 / 16.f);
+            errors[i + 5] = XMVectorMultiplyAdd(diff, factor, errors[i + 5]);
+         }
+      }
+   }
+   // Perform 6D root finding function to find two endpoints of color axis.
+   // Then quantize and sort the endpoints depending on mode.
+   const int32_t iterations = GetBCRefinementIterations(quality);
+   XMVECTOR ColorA, ColorB;
+   if (quality != EncodeQuality::Slow)
+   {
+      OptimizeRGB(ColorA, ColorB, colors, iterations, -1);
+      EncodeBC1EndPoints(blockRGB, ColorA, ColorB, destination, RGBDithering);
+      return;
+   }
+   // Refine every orientation of the diagonal instead of the estimated one, then refit the end points of the best block
+   // to its indices. The block with the least error is kept.
+   float minError = FLT_MAX;
+   uint8_t candidate[BC1BlockSize];
+   for (int32_t direction = 0; direction < 4; direction++)
+   {
+      OptimizeRGB(ColorA, ColorB, colors, iterations, direction);
+      const float error = EncodeBC1EndPoints(blockRGB, ColorA, ColorB, candidate, RGBDithering);
+      if (error >= minError) continue;
+      minError = error;
+      memcpy(destination, candidate, BC1BlockSize);
+   }
+   if (!SolveBC1EndPoints(blockRGB, destination, ColorA, ColorB)) return;
+   if (EncodeBC1EndPoints(blockRGB, ColorA, ColorB, candidate, RGBDithering) < minError) memcpy(destination, candidate, BC1BlockSize);
+}
+
+void Pillow::Graphics::EncodeBC3RGBA(const XMFLOAT4A* blockRGB, const float* blockA, uint8_t* destination, bool RGBDithering, EncodeQuality quality)
+{
+   EncodeBC4Alpha(blockA, destination, quality);
+   EncodeBC1RGB(blockRGB, destination + BC4BlockSize, RGBDithering, quality);
+}
+
+void Pillow::Graphics::EncodeBC4Alpha(const float* block, uint8_t* destination, EncodeQuality quality)
+{
+   const int32_t iterations = GetBCRefinementIterations(quality);
+   // Step 1: Find end points.
+   if (quality == EncodeQuality::Slow)
+   {
+      // Both codecs, with the quantized end points and their neighbors, the block with the least error is kept.
+      float minError = FLT_MAX;
+      uint8_t candidate[BC4BlockSize];
+      for (uint32_t steps : { 8u, 6u })
+      {
+         float min, max;
+         OptimizeAlpha(min, max, block, steps, iterations);
+         uint8_t low, high;
+         ColorFloat2Byte(low, min);
+         ColorFloat2Byte(high, max);
+         for (int32_t i = 0; i < 9; i++)
+         {
+            const uint8_t c0 = uint8_t(std::clamp(low + i / 3 - 1, 0, int32_t(UINT8_MAX)));
+            const uint8_t c1 = uint8_t(std::clamp(high + i % 3 - 1, 0, int32_t(UINT8_MAX)));
+            // The 6-interpolation codec stores min first, the other stores max first.
+            const float error = steps == 6 ? EncodeBC4EndPoints(block, c0, c1, candidate) : EncodeBC4EndPoints(block, c1, c0, candidate);
+            if (error >= minError) continue;
+            minError = error;
+            memcpy(destination, candidate, BC4BlockSize);
+         }
+      }
+      return;
+   }
+   bool bUsing4BlockCodec = false;
+   for (size_t i = 0; i < BCBlockLength; ++i)
+   {
+      //  If there are boundary values in input texels, should use 4 interpolated color values to guarantee
+      //  the exact code of the boundary values.
+      if (block[i] == 0 || block[i] == 1)
+      {
+         bUsing4BlockCodec = true;
+         break;
+      }
+   }
+   float min, max;
+   OptimizeAlpha(min, max, block, bUsing4BlockCodec ? 6 : 8, iterations);
+   uint8_t c0, c1;
+   ColorFloat2Byte(c0, bUsing4BlockCodec ? min : max);
+   ColorFloat2Byte(c1, bUsing4BlockCodec ? max : min);
+   // The palette is built from the quantized end points, which decide the real mode of the block.
+   EncodeBC4EndPoints(block, c0, c1, destination);
+}
+
+void Pillow::Graphics::EncodeBC5Normal(const float* blockRed, const float* blockGreen, uint8_t* destination, EncodeQuality quality)
+{
+   EncodeBC4Alpha(blockRed, destination, quality);
+   EncodeBC4Alpha(blockGreen, destination + BC4BlockSize, quality);
+}
+
+void Pillow::Graphics::DecodeBC4Alpha(const uint8_t* block, float* destination)
+{
+   const float c0 = block[0], c1 = block[1];
+   float palette[8]{ c0, c1 };
+   if (c0 > c1)
+   {
+      for (int32_t i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * c0 + i * c1) / 7.f;
+   }
+   else
+   {
+      for (int32_t i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * c0 + i * c1) / 5.f;
+      palette[6] = 0;
+      palette[7] = UINT8_MAX;
+   }
+   uint64_t indices = 0;
+   for (int32_t i = 0; i < 6; i++) indices |= uint64_t(block[2 + i]) << (8 * i);
+   for (int32_t i = 0; i < BCBlockLength; i++) destination[i] = palette[(indices >> (3 * i)) & 7] / UINT8_MAX;
+}
+
+void Pillow::Graphics::DecodeBC5Normal(const uint8_t* block, float* destinationRed, float* destinationGreen)
+{
+   DecodeBC4Alpha(block, destinationRed);
+   DecodeBC4Alpha(block + BC4BlockSize, destinationGreen);
+}
+
+int32_t Pillow::Graphics::GetCompressedArraySliceSize(const GenericTextureInfo& info)
+{
+   int32_t size = 0;
+   for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+   {
+      size += GetCompressedMipSize(info.GetFormat(), info.GetCompressionMode(), info.GetMipWidth(mip));
+   }
+   return size;
+}
+
+CompressionStats Pillow::Graphics::CompressMip(const uint8_t* texels, uint8_t* destination, GenericTexFmt format, int32_t width, bool RGBDithering, EncodeQuality quality, int32_t threadCount)
+{
+   if (width < BCBlockWidth || width % BCBlockWidth) throw std::runtime_error("Block compression needs a width of multiple of 4.");
+   std::vector<MipTask> tasks{ MipTask{ texels, destination, width, 0 } };
+   return CompressTasks(tasks, format, RGBDithering ? CompressionMode::HardwareWithDithering : CompressionMode::Hardware, quality, threadCount);
+}
+
+CompressionStats Pillow::Graphics::CompressMip(const uint8_t* texels, uint8_t* destination, GenericTexFmt format, CompressionMode compMode, int32_t width, EncodeQuality quality, int32_t threadCount)
+{
+   if (compMode == CompressionMode::None || compMode >= CompressionMode::Count) throw std::runtime_error("The compression mode doesn't use block compression.");
+   if (compMode == CompressionMode::Hardware || compMode == CompressionMode::HardwareWithDithering)
+   {
+      return CompressMip(texels, destination, format, width, compMode == CompressionMode::HardwareWithDithering, quality, threadCount);
+   }
+   std::vector<MipTask> tasks{ MipTask{ texels, destination, width, 0 } };
+   return CompressTasks(tasks, format, compMode, quality, threadCount);
+}
+
+CompressionStats Pillow::Graphics::CompressTexture(const uint8_t* texels, uint8_t* destination, const GenericTextureInfo& info, EncodeQuality quality, int32_t threadCount)
+{
+   if (info.GetCompressionMode() == CompressionMode::None) throw std::runtime_error("The texture doesn't use block compression.");
+   std::vector<MipTask> tasks;
+   tasks.reserve(info.GetArrayCount() * info.GetMipCount());
+   int32_t firstRow = 0;
+   for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+   {
+      for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+      {
+         int32_t width = info.GetMipWidth(mip);
+         tasks.push_back(MipTask{ texels, destination, width, firstRow });
+         texels += int64_t(width) * width * info.GetPixelSize();
+         destination += GetCompressedMipSize(info.GetFormat(), info.GetCompressionMode(), width);
+         firstRow += GetBlockCount(info.GetCompressionMode(), width);
+      }
+   }
+   return CompressTasks(tasks, info.GetFormat(), info.GetCompressionMode(), quality, threadCount);
+}
+
+NormalMapError Pillow::Graphics::MeasureNormalMapError(const GenericTexture& normalMap, int32_t threadCount)
+{
+   const GenericTextureInfo& info = normalMap.Info;
+   if (info.GetFormat() != GenericTexFmt::UnsignedNormalized_R8G8) throw std::runtime_error("The normal map isn't UnsignedNormalized_R8G8.");
+   // Encode a copy with compression, whatever the mode of the normal map is.
+   const GenericTextureInfo compressedInfo(info.GetFormat(), info.GetWidth(), info.GetMipCount() > 1, CompressionMode::Hardware, info.GetIsCubemap(),
+      info.GetArrayCount() / (info.GetIsCubemap() ? 6 : 1));
+   auto blocks = CreateAlignedMemory(int64_t(info.GetArrayCount()) * GetCompressedArraySliceSize(compressedInfo));
+   CompressTexture(reinterpret_cast<const uint8_t*>(normalMap.Data.get()), reinterpret_cast<uint8_t*>(blocks.get()), compressedInfo, EncodeQuality::Normal, threadCount);
+   std::vector<double> mipSums(info.GetMipCount()), mipMaxima(info.GetMipCount());
+   const uint8_t* block = reinterpret_cast<const uint8_t*>(blocks.get());
+   for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+   {
+      for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+      {
+         const int32_t width = info.GetMipWidth(mip);
+         const uint8_t* texels = normalMap.GetSubresource(slice, mip);
+         for (int32_t blockY = 0; blockY < width; blockY += BCBlockWidth)
+         {
+            for (int32_t blockX = 0; blockX < width; blockX += BCBlockWidth, block += BC5BlockSize)
+            {
+               float decodedX[BCBlockLength], decodedY[BCBlockLength];
+               DecodeBC5Normal(block, decodedX, decodedY);
+               for (int32_t i = 0; i < BCBlockLength; i++)
+               {
+                  const uint8_t* texel = texels + ((blockY + i / BCBlockWidth) * width + blockX + i % BCBlockWidth) * 2;
+                  float x, y;
+                  ColorByte2Float(x, texel[0]);
+                  ColorByte2Float(y, texel[1]);
+                  const XMVECTOR original = XMVector3Normalize(ReconstructNormal(x, y));
+                  const XMVECTOR decoded = XMVector3Normalize(ReconstructNormal(decodedX[i], decodedY[i]));
+                  const double degrees = XMConvertToDegrees(XMVectorGetX(XMVector3AngleBetweenNormals(original, decoded)));
+                  mipSums[mip] += degrees;
+                  mipMaxima[mip] = std::max(mipMaxima[mip], degrees);
+               }
+            }
+         }
+      }
+   }
+   NormalMapError error{};
+   double sum = 0;
+   int64_t texelCount = 0;
+   LogSystem("Width  MeanError(deg)  MaxError(deg)");
+   for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+   {
+      const int64_t count = int64_t(info.GetMipWidth(mip)) * info.GetMipWidth(mip) * info.GetArrayCount();
+      char line[128];
+      std::snprintf(line, sizeof(line), "%5d  %14.3f  %13.3f", info.GetMipWidth(mip), mipSums[mip] / count, mipMaxima[mip]);
+      LogSystem(line);
+      sum += mipSums[mip];
+      texelCount += count;
+      error.MaxDegrees = std::max(error.MaxDegrees, mipMaxima[mip]);
+   }
+   error.MeanDegrees = sum / texelCount;
+   return error;
+}
+
+CompressionStats Pillow::Graphics::DecompressMip(const uint8_t* blocks, uint8_t* destination, GenericTexFmt format, CompressionMode compMode, int32_t width, int32_t threadCount)
+{
+   if (compMode == CompressionMode::None || compMode >= CompressionMode::Count) throw std::runtime_error("The compression mode doesn't use block compression.");
+   if (IsFloatFormat(format)) throw std::runtime_error("The float formats can't be decoded into R8G8B8A8.");
+   if (compMode == CompressionMode::BC7) throw std::runtime_error("BC7 blocks can't be decoded.");
+   CompressionStats stats{};
+   const int32_t rowCount = GetBlockCount(compMode, width);
+   stats.BlockCount = int64_t(rowCount) * rowCount;
+   stats.ThreadCount = GetParallelForThreadCount(rowCount, threadCount);
+   auto start = steady_clock::now();
+   ParallelFor(rowCount, threadCount, [&](int32_t row) { DecodeBlockRow(blocks, destination, format, compMode, width, row); });
+   stats.Seconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+   return stats;
+}
+
+CompressionQuality Pillow::Graphics::MeasureCompressionQuality(const GenericTexture& texture, EncodeQuality quality, int32_t threadCount)
+{
+   const GenericTextureInfo& info = texture.Info;
+   const CompressionMode compMode = info.GetCompressionMode();
+   if (compMode == CompressionMode::None) throw std::runtime_error("The texture doesn't use block compression.");
+   if (IsFloatFormat(info.GetFormat())) throw std::runtime_error("The float formats aren't measured in 8-bit units.");
+   auto blocks = CreateAlignedMemory(int64_t(info.GetArrayCount()) * GetCompressedArraySliceSize(info));
+   CompressTexture(reinterpret_cast<const uint8_t*>(texture.Data.get()), reinterpret_cast<uint8_t*>(blocks.get()), info, quality, threadCount);
+   const int32_t pixelSize = info.GetPixelSize();
+   auto decoded = CreateAlignedMemory(int64_t(info.GetWidth()) * info.GetWidth() * 4);
+   uint8_t* decodedTexels = reinterpret_cast<uint8_t*>(decoded.get());
+   // SSIM of 8x8 windows, 4 texels apart, averaged over the channels of the format.
+   const int32_t windowWidth = 8, windowStride = 4;
+   const double c1 = (0.01 * UINT8_MAX) * (0.01 * UINT8_MAX), c2 = (0.03 * UINT8_MAX) * (0.03 * UINT8_MAX);
+   std::vector<double> mipErrors(info.GetMipCount()), mipSSIMs(info.GetMipCount());
+   std::vector<int64_t> mipWindows(info.GetMipCount());
+   const uint8_t* block = reinterpret_cast<const uint8_t*>(blocks.get());
+   for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+   {
+      for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+      {
+         const int32_t width = info.GetMipWidth(mip);
+         const uint8_t* texels = texture.GetSubresource(slice, mip);
+         DecompressMip(block, decodedTexels, info.GetFormat(), compMode, width, threadCount);
+         block += GetCompressedMipSize(info.GetFormat(), compMode, width);
+         const int32_t window = std::min(windowWidth, width);
+         const int32_t windowRows = (width - window) / windowStride + 1;
+         std::vector<double> rowErrors(width), rowSSIMs(windowRows);
+         ParallelFor(width, threadCount, [&](int32_t y)
+            {
+               rowErrors[y] = GetRowSquaredError(texels + int64_t(y) * width * pixelSize, decodedTexels + int64_t(y) * width * 4, width, pixelSize);
+            });
+         ParallelFor(windowRows, threadCount, [&](int32_t row)
+            {
+               double sum = 0;
+               for (int32_t left = 0; left + window <= width; left += windowStride)
+               {
+                  for (int32_t c = 0; c < pixelSize; c++)
+                  {
+                     double sumX = 0, sumY = 0, sumXX = 0, sumYY = 0, sumXY = 0;
+                     for (int32_t y = row * windowStride; y < row * windowStride + window; y++)
+                     {
+                        for (int32_t x = left; x < left + window; x++)
+                        {
+                           const double original = texels[(int64_t(y) * width + x) * pixelSize + c];
+                           const double result = decodedTexels[(int64_t(y) * width + x) * 4 + c];
+                           sumX += original;
+                           sumY += result;
+                           sumXX += original * original;
+                           sumYY += result * result;
+                           sumXY += original * result;
+                        }
+                     }
+                     const double n = double(window) * window;
+                     const double meanX = sumX / n, meanY = sumY / n;
+                     const double varianceX = sumXX / n - meanX * meanX, varianceY = sumYY / n - meanY * meanY;
+                     const double covariance = sumXY / n - meanX * meanY;
+                     sum += (2 * meanX * meanY + c1) * (2 * covariance + c2) / ((meanX * meanX + meanY * meanY + c1) * (varianceX + varianceY + c2));
+                  }
+               }
+               rowSSIMs[row] = sum / pixelSize;
+            });
+         for (double error : rowErrors) mipErrors[mip] += error;
+         for (double ssim : rowSSIMs) mipSSIMs[mip] += ssim;
+         mipWindows[mip] += int64_t(windowRows) * windowRows;
+      }
+   }
+   auto PSNR = [](double sum, int64_t count)
+      {
+         return sum > 0 ? 10 * std::log10(double(UINT8_MAX) * UINT8_MAX * count / sum) : std::numeric_limits<double>::infinity();
+      };
+   CompressionQuality result{};
+   double errorSum = 0, ssimSum = 0;
+   int64_t valueCount = 0, windowCount = 0;
+   LogSystem("Width  PSNR(dB)    SSIM");
+   for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+   {
+      const int64_t count = int64_t(info.GetMipWidth(mip)) * info.GetMipWidth(mip) * info.GetArrayCount() * pixelSize;
+      char line[128];
+      std::snprintf(line, sizeof(line), "%5d  %8.2f  %6.4f", info.GetMipWidth(mip), PSNR(mipErrors[mip], count), mipSSIMs[mip] / mipWindows[mip]);
+      LogSystem(line);
+      errorSum += mipErrors[mip];
+      valueCount += count;
+      ssimSum += mipSSIMs[mip];
+      windowCount += mipWindows[mip];
+   }
+   result.PSNR = PSNR(errorSum, valueCount);
+   result.SSIM = ssimSum / windowCount;
+   return result;
+}
+
+void Pillow::Graphics::BenchmarkEncodeQuality(const std::vector<string>& relativePaths, int32_t threadCount)
+{
+   static const char* qualityNames[]{ "Fast", "Normal", "Slow" };
+   const int32_t qualityCount = 3;
+   struct Total
+   {
+      int64_t BlockCount;
+      double Seconds;
+      double Error;
+      int64_t ValueCount;
+   };
+   Total totals[qualityCount]{};
+   auto Log = [](const string& name, int32_t quality, const Total& total)
+      {
+         const double rmse = std::sqrt(total.Error / total.ValueCount);
+         char line[256];
+         std::snprintf(line, sizeof(line), "%-24s  %-7s  %9.3f  %7.3f  %8.2f", name.c_str(), qualityNames[quality],
+            total.BlockCount / total.Seconds / 1e6, rmse, 20 * std::log10(UINT8_MAX / rmse));
+         LogSystem(line);
+      };
+   LogSystem("Texture                   Quality  MBlocks/s     RMSE  PSNR(dB)");
+   for (const string& relativePath : relativePaths)
+   {
+      const std::vector<uint8_t> file = ReadBinaryFile(GetResourcePath(relativePath));
+      // Without the dithering, the error is the encoders' alone.
+      auto texture = DecodeTexture(file.data(), file.size(), false, CompressionMode::Hardware);
+      const GenericTextureInfo& info = texture->Info;
+      auto blocks = CreateAlignedMemory(int64_t(info.GetArrayCount()) * GetCompressedArraySliceSize(info));
+      auto decoded = CreateAlignedMemory(int64_t(info.GetWidth()) * info.GetWidth() * 4);
+      uint8_t* decodedTexels = reinterpret_cast<uint8_t*>(decoded.get());
+      for (int32_t quality = 0; quality < qualityCount; quality++)
+      {
+         const CompressionStats stats = CompressTexture(reinterpret_cast<const uint8_t*>(texture->Data.get()), reinterpret_cast<uint8_t*>(blocks.get()), info,
+            EncodeQuality(quality), threadCount);
+         Total total{ stats.BlockCount, stats.Seconds, 0, 0 };
+         const uint8_t* block = reinterpret_cast<const uint8_t*>(blocks.get());
+         for (int32_t slice = 0; slice < info.GetArrayCount(); slice++)
+         {
+            for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+            {
+               const int32_t width = info.GetMipWidth(mip);
+               const uint8_t* texels = texture->GetSubresource(slice, mip);
+               DecompressMip(block, decodedTexels, info.GetFormat(), info.GetCompressionMode(), width, threadCount);
+               block += GetCompressedMipSize(info.GetFormat(), info.GetCompressionMode(), width);
+               for (int32_t y = 0; y < width; y++)
+               {
+                  total.Error += GetRowSquaredError(texels + int64_t(y) * width * info.GetPixelSize(), decodedTexels + int64_t(y) * width * 4, width, info.GetPixelSize());
+               }
+               total.ValueCount += int64_t(width) * width * info.GetPixelSize();
+            }
+         }
+         Log(relativePath, quality, total);
+         totals[quality].BlockCount += total.BlockCount;
+         totals[quality].Seconds += total.Seconds;
+         totals[quality].Error += total.Error;
+         totals[quality].ValueCount += total.ValueCount;
+      }
+   }
+   for (int32_t quality = 0; quality < qualityCount; quality++) Log("All", quality, totals[quality]);
+}
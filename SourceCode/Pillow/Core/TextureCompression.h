@@ -0,0 +1,193 @@
+#pragma once
+#include "Auxiliaries.h"
+#include "Texture.h"
+#include "DirectXMath-apr2025/DirectXMath.h"
+
+namespace Pillow::Graphics
+{
+   using namespace DirectX;
+
+   // Perceptual weightings for the importance of each channel.
+   const XMVECTOR RGBLuminance = XMVectorSet(0.2125f / 0.7154f, 1, 0.0721f / 0.7154f, 1);
+   const XMVECTOR RGBLuminanceInv = XMVectorSet(0.7154f / 0.2125f, 1, 0.7154f / 0.0721f, 1);
+
+   const int32_t BCBlockWidth = 4;
+   const int32_t BCBlockLength = 16; // 4 rows, 4 columns
+   const int32_t BC1BlockSize = 8; // C0(2B) C1(2B) Indices(16*2bits = 4B)
+   const int32_t BC4BlockSize = 8; // C0(1B) C1(1B) Indices(16*3bits = 6B)
+   const int32_t BC3BlockSize = BC1BlockSize + BC4BlockSize;
+   const int32_t BC5BlockSize = BC4BlockSize * 2;
+   const int32_t BC6HBlockSize = 16;
+   const int32_t BC7BlockSize = 16;
+
+   // The block size of the BC format which a generic format is compressed into.
+   const int32_t BCBlockSize[int32_t(GenericTexFmt::Count)]
+   {
+      BC3BlockSize, // UnsignedNormalized_R8G8B8A8
+      BC1BlockSize, // UnsignedNormalized_R8G8B8
+      BC5BlockSize, // UnsignedNormalized_R8G8
+      BC4BlockSize, // UnsignedNormalized_R8
+      BC6HBlockSize, // Float_R16G16B16A16
+      BC6HBlockSize, // Float_R11G11B10
+   };
+
+   const int32_t EACBlockSize = 8; // Base(1B) Multiplier and table(1B) Indices(16*3bits = 6B)
+   const int32_t ETC2RGBBlockSize = 8; // Base colors and tables(4B) Indices(16*2bits = 4B)
+   const int32_t ASTCBlockSize = 16; // For every footprint
+   const int32_t ASTCMaxBlockLength = 36; // 6 rows, 6 columns
+
+   // The block size of the ETC2 / EAC format which a generic format is compressed into.
+   // The GL formats: RGBA8_ETC2_EAC, RGB8_ETC2, RG11_EAC and R11_EAC, their color formats have SRGB8 variants.
+   const int32_t ETC2BlockSize[int32_t(GenericTexFmt::Count)]
+   {
+      EACBlockSize + ETC2RGBBlockSize, // UnsignedNormalized_R8G8B8A8
+      ETC2RGBBlockSize, // UnsignedNormalized_R8G8B8
+      EACBlockSize * 2, // UnsignedNormalized_R8G8
+      EACBlockSize, // UnsignedNormalized_R8
+      0, // Float_R16G16B16A16, ETC2 and ASTC LDR have no HDR formats.
+      0, // Float_R11G11B10
+   };
+
+   // The texels on a side of a block, ASTC6x6 is the only footprint that isn't 4.
+   ForceInline int32_t GetBlockWidth(CompressionMode compMode)
+   {
+      return compMode == CompressionMode::ASTC6x6 ? 6 : BCBlockWidth;
+   }
+
+   // The blocks on a side of a mip level, the blocks over the edge are padded with the edge texels.
+   ForceInline int32_t GetBlockCount(CompressionMode compMode, int32_t width)
+   {
+      const int32_t blockWidth = GetBlockWidth(compMode);
+      return std::max((width + blockWidth - 1) / blockWidth, 1);
+   }
+
+   ForceInline int32_t GetBlockSize(GenericTexFmt format, CompressionMode compMode)
+   {
+      switch (compMode)
+      {
+      case CompressionMode::ETC2:
+         return ETC2BlockSize[int32_t(format)];
+      case CompressionMode::ASTC4x4:
+      case CompressionMode::ASTC6x6:
+         return ASTCBlockSize;
+      case CompressionMode::BC7:
+         return BC7BlockSize;
+      default:
+         return BCBlockSize[int32_t(format)];
+      }
+   }
+
+   // The Newton iterations refining the end points of BC1 to BC5.
+   ForceInline int32_t GetBCRefinementIterations(EncodeQuality quality)
+   {
+      return quality == EncodeQuality::Fast ? 0 : (quality == EncodeQuality::Normal ? 8 : 16);
+   }
+
+   struct CompressionStats
+   {
+      int64_t BlockCount{};
+      double Seconds{};
+      int32_t ThreadCount{};
+
+      ForceInline double GetBlocksPerSecond() const { return Seconds > 0 ? double(BlockCount) / Seconds : 0; }
+   };
+
+   // Single block encoders. A block is 4x4 texels in row-major order, and the color values range in [0, 1].
+   void EncodeBC1RGB(const XMFLOAT4A* blockRGB, uint8_t* destination, bool RGBDithering, EncodeQuality quality);
+   void EncodeBC3RGBA(const XMFLOAT4A* blockRGB, const float* blockA, uint8_t* destination, bool RGBDithering, EncodeQuality quality);
+   void EncodeBC4Alpha(const float* block, uint8_t* destination, EncodeQuality quality);
+   void EncodeBC5Normal(const float* blockRed, const float* blockGreen, uint8_t* destination, EncodeQuality quality);
+
+   // BC7 of 8-bit RGBA in [0, 1], searching modes 1 to 7 as the quality allows. Mode 0 is searched by the slow quality only.
+   void EncodeBC7RGBA(const XMFLOAT4A* blockRGBA, uint8_t* destination, EncodeQuality quality);
+   // BC6H_UF16 of linear HDR colors in [0, 65504], the range of half floats. The negative values are clamped to 0.
+   // Only the single subset modes 11 to 14 are used, so the blocks of distinct hues are less precise than the best encoders'.
+   void EncodeBC6HRGB(const XMFLOAT4A* blockRGB, uint8_t* destination, EncodeQuality quality);
+
+   // ETC2 of 8-bit RGB, in the individual, differential or planar mode, whichever fits best. The T and H modes aren't used.
+   void EncodeETC2RGB(const XMFLOAT4A* blockRGB, uint8_t* destination);
+   // EAC of the alpha of RGBA8_ETC2_EAC, with 8-bit precision.
+   void EncodeEACAlpha(const float* block, uint8_t* destination);
+   // EAC of R11_EAC, and twice for RG11_EAC.
+   void EncodeEACR11(const float* block, uint8_t* destination);
+
+   // ASTC LDR of a blockWidth x blockWidth block in row-major order, blockWidth being 4 or 6.
+   // The blocks have a single partition, a single plane of weights covering every texel, and direct end points:
+   // luminance(channels = 1), RGB(channels = 3) or RGBA(channels = 4). The weight precision is searched,
+   // and the end points get the bits left. Solid blocks are encoded as void extent blocks.
+   void EncodeASTC(const XMFLOAT4A* block, int32_t blockWidth, int32_t channels, uint8_t* destination);
+
+   // Single block decoders, the color values range in [0, 1].
+   void DecodeBC4Alpha(const uint8_t* block, float* destination);
+   void DecodeBC5Normal(const uint8_t* block, float* destinationRed, float* destinationGreen);
+   // All the five ETC2 RGB modes, the alpha of destination is 1.
+   void DecodeETC2RGB(const uint8_t* block, XMFLOAT4A* destination);
+   void DecodeEACAlpha(const uint8_t* block, float* destination);
+   void DecodeEACR11(const uint8_t* block, float* destination);
+   // Only the blocks EncodeASTC() writes, other blocks throw.
+   void DecodeASTC(const uint8_t* block, int32_t blockWidth, XMFLOAT4A* destination);
+
+   // Batch encoders, every SIMD lane encodes a different block: 8 lanes with AVX2, otherwise 4(SSE2 / NEON).
+   // The blocks are consecutive, and the encoded blocks are written destinationStride bytes apart.
+   // On x64 the output is bit-identical to the single block encoders. On arm64 the compiler may fuse the
+   // multiply-adds of the single block encoders, so the end points could differ by the rounding of a few ulps.
+   // The slow quality searches per block, so its blocks are encoded one by one by the single block encoders.
+   int32_t GetBCBatchWidth();
+   void EncodeBC1RGBBatch(const XMFLOAT4A* blocksRGB, uint8_t* destination, int32_t destinationStride, int32_t blockCount, bool RGBDithering, EncodeQuality quality);
+   void EncodeBC4AlphaBatch(const float* blocks, uint8_t* destination, int32_t destinationStride, int32_t blockCount, EncodeQuality quality);
+
+   ForceInline int32_t GetCompressedMipSize(GenericTexFmt format, CompressionMode compMode, int32_t width)
+   {
+      int32_t blocks = GetBlockCount(compMode, width);
+      return blocks * blocks * GetBlockSize(format, compMode);
+   }
+
+   int32_t GetCompressedArraySliceSize(const GenericTextureInfo& info);
+
+   // Compress a mip level of (width x width) texels.
+   // The block rows are distributed over threadCount workers(0 = all hardware threads).
+   CompressionStats CompressMip(const uint8_t* texels, uint8_t* destination, GenericTexFmt format, int32_t width, bool RGBDithering,
+      EncodeQuality quality = EncodeQuality::Normal, int32_t threadCount = 0);
+
+   // CompressMip() into the block format of any CompressionMode. ETC2 picks the format as ETC2BlockSize lists,
+   // ASTC stores RGBA, RGB, RG with a blue of 0, or R as the luminance. The blocks over the edge repeat the edge texels.
+   // The quality only applies to the BC modes and BC7, the ETC2 and ASTC encoders have a single effort.
+   // The float formats are compressed into BC6H_UF16 by the BC modes, and throw with the others. BC7 takes UnsignedNormalized_R8G8B8A8 only.
+   CompressionStats CompressMip(const uint8_t* texels, uint8_t* destination, GenericTexFmt format, CompressionMode compMode, int32_t width,
+      EncodeQuality quality = EncodeQuality::Normal, int32_t threadCount = 0);
+
+   struct NormalMapError
+   {
+      double MeanDegrees{};
+      double MaxDegrees{};
+   };
+
+   // Compress an UnsignedNormalized_R8G8 normal map to BC5, decode it, and measure the angles between the normals
+   // reconstructed before and after. Logs the error of every mip level, and returns the error of all the texels.
+   NormalMapError MeasureNormalMapError(const GenericTexture& normalMap, int32_t threadCount = 0);
+
+   // Decode a mip level of (width x width) texels compressed with any CompressionMode into R8G8B8A8, the way GPUs sample it:
+   // the channels missing from the format are 0, and the alpha is 1 except for the transparent texels of BC1. The float formats throw.
+   // The palettes of the BC blocks are computed a color per vector, and the block rows are distributed over threadCount workers(0 = all hardware threads).
+   // BC7 has no decoder and throws.
+   CompressionStats DecompressMip(const uint8_t* blocks, uint8_t* destination, GenericTexFmt format, CompressionMode compMode, int32_t width, int32_t threadCount = 0);
+
+   struct CompressionQuality
+   {
+      double PSNR{}; // In dB, infinity for a lossless result.
+      double SSIM{}; // Mean of 8x8 windows, 1 for a lossless result.
+   };
+
+   // Compress a texture with its own CompressionMode, decode it, and compare the channels of its format to the original
+   // in 8-bit units. Logs the quality of every mip level, and returns the quality of all the texels.
+   CompressionQuality MeasureCompressionQuality(const GenericTexture& texture, EncodeQuality quality = EncodeQuality::Normal, int32_t threadCount = 0);
+
+   // Compress a whole texture laid out in SubRes[Array][Mip] order, ArraySliceSize bytes per array slice.
+   // The block format is selected by the format and the CompressionMode of info. The destination follows the same order, GetCompressedArraySliceSize() bytes per array slice.
+   CompressionStats CompressTexture(const uint8_t* texels, uint8_t* destination, const GenericTextureInfo& info,
+      EncodeQuality quality = EncodeQuality::Normal, int32_t threadCount = 0);
+
+   // Compress the PNG files of relativePaths without dithering at every EncodeQuality, on threadCount workers(0 = all hardware threads).
+   // Logs the throughput and the RMSE of the channels of their formats in 8-bit units, per file and of them all.
+   void BenchmarkEncodeQuality(const std::vector<string>& relativePaths, int32_t threadCount = 1);
+}
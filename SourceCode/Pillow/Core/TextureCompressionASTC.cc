@@ -0,0 +1,687 @@
+#include "TextureCompression.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   //                  Integer Sequence Encoding                  //
+   // A sequence of values in [0, Levels) is stored as Bits low bits per value, plus a trit or a quint per value
+   // as the high part. 5 trits pack into 8 bits, 3 quints into 7 bits, interleaved with the low bits.
+   struct ISERange
+   {
+      int32_t Levels;
+      int32_t Trits;
+      int32_t Quints;
+      int32_t Bits;
+   };
+
+   const ISERange ISERanges[]
+   {
+      { 2, 0, 0, 1 }, { 3, 1, 0, 0 }, { 4, 0, 0, 2 }, { 5, 0, 1, 0 }, { 6, 1, 0, 1 }, { 8, 0, 0, 3 }, { 10, 0, 1, 1 },
+      { 12, 1, 0, 2 }, { 16, 0, 0, 4 }, { 20, 0, 1, 2 }, { 24, 1, 0, 3 }, { 32, 0, 0, 5 }, { 40, 0, 1, 3 }, { 48, 1, 0, 4 },
+      { 64, 0, 0, 6 }, { 80, 0, 1, 4 }, { 96, 1, 0, 5 }, { 128, 0, 0, 7 }, { 160, 0, 1, 5 }, { 192, 1, 0, 6 }, { 256, 0, 0, 8 },
+   };
+   const int32_t ISERangeCount = sizeof(ISERanges) / sizeof(ISERange);
+   // The weights use the first 12 ranges, up to 32 levels.
+   const int32_t WeightRangeCount = 12;
+   // The end points of fewer levels aren't worth the block.
+   const int32_t MinColorRange = 4;
+
+   ForceInline int32_t GetISEBitCount(const ISERange& range, int32_t count)
+   {
+      return range.Bits * count + (range.Trits ? (8 * count + 4) / 5 : 0) + (range.Quints ? (7 * count + 2) / 3 : 0);
+   }
+
+   void DecodeTrits(int32_t code, int32_t* trits)
+   {
+      int32_t c;
+      if ((code >> 2 & 7) == 7)
+      {
+         c = (code >> 5 & 7) << 2 | (code & 3);
+         trits[4] = 2;
+         trits[3] = 2;
+      }
+      else
+      {
+         c = code & 31;
+         trits[4] = (code >> 5 & 3) == 3 ? 2 : code >> 7 & 1;
+         trits[3] = (code >> 5 & 3) == 3 ? code >> 7 & 1 : code >> 5 & 3;
+      }
+      if ((c & 3) == 3)
+      {
+         trits[2] = 2;
+         trits[1] = c >> 4 & 1;
+         trits[0] = (c >> 3 & 1) << 1 | (c >> 2 & ~c >> 3 & 1);
+      }
+      else if ((c >> 2 & 3) == 3)
+      {
+         trits[2] = 2;
+         trits[1] = 2;
+         trits[0] = c & 3;
+      }
+      else
+      {
+         trits[2] = c >> 4 & 1;
+         trits[1] = c >> 2 & 3;
+         trits[0] = (c >> 1 & 1) << 1 | (c & ~c >> 1 & 1);
+      }
+   }
+
+   void DecodeQuints(int32_t code, int32_t* quints)
+   {
+      if ((code >> 1 & 3) == 3 && (code >> 5 & 3) == 0)
+      {
+         quints[2] = (code & 1) << 2 | (code >> 4 & ~code & 1) << 1 | (code >> 3 & ~code & 1);
+         quints[1] = 4;
+         quints[0] = 4;
+         return;
+      }
+      int32_t c;
+      if ((code >> 1 & 3) == 3)
+      {
+         quints[2] = 4;
+         c = (code >> 3 & 3) << 3 | (~code >> 5 & 3) << 1 | (code & 1);
+      }
+      else
+      {
+         quints[2] = code >> 5 & 3;
+         c = code & 31;
+      }
+      quints[1] = (c & 7) == 5 ? 4 : c >> 3 & 3;
+      quints[0] = (c & 7) == 5 ? c >> 3 & 3 : c & 7;
+   }
+
+   // The color values unquantized to [0, 255], and the weights to [0, 64].
+   int32_t UnquantizeColor(const ISERange& range, int32_t value)
+   {
+      const int32_t bits = value & ((1 << range.Bits) - 1), high = value >> range.Bits;
+      if (!range.Trits && !range.Quints)
+      {
+         int32_t result = 0;
+         for (int32_t shift = 8 - range.Bits; shift > -range.Bits; shift -= range.Bits) result |= shift >= 0 ? bits << shift : bits >> -shift;
+         return result;
+      }
+      // The bits but the lowest are spread into B, the lowest bit flips the result.
+      const int32_t a = bits & 1 ? 0x1FF : 0;
+      const int32_t b = bits >> 1 & 1, c = bits >> 2 & 1, d = bits >> 3 & 1, e = bits >> 4 & 1, f = bits >> 5 & 1;
+      int32_t pattern = 0, factor = 0;
+      switch (range.Levels)
+      {
+      case 6: factor = 204; break;
+      case 10: factor = 113; break;
+      case 12: pattern = b * 0x116; factor = 93; break;
+      case 20: pattern = b * 0x10C; factor = 54; break;
+      case 24: pattern = c * 0x10A + b * 0x85; factor = 44; break;
+      case 40: pattern = c * 0x105 + b * 0x82; factor = 26; break;
+      case 48: pattern = d * 0x104 + c * 0x82 + b * 0x41; factor = 22; break;
+      case 80: pattern = d * 0x102 + c * 0x81 + b * 0x40; factor = 13; break;
+      case 96: pattern = e * 0x102 + d * 0x81 + c * 0x40 + b * 0x20; factor = 11; break;
+      case 160: pattern = e * 0x101 + d * 0x80 + c * 0x40 + b * 0x20; factor = 6; break;
+      case 192: pattern = f * 0x101 + e * 0x80 + d * 0x40 + c * 0x20 + b * 0x10; factor = 5; break;
+      }
+      const int32_t result = (high * factor + pattern) ^ a;
+      return (a & 0x80) | result >> 2;
+   }
+
+   int32_t UnquantizeWeight(const ISERange& range, int32_t value)
+   {
+      int32_t result;
+      if (!range.Trits && !range.Quints)
+      {
+         result = 0;
+         for (int32_t shift = 6 - range.Bits; shift > -range.Bits; shift -= range.Bits) result |= shift >= 0 ? value << shift : value >> -shift;
+      }
+      else if (range.Levels == 3)
+      {
+         static const int32_t tritWeights[3]{ 0, 32, 63 };
+         result = tritWeights[value];
+      }
+      else if (range.Levels == 5)
+      {
+         static const int32_t quintWeights[5]{ 0, 16, 32, 47, 63 };
+         result = quintWeights[value];
+      }
+      else
+      {
+         const int32_t bits = value & ((1 << range.Bits) - 1), high = value >> range.Bits;
+         const int32_t a = bits & 1 ? 0x7F : 0;
+         const int32_t b = bits >> 1 & 1, c = bits >> 2 & 1;
+         int32_t pattern = 0, factor = 0;
+         switch (range.Levels)
+         {
+         case 6: factor = 50; break;
+         case 10: factor = 28; break;
+         case 12: pattern = b * 0x45; factor = 23; break;
+         case 20: pattern = b * 0x42; factor = 13; break;
+         case 24: pattern = c * 0x42 + b * 0x21; factor = 11; break;
+         }
+         result = (a & 0x20) | ((high * factor + pattern) ^ a) >> 2;
+      }
+      return result > 32 ? result + 1 : result;
+   }
+
+   struct ISETables
+   {
+      uint8_t TritCodes[243]; // By t0 + 3t1 + 9t2 + 27t3 + 81t4.
+      uint8_t QuintCodes[125]; // By q0 + 5q1 + 25q2.
+      uint8_t Trits[256][5];
+      uint8_t Quints[128][3];
+      int16_t Colors[ISERangeCount][256];
+      int8_t Weights[WeightRangeCount][32];
+      // The codes of a range sorted by their unquantized value, which isn't monotonic with trits and quints.
+      uint8_t SortedColors[ISERangeCount][256];
+      uint8_t SortedWeights[WeightRangeCount][32];
+
+      ISETables()
+      {
+         // Many codes decode to the same trits or quints, the lowest one is taken.
+         bool tritSet[243]{}, quintSet[125]{};
+         for (int32_t code = 255; code >= 0; code--)
+         {
+            int32_t trits[5];
+            DecodeTrits(code, trits);
+            int32_t index = 0;
+            for (int32_t i = 4; i >= 0; i--)
+            {
+               Trits[code][i] = uint8_t(trits[i]);
+               index = index * 3 + trits[i];
+            }
+            TritCodes[index] = uint8_t(code);
+            tritSet[index] = true;
+         }
+         for (int32_t code = 127; code >= 0; code--)
+         {
+            int32_t quints[3];
+            DecodeQuints(code, quints);
+            for (int32_t i = 0; i < 3; i++) Quints[code][i] = uint8_t(quints[i]);
+            QuintCodes[quints[0] + 5 * quints[1] + 25 * quints[2]] = uint8_t(code);
+            quintSet[quints[0] + 5 * quints[1] + 25 * quints[2]] = true;
+         }
+         if (std::count(tritSet, tritSet + 243, false) || std::count(quintSet, quintSet + 125, false)) throw std::runtime_error("Incomplete ISE tables.");
+         for (int32_t range = 0; range < ISERangeCount; range++)
+         {
+            const int32_t levels = ISERanges[range].Levels;
+            for (int32_t value = 0; value < levels; value++)
+            {
+               Colors[range][value] = int16_t(range >= MinColorRange ? UnquantizeColor(ISERanges[range], value) : 0);
+               SortedColors[range][value] = uint8_t(value);
+            }
+            std::sort(SortedColors[range], SortedColors[range] + levels, [&](uint8_t left, uint8_t right) { return Colors[range][left] < Colors[range][right]; });
+         }
+         for (int32_t range = 0; range < WeightRangeCount; range++)
+         {
+            const int32_t levels = ISERanges[range].Levels;
+            for (int32_t value = 0; value < levels; value++)
+            {
+               Weights[range][value] = int8_t(UnquantizeWeight(ISERanges[range], value));
+               SortedWeights[range][value] = uint8_t(value);
+            }
+            std::sort(SortedWeights[range], SortedWeights[range] + levels, [&](uint8_t left, uint8_t right) { return Weights[range][left] < Weights[range][right]; });
+         }
+      }
+   };
+
+   const ISETables& GetISETables()
+   {
+      static const ISETables tables;
+      return tables;
+   }
+
+   // Bits are written from the lowest bit of the block up.
+   struct BitWriter
+   {
+      uint8_t* data;
+      int32_t position;
+
+      void Write(int32_t value, int32_t count)
+      {
+         for (int32_t i = 0; i < count; i++, position++) data[position >> 3] |= uint8_t((value >> i & 1) << (position & 7));
+      }
+   };
+
+   struct BitReader
+   {
+      const uint8_t* data;
+      int32_t position;
+
+      int32_t Read(int32_t count)
+      {
+         int32_t value = 0;
+         for (int32_t i = 0; i < count; i++, position++) value |= (data[position >> 3] >> (position & 7) & 1) << i;
+         return value;
+      }
+   };
+
+   // The trit / quint code bits following the low bits of each value of a group.
+   const int32_t TritCodeBits[5]{ 2, 2, 1, 2, 1 };
+   const int32_t QuintCodeBits[3]{ 3, 2, 2 };
+
+   void WriteISE(BitWriter& writer, const ISERange& range, const uint8_t* values, int32_t count)
+   {
+      const ISETables& tables = GetISETables();
+      const int32_t groupLength = range.Trits ? 5 : (range.Quints ? 3 : 1);
+      for (int32_t first = 0; first < count; first += groupLength)
+      {
+         const int32_t length = std::min(groupLength, count - first);
+         int32_t code = 0;
+         for (int32_t i = length - 1; i >= 0; i--) code = code * (range.Trits ? 3 : 5) + (values[first + i] >> range.Bits);
+         if (range.Trits) code = tables.TritCodes[code];
+         else if (range.Quints) code = tables.QuintCodes[code];
+         if (groupLength > 1 && length < groupLength)
+         {
+            // The code bits after the last value are left out, and read as 0, so the code must decode the same without them.
+            int32_t codeBits = 0;
+            for (int32_t i = 0; i < length; i++) codeBits += range.Trits ? TritCodeBits[i] : QuintCodeBits[i];
+            for (code = 0; code < (1 << codeBits); code++)
+            {
+               bool bMatch = true;
+               for (int32_t i = 0; i < length; i++) bMatch &= (range.Trits ? tables.Trits[code][i] : tables.Quints[code][i]) == values[first + i] >> range.Bits;
+               if (bMatch) break;
+            }
+         }
+         for (int32_t i = 0; i < length; i++)
+         {
+            writer.Write(values[first + i], range.Bits);
+            if (groupLength == 1) continue;
+            const int32_t codeBits = range.Trits ? TritCodeBits[i] : QuintCodeBits[i];
+            writer.Write(code, codeBits);
+            code >>= codeBits;
+         }
+      }
+   }
+
+   void ReadISE(BitReader& reader, const ISERange& range, uint8_t* values, int32_t count)
+   {
+      const ISETables& tables = GetISETables();
+      const int32_t groupLength = range.Trits ? 5 : (range.Quints ? 3 : 1);
+      for (int32_t first = 0; first < count; first += groupLength)
+      {
+         const int32_t length = std::min(groupLength, count - first);
+         int32_t code = 0, shift = 0;
+         for (int32_t i = 0; i < length; i++)
+         {
+            values[first + i] = uint8_t(reader.Read(range.Bits));
+            if (groupLength == 1) continue;
+            const int32_t codeBits = range.Trits ? TritCodeBits[i] : QuintCodeBits[i];
+            code |= reader.Read(codeBits) << shift;
+            shift += codeBits;
+         }
+         for (int32_t i = 0; i < length && groupLength > 1; i++)
+         {
+            const int32_t high = range.Trits ? tables.Trits[code][i] : tables.Quints[code][i];
+            values[first + i] = uint8_t(values[first + i] | high << range.Bits);
+         }
+      }
+   }
+
+   //                          ASTC                          //
+   // The blocks written here: a single partition, a single plane, a weight grid of the footprint, and one of the
+   // direct LDR color end point modes. The end points are stored after the 17 bits of the header, and the weights
+   // are stored bit-reversed from the top of the block.
+   const int32_t HeaderBits = 17; // Block mode(11 bits), partition count(2 bits), end point mode(4 bits)
+   const int32_t BlockBits = ASTCBlockSize * 8;
+
+   enum class EndPointMode : uint8_t
+   {
+      Luminance = 0,
+      RGB = 8,
+      RGBA = 12
+   };
+
+   ForceInline int32_t GetValueCount(int32_t channels)
+   {
+      return channels == 1 ? 2 : channels * 2;
+   }
+
+   // Weight grids of 4x4 have the high precision ranges too, 6x6 only the low ones(H = 0).
+   ForceInline int32_t GetBlockMode(int32_t blockWidth, int32_t weightRange)
+   {
+      const int32_t r = weightRange % 6 + 2, h = weightRange >= 6;
+      if (blockWidth == 4) return (r >> 1) | (r & 1) << 4 | 2 << 5 | h << 9;
+      return (r >> 1) << 2 | (r & 1) << 4 | 1 << 8;
+   }
+
+   // The texels of a block interpolated by a candidate, in 8 bits.
+   ForceInline int32_t Interpolate(int32_t first, int32_t second, int32_t weight)
+   {
+      return ((first * 257 * (64 - weight) + second * 257 * weight + 32) >> 6) >> 8;
+   }
+
+   struct ASTCCandidate
+   {
+      int32_t WeightRange;
+      int32_t ColorRange;
+      uint8_t Colors[8]; // The codes in the order of the end point mode: r0, r1, g0, g1, b0, b1, a0, a1.
+      uint8_t Weights[ASTCMaxBlockLength];
+      int64_t Error;
+   };
+
+   struct ASTCTexels
+   {
+      int32_t Values[ASTCMaxBlockLength][4];
+      int32_t Count;
+      int32_t Channels;
+   };
+
+   // The color code of each channel of an end point.
+   void QuantizeEndPoint(const float* ends, const ISERange& range, int32_t rangeIndex, int32_t channels, uint8_t* codes, int32_t* decoded)
+   {
+      const ISETables& tables = GetISETables();
+      for (int32_t c = 0; c < channels; c++)
+      {
+         const int32_t target = std::clamp(int32_t(ends[c] + 0.5f), 0, 255);
+         // The closest unquantized value, searched in the sorted codes.
+         const uint8_t* sorted = tables.SortedColors[rangeIndex];
+         const int16_t* colors = tables.Colors[rangeIndex];
+         const int32_t position = int32_t(std::lower_bound(sorted, sorted + range.Levels, target, [&](uint8_t code, int32_t value) { return colors[code] < value; }) - sorted);
+         int32_t code = sorted[std::min(position, range.Levels - 1)];
+         if (position > 0 && (position == range.Levels || target - colors[sorted[position - 1]] < colors[code] - target)) code = sorted[position - 1];
+         codes[c] = uint8_t(code);
+         decoded[c] = colors[code];
+      }
+   }
+
+   // Quantize the end points, order them for the end point mode, and pick the weights. Returns the squared error.
+   int64_t FitCandidate(const ASTCTexels& texels, const float(&ends)[2][4], ASTCCandidate& candidate)
+   {
+      const ISETables& tables = GetISETables();
+      const ISERange& colorRange = ISERanges[candidate.ColorRange];
+      const ISERange& weightRange = ISERanges[candidate.WeightRange];
+      const int32_t channels = texels.Channels;
+      uint8_t codes[2][4];
+      int32_t decoded[2][4]{};
+      QuantizeEndPoint(ends[0], colorRange, candidate.ColorRange, channels, codes[0], decoded[0]);
+      QuantizeEndPoint(ends[1], colorRange, candidate.ColorRange, channels, codes[1], decoded[1]);
+      // With a lower sum of RGB for the second end point, the decoder would swap them and contract the blue.
+      if (channels >= 3 && decoded[1][0] + decoded[1][1] + decoded[1][2] < decoded[0][0] + decoded[0][1] + decoded[0][2])
+      {
+         std::swap(codes[0], codes[1]);
+         std::swap(decoded[0], decoded[1]);
+      }
+      for (int32_t c = 0; c < channels; c++)
+      {
+         candidate.Colors[c * 2] = codes[0][c];
+         candidate.Colors[c * 2 + 1] = codes[1][c];
+      }
+      float axis[4]{}, length = 0;
+      for (int32_t c = 0; c < channels; c++)
+      {
+         axis[c] = float(decoded[1][c] - decoded[0][c]);
+         length += axis[c] * axis[c];
+      }
+      const uint8_t* sorted = tables.SortedWeights[candidate.WeightRange];
+      const int8_t* weights = tables.Weights[candidate.WeightRange];
+      int64_t error = 0;
+      for (int32_t i = 0; i < texels.Count; i++)
+      {
+         const int32_t* texel = texels.Values[i];
+         float projection = 0;
+         for (int32_t c = 0; c < channels; c++) projection += float(texel[c] - decoded[0][c]) * axis[c];
+         const float ideal = length > 0 ? std::clamp(projection / length, 0.f, 1.f) * 64 : 0;
+         // The 2 levels around the ideal weight, the closer one by the interpolated error.
+         int32_t position = 0;
+         while (position + 1 < weightRange.Levels && weights[sorted[position + 1]] <= ideal) position++;
+         int32_t best = INT_MAX;
+         for (int32_t k = position; k <= std::min(position + 1, weightRange.Levels - 1); k++)
+         {
+            int32_t texelError = 0;
+            for (int32_t c = 0; c < channels; c++)
+            {
+               const int32_t difference = Interpolate(decoded[0][c], decoded[1][c], weights[sorted[k]]) - texel[c];
+               texelError += difference * difference;
+            }
+            if (texelError >= best) continue;
+            best = texelError;
+            candidate.Weights[i] = sorted[k];
+         }
+         error += best;
+      }
+      candidate.Error = error;
+      return error;
+   }
+
+   // The least squares end points of the texels given their weights, returns false if the weights are all the same.
+   bool SolveEnds(const ASTCTexels& texels, const ASTCCandidate& candidate, float(&ends)[2][4])
+   {
+      const int8_t* weights = GetISETables().Weights[candidate.WeightRange];
+      float aa = 0, ab = 0, bb = 0, ax[4]{}, bx[4]{};
+      for (int32_t i = 0; i < texels.Count; i++)
+      {
+         const float b = weights[candidate.Weights[i]] / 64.f, a = 1 - b;
+         aa += a * a;
+         ab += a * b;
+         bb += b * b;
+         for (int32_t c = 0; c < texels.Channels; c++)
+         {
+            ax[c] += a * texels.Values[i][c];
+            bx[c] += b * texels.Values[i][c];
+         }
+      }
+      const float determinant = aa * bb - ab * ab;
+      if (std::abs(determinant) < FLT_EPSILON) return false;
+      for (int32_t c = 0; c < texels.Channels; c++)
+      {
+         ends[0][c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.f, 255.f);
+         ends[1][c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.f, 255.f);
+      }
+      return true;
+   }
+
+   // The end points of the line segment through the texels along their principal axis.
+   void FitEnds(const ASTCTexels& texels, float(&ends)[2][4])
+   {
+      const int32_t channels = texels.Channels;
+      float mean[4]{};
+      for (int32_t i = 0; i < texels.Count; i++)
+      {
+         for (int32_t c = 0; c < channels; c++) mean[c] += float(texels.Values[i][c]);
+      }
+      for (int32_t c = 0; c < channels; c++) mean[c] /= float(texels.Count);
+      float covariance[4][4]{};
+      for (int32_t i = 0; i < texels.Count; i++)
+      {
+         for (int32_t r = 0; r < channels; r++)
+         {
+            for (int32_t c = 0; c < channels; c++) covariance[r][c] += (texels.Values[i][r] - mean[r]) * (texels.Values[i][c] - mean[c]);
+         }
+      }
+      // Power iteration from the channel of the largest variance.
+      float axis[4]{};
+      int32_t largest = 0;
+      for (int32_t c = 1; c < channels; c++) if (covariance[c][c] > covariance[largest][largest]) largest = c;
+      for (int32_t c = 0; c < channels; c++) axis[c] = covariance[largest][c];
+      for (int32_t iteration = 0; iteration < 8; iteration++)
+      {
+         float next[4]{}, length = 0;
+         for (int32_t r = 0; r < channels; r++)
+         {
+            for (int32_t c = 0; c < channels; c++) next[r] += covariance[r][c] * axis[c];
+            length += next[r] * next[r];
+         }
+         if (length < FLT_MIN) break;
+         length = 1 / std::sqrt(length);
+         for (int32_t c = 0; c < channels; c++) axis[c] = next[c] * length;
+      }
+      float low = 0, high = 0;
+      for (int32_t i = 0; i < texels.Count; i++)
+      {
+         float projection = 0;
+         for (int32_t c = 0; c < channels; c++) projection += (texels.Values[i][c] - mean[c]) * axis[c];
+         low = std::min(low, projection);
+         high = std::max(high, projection);
+      }
+      for (int32_t c = 0; c < channels; c++)
+      {
+         ends[0][c] = std::clamp(mean[c] + axis[c] * low, 0.f, 255.f);
+         ends[1][c] = std::clamp(mean[c] + axis[c] * high, 0.f, 255.f);
+      }
+   }
+
+   void WriteVoidExtent(const int32_t* color, int32_t channels, uint8_t* destination)
+   {
+      // The LDR void extent, with all the extent coordinates set meaning the whole texture.
+      const uint64_t header = 0xFFFFFFFFFFFFFDFCull;
+      for (int32_t i = 0; i < 8; i++) destination[i] = uint8_t(header >> (i * 8));
+      for (int32_t c = 0; c < 4; c++)
+      {
+         const int32_t value = c == 3 ? (channels == 4 ? color[3] : 255) : color[channels == 1 ? 0 : c];
+         destination[8 + c * 2] = uint8_t(value);
+         destination[9 + c * 2] = uint8_t(value);
+      }
+   }
+
+   void WriteBlock(const ASTCCandidate& candidate, int32_t blockWidth, int32_t texelCount, EndPointMode mode, int32_t channels, uint8_t* destination)
+   {
+      std::fill(destination, destination + ASTCBlockSize, uint8_t(0));
+      BitWriter writer{ destination, 0 };
+      writer.Write(GetBlockMode(blockWidth, candidate.WeightRange), 11);
+      writer.Write(0, 2);
+      writer.Write(int32_t(mode), 4);
+      WriteISE(writer, ISERanges[candidate.ColorRange], candidate.Colors, GetValueCount(channels));
+      uint8_t weights[ASTCBlockSize]{};
+      BitWriter weightWriter{ weights, 0 };
+      WriteISE(weightWriter, ISERanges[candidate.WeightRange], candidate.Weights, texelCount);
+      for (int32_t i = 0; i < weightWriter.position; i++)
+      {
+         const int32_t position = BlockBits - 1 - i;
+         destination[position >> 3] |= uint8_t((weights[i >> 3] >> (i & 7) & 1) << (position & 7));
+      }
+   }
+}
+
+void Pillow::Graphics::EncodeASTC(const XMFLOAT4A* block, int32_t blockWidth, int32_t channels, uint8_t* destination)
+{
+   if ((blockWidth != 4 && blockWidth != 6) || (channels != 1 && channels != 3 && channels != 4)) throw std::runtime_error("Unsupported ASTC block.");
+   ASTCTexels texels{ {}, blockWidth * blockWidth, channels };
+   bool bSolid = true, bOpaque = true;
+   for (int32_t i = 0; i < texels.Count; i++)
+   {
+      const float* texel = &block[i].x;
+      for (int32_t c = 0; c < 4; c++) texels.Values[i][c] = std::clamp(int32_t(texel[c] * 255 + 0.5f), 0, 255);
+      for (int32_t c = 0; c < channels; c++) bSolid &= texels.Values[i][c] == texels.Values[0][c];
+      bOpaque &= texels.Values[i][3] == 255;
+   }
+   if (bSolid)
+   {
+      WriteVoidExtent(texels.Values[0], channels, destination);
+      return;
+   }
+   // An opaque block saves the bits of the alpha, RGB decodes to an alpha of 1.
+   if (channels == 4 && bOpaque) texels.Channels = channels = 3;
+   const EndPointMode mode = channels == 1 ? EndPointMode::Luminance : (channels == 3 ? EndPointMode::RGB : EndPointMode::RGBA);
+   float ends[2][4]{};
+   FitEnds(texels, ends);
+   // Every weight precision leaves the rest of the bits to the end points, the best balance depends on the block.
+   ASTCCandidate best{};
+   best.Error = INT64_MAX;
+   const int32_t valueCount = GetValueCount(channels);
+   const int32_t weightRangeCount = blockWidth == 4 ? WeightRangeCount : WeightRangeCount / 2;
+   for (int32_t weightRange = 0; weightRange < weightRangeCount; weightRange++)
+   {
+      const int32_t weightBits = GetISEBitCount(ISERanges[weightRange], texels.Count);
+      if (weightBits < 24 || weightBits > 96) continue;
+      const int32_t colorBits = BlockBits - HeaderBits - weightBits;
+      int32_t colorRange = ISERangeCount - 1;
+      while (colorRange >= 0 && GetISEBitCount(ISERanges[colorRange], valueCount) > colorBits) colorRange--;
+      if (colorRange < MinColorRange) continue;
+      ASTCCandidate candidate{};
+      candidate.WeightRange = weightRange;
+      candidate.ColorRange = colorRange;
+      FitCandidate(texels, ends, candidate);
+      float refined[2][4]{};
+      ASTCCandidate refinedCandidate = candidate;
+      if (candidate.Error > 0 && SolveEnds(texels, candidate, refined) && FitCandidate(texels, refined, refinedCandidate) < candidate.Error) candidate = refinedCandidate;
+      if (candidate.Error < best.Error) best = candidate;
+   }
+   WriteBlock(best, blockWidth, texels.Count, mode, channels, destination);
+}
+
+void Pillow::Graphics::DecodeASTC(const uint8_t* block, int32_t blockWidth, XMFLOAT4A* destination)
+{
+   const int32_t texelCount = blockWidth * blockWidth;
+   BitReader reader{ block, 0 };
+   const int32_t blockMode = reader.Read(11);
+   if ((blockMode & 0x1FF) == 0x1FC)
+   {
+      if (blockMode & 0x200) throw std::runtime_error("HDR ASTC blocks aren't supported.");
+      float color[4];
+      for (int32_t c = 0; c < 4; c++) color[c] = float(block[8 + c * 2] | block[9 + c * 2] << 8) / 65535.f;
+      for (int32_t i = 0; i < texelCount; i++) destination[i] = XMFLOAT4A(color);
+      return;
+   }
+   // The layouts of the block modes EncodeASTC() writes.
+   int32_t gridWidth, gridHeight, r, h;
+   if (blockMode & 3)
+   {
+      if (blockMode >> 2 & 3) throw std::runtime_error("Unsupported ASTC block mode.");
+      gridWidth = (blockMode >> 7 & 3) + 4;
+      gridHeight = (blockMode >> 5 & 3) + 2;
+      r = (blockMode & 3) << 1 | (blockMode >> 4 & 1);
+      h = blockMode >> 9 & 1;
+   }
+   else
+   {
+      if ((blockMode >> 7 & 3) != 2) throw std::runtime_error("Unsupported ASTC block mode.");
+      gridWidth = (blockMode >> 5 & 3) + 6;
+      gridHeight = (blockMode >> 9 & 3) + 6;
+      r = (blockMode >> 2 & 3) << 1 | (blockMode >> 4 & 1);
+      h = 0;
+   }
+   if ((blockMode & 3) && (blockMode >> 10 & 1)) throw std::runtime_error("Dual plane ASTC blocks aren't supported.");
+   if (gridWidth != blockWidth || gridHeight != blockWidth || r < 2) throw std::runtime_error("Unsupported ASTC weight grid.");
+   if (reader.Read(2) != 0) throw std::runtime_error("Partitioned ASTC blocks aren't supported.");
+   const EndPointMode mode = EndPointMode(reader.Read(4));
+   if (mode != EndPointMode::Luminance && mode != EndPointMode::RGB && mode != EndPointMode::RGBA) throw std::runtime_error("Unsupported ASTC end point mode.");
+   const int32_t channels = mode == EndPointMode::Luminance ? 1 : (mode == EndPointMode::RGB ? 3 : 4);
+   const int32_t weightRange = (r - 2) + h * 6;
+   const int32_t weightBits = GetISEBitCount(ISERanges[weightRange], texelCount);
+   const int32_t valueCount = GetValueCount(channels);
+   int32_t colorRange = ISERangeCount - 1;
+   while (colorRange >= 0 && GetISEBitCount(ISERanges[colorRange], valueCount) > BlockBits - HeaderBits - weightBits) colorRange--;
+   if (colorRange < MinColorRange) throw std::runtime_error("Unsupported ASTC color range.");
+   const ISETables& tables = GetISETables();
+   uint8_t codes[8];
+   ReadISE(reader, ISERanges[colorRange], codes, valueCount);
+   int32_t values[8];
+   for (int32_t i = 0; i < valueCount; i++) values[i] = tables.Colors[colorRange][codes[i]];
+   int32_t ends[2][4];
+   for (int32_t e = 0; e < 2; e++)
+   {
+      for (int32_t c = 0; c < 3; c++) ends[e][c] = values[channels == 1 ? e : c * 2 + e];
+      ends[e][3] = channels == 4 ? values[6 + e] : 255;
+   }
+   if (channels >= 3 && ends[1][0] + ends[1][1] + ends[1][2] < ends[0][0] + ends[0][1] + ends[0][2])
+   {
+      // Blue contraction, with the end points swapped.
+      std::swap(ends[0], ends[1]);
+      for (int32_t e = 0; e < 2; e++)
+      {
+         ends[e][0] = (ends[e][0] + ends[e][2]) >> 1;
+         ends[e][1] = (ends[e][1] + ends[e][2]) >> 1;
+      }
+   }
+   uint8_t reversed[ASTCBlockSize]{};
+   for (int32_t i = 0; i < weightBits; i++)
+   {
+      const int32_t position = BlockBits - 1 - i;
+      reversed[i >> 3] |= uint8_t((block[position >> 3] >> (position & 7) & 1) << (i & 7));
+   }
+   BitReader weightReader{ reversed, 0 };
+   uint8_t weights[ASTCMaxBlockLength];
+   ReadISE(weightReader, ISERanges[weightRange], weights, texelCount);
+   for (int32_t i = 0; i < texelCount; i++)
+   {
+      const int32_t weight = tables.Weights[weightRange][weights[i]];
+      float color[4];
+      for (int32_t c = 0; c < 4; c++)
+      {
+         color[c] = float((ends[0][c] * 257 * (64 - weight) + ends[1][c] * 257 * weight + 32) >> 6) / 65535.f;
+      }
+      destination[i] = XMFLOAT4A(color);
+   }
+}
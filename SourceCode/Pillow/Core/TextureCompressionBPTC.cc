@@ -0,0 +1,795 @@
+#include "TextureCompression.h"
+#include "DirectXMath-apr2025/DirectXPackedVector.h"
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// BC6H and BC7 share the block layout family BPTC: 128-bit blocks of end point pairs, per subset of a partition,
+// and interpolation weights in 1/64. The bits are written LSB first.
+namespace
+{
+   //                  Partition Tables                  //
+   // A bit / an entry per texel, for the subset it's in. //
+   const uint16_t Partitions2[64]
+   {
+      0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+      0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+      0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+      0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+      0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+      0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+      0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+      0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+   };
+
+   const uint8_t Partitions3[64][16]
+   {
+      { 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 }, { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+      { 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 }, { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+      { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+      { 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 }, { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+      { 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 }, { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+      { 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 }, { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+      { 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 }, { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+      { 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 }, { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+      { 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 }, { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+      { 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 }, { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+      { 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+      { 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 }, { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+      { 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 }, { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+      { 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 }, { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+      { 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 }, { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+      { 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 }, { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 },
+   };
+
+   // The anchor texels, whose index drops its highest bit. Texel 0 anchors the first subset.
+   const uint8_t Anchors2[64]
+   {
+      15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+      15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+      15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+       6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+   };
+
+   const uint8_t Anchors3Second[64]
+   {
+       3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+       3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+       8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+       3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+   };
+
+   const uint8_t Anchors3Third[64]
+   {
+      15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+      15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+      15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+      15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+   };
+
+   const int32_t Weights2[4]{ 0, 21, 43, 64 };
+   const int32_t Weights3[8]{ 0, 9, 18, 27, 37, 46, 55, 64 };
+   const int32_t Weights4[16]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+   ForceInline const int32_t* GetWeights(int32_t indexBits)
+   {
+      return indexBits == 2 ? Weights2 : indexBits == 3 ? Weights3 : Weights4;
+   }
+
+   ForceInline int32_t GetSubset(int32_t subsetCount, int32_t partition, int32_t texel)
+   {
+      if (subsetCount == 1) return 0;
+      if (subsetCount == 2) return Partitions2[partition] >> texel & 1;
+      return Partitions3[partition][texel];
+   }
+
+   ForceInline int32_t GetAnchor(int32_t subsetCount, int32_t partition, int32_t subset)
+   {
+      if (subset == 0) return 0;
+      if (subsetCount == 2) return Anchors2[partition];
+      return subset == 1 ? Anchors3Second[partition] : Anchors3Third[partition];
+   }
+
+   ForceInline bool IsAnchor(int32_t subsetCount, int32_t partition, int32_t texel)
+   {
+      for (int32_t subset = 0; subset < subsetCount; subset++)
+      {
+         if (GetAnchor(subsetCount, partition, subset) == texel) return true;
+      }
+      return false;
+   }
+
+   struct BlockWriter
+   {
+      uint8_t* Destination;
+      int32_t Position;
+
+      ForceInline void Write(uint32_t value, int32_t bitCount)
+      {
+         for (int32_t i = 0; i < bitCount; i++, Position++) Destination[Position >> 3] |= uint8_t((value >> i & 1) << (Position & 7));
+      }
+
+      // The highest bit first, for the BC6H fields stored backwards.
+      ForceInline void WriteReversed(uint32_t value, int32_t bitCount)
+      {
+         for (int32_t i = bitCount - 1; i >= 0; i--, Position++) Destination[Position >> 3] |= uint8_t((value >> i & 1) << (Position & 7));
+      }
+   };
+
+   // The texels of a subset, and the line through them along their principal axis.
+   struct SubsetLine
+   {
+      int32_t Members[BCBlockLength];
+      int32_t Count;
+      float Mean[4];
+      float Axis[4];
+      // The squared distances of the texels to the line.
+      float Residual;
+   };
+
+   void FitLine(const float(*texels)[4], int32_t channels, SubsetLine& line)
+   {
+      float covariance[4][4]{};
+      for (int32_t c = 0; c < 4; c++) line.Mean[c] = line.Axis[c] = 0;
+      for (int32_t i = 0; i < line.Count; i++)
+      {
+         for (int32_t c = 0; c < channels; c++) line.Mean[c] += texels[line.Members[i]][c];
+      }
+      for (int32_t c = 0; c < channels; c++) line.Mean[c] /= std::max(line.Count, 1);
+      float trace = 0;
+      for (int32_t i = 0; i < line.Count; i++)
+      {
+         float delta[4];
+         for (int32_t c = 0; c < channels; c++) delta[c] = texels[line.Members[i]][c] - line.Mean[c];
+         for (int32_t a = 0; a < channels; a++)
+         {
+            for (int32_t b = 0; b < channels; b++) covariance[a][b] += delta[a] * delta[b];
+         }
+      }
+      // Power iteration, starting from the channel of the largest variance.
+      int32_t largest = 0;
+      for (int32_t c = 0; c < channels; c++)
+      {
+         trace += covariance[c][c];
+         if (covariance[c][c] > covariance[largest][largest]) largest = c;
+      }
+      line.Residual = 0;
+      if (trace < 1e-6f) return;
+      // Normalized, so the iterations don't overflow with the large values of BC6H.
+      for (int32_t c = 0; c < channels; c++) line.Axis[c] = covariance[largest][c] / covariance[largest][largest];
+      float eigenvalue = 0;
+      for (int32_t iteration = 0; iteration < 8; iteration++)
+      {
+         float next[4]{}, length = 0;
+         for (int32_t a = 0; a < channels; a++)
+         {
+            for (int32_t b = 0; b < channels; b++) next[a] += covariance[a][b] * line.Axis[b];
+            length += next[a] * next[a];
+         }
+         if (length < 1e-12f) break;
+         length = std::sqrt(length);
+         for (int32_t c = 0; c < channels; c++) line.Axis[c] = next[c] / length;
+         eigenvalue = length;
+      }
+      line.Residual = std::max(trace - eigenvalue, 0.f);
+   }
+
+   // The end points of the line segment covering the texels.
+   void GetLineEnds(const float(*texels)[4], int32_t channels, const SubsetLine& line, float maxValue, float(&ends)[2][4])
+   {
+      float low = 0, high = 0;
+      for (int32_t i = 0; i < line.Count; i++)
+      {
+         float t = 0;
+         for (int32_t c = 0; c < channels; c++) t += (texels[line.Members[i]][c] - line.Mean[c]) * line.Axis[c];
+         low = std::min(low, t);
+         high = std::max(high, t);
+      }
+      for (int32_t c = 0; c < 4; c++)
+      {
+         ends[0][c] = std::clamp(line.Mean[c] + low * line.Axis[c], 0.f, maxValue);
+         ends[1][c] = std::clamp(line.Mean[c] + high * line.Axis[c], 0.f, maxValue);
+      }
+   }
+
+   // The least squares end points of the texels of channels [first, last), given their weights in 1/64.
+   bool SolveEnds(const float(*texels)[4], const int32_t* members, int32_t count, const int32_t* weights, int32_t first, int32_t last, float maxValue, float(&ends)[2][4])
+   {
+      float a = 0, b = 0, c = 0, x0[4]{}, x1[4]{};
+      for (int32_t i = 0; i < count; i++)
+      {
+         const float w = weights[i] / 64.f, v = 1 - w;
+         a += v * v;
+         b += v * w;
+         c += w * w;
+         for (int32_t ch = first; ch < last; ch++)
+         {
+            x0[ch] += v * texels[members[i]][ch];
+            x1[ch] += w * texels[members[i]][ch];
+         }
+      }
+      const float determinant = a * c - b * b;
+      if (std::abs(determinant) < 1e-6f) return false;
+      for (int32_t ch = first; ch < last; ch++)
+      {
+         ends[0][ch] = std::clamp((c * x0[ch] - b * x1[ch]) / determinant, 0.f, maxValue);
+         ends[1][ch] = std::clamp((a * x1[ch] - b * x0[ch]) / determinant, 0.f, maxValue);
+      }
+      return true;
+   }
+
+   //                         BC7                         //
+   struct BC7ModeInfo
+   {
+      int32_t SubsetCount;
+      int32_t PartitionBits;
+      int32_t RotationBits;
+      int32_t IndexSelectionBits;
+      int32_t ColorBits;
+      int32_t AlphaBits; // 0 = opaque
+      int32_t EndPointPBits; // A p-bit per end point.
+      int32_t SharedPBits; // A p-bit per subset.
+      int32_t IndexBits;
+      int32_t SecondaryIndexBits; // Modes 4 and 5 index the alpha separately.
+   };
+
+   const BC7ModeInfo BC7Modes[8]
+   {
+      { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+      { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+      { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+      { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+      { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+      { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+      { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+      { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+   };
+
+   struct BC7Block
+   {
+      int32_t Mode;
+      int32_t Partition;
+      int32_t Rotation;
+      int32_t IndexSelection;
+      // Per subset, per end point. Channel 3 is the alpha, if the mode has it.
+      int32_t Codes[3][2][4];
+      int32_t PBits[3][2];
+      int32_t Decoded[3][2][4];
+      int32_t Indices[BCBlockLength];
+      int32_t SecondaryIndices[BCBlockLength];
+      float Error;
+   };
+
+   // Expand the bits to 8 by repeating the highest ones.
+   ForceInline int32_t UnquantizeBC7(int32_t value, int32_t bits)
+   {
+      value <<= 8 - bits;
+      return value | value >> bits;
+   }
+
+   // The code of bits whose value, with the p-bit appended(-1 = none), is the closest to value.
+   ForceInline int32_t QuantizeBC7(float value, int32_t bits, int32_t pBit, int32_t& decoded)
+   {
+      const int32_t totalBits = pBit < 0 ? bits : bits + 1;
+      const float scaled = value / UINT8_MAX * ((1 << totalBits) - 1);
+      const int32_t guess = pBit < 0 ? int32_t(scaled + 0.5f) : int32_t((scaled - pBit) / 2 + 0.5f);
+      int32_t best = 0;
+      float bestError = FLT_MAX;
+      // The bit repetition isn't linear, so the neighbors of the guess are checked.
+      for (int32_t code = std::max(guess - 1, 0); code <= std::min(guess + 1, (1 << bits) - 1); code++)
+      {
+         const int32_t candidate = UnquantizeBC7(pBit < 0 ? code : code << 1 | pBit, totalBits);
+         const float error = std::abs(candidate - value);
+         if (error >= bestError) continue;
+         bestError = error;
+         best = code;
+         decoded = candidate;
+      }
+      return best;
+   }
+
+   // Quantize an end point of channels [first, last) with a p-bit, returns the squared error.
+   float QuantizeEndPoint(const float* value, const BC7ModeInfo& mode, int32_t first, int32_t last, int32_t pBit, int32_t* codes, int32_t* decoded)
+   {
+      float error = 0;
+      for (int32_t c = first; c < last; c++)
+      {
+         codes[c] = QuantizeBC7(value[c], c < 3 ? mode.ColorBits : mode.AlphaBits, pBit, decoded[c]);
+         error += (decoded[c] - value[c]) * (decoded[c] - value[c]);
+      }
+      return error;
+   }
+
+   // Quantize the end points of a subset in channels [first, last), choosing the p-bits.
+   void QuantizeEnds(const float(&ends)[2][4], const BC7ModeInfo& mode, int32_t first, int32_t last, BC7Block& block, int32_t subset)
+   {
+      int32_t(&codes)[2][4] = block.Codes[subset];
+      int32_t(&decoded)[2][4] = block.Decoded[subset];
+      if (mode.EndPointPBits)
+      {
+         for (int32_t end = 0; end < 2; end++)
+         {
+            int32_t codes1[4], decoded1[4];
+            const float error0 = QuantizeEndPoint(ends[end], mode, first, last, 0, codes[end], decoded[end]);
+            const float error1 = QuantizeEndPoint(ends[end], mode, first, last, 1, codes1, decoded1);
+            block.PBits[subset][end] = error1 < error0;
+            if (error1 >= error0) continue;
+            std::copy(codes1 + first, codes1 + last, codes[end] + first);
+            std::copy(decoded1 + first, decoded1 + last, decoded[end] + first);
+         }
+      }
+      else if (mode.SharedPBits)
+      {
+         int32_t codes1[2][4], decoded1[2][4];
+         const float error0 = QuantizeEndPoint(ends[0], mode, first, last, 0, codes[0], decoded[0]) + QuantizeEndPoint(ends[1], mode, first, last, 0, codes[1], decoded[1]);
+         const float error1 = QuantizeEndPoint(ends[0], mode, first, last, 1, codes1[0], decoded1[0]) + QuantizeEndPoint(ends[1], mode, first, last, 1, codes1[1], decoded1[1]);
+         block.PBits[subset][0] = block.PBits[subset][1] = error1 < error0;
+         if (error1 >= error0) return;
+         for (int32_t end = 0; end < 2; end++)
+         {
+            std::copy(codes1[end] + first, codes1[end] + last, codes[end] + first);
+            std::copy(decoded1[end] + first, decoded1[end] + last, decoded[end] + first);
+         }
+      }
+      else
+      {
+         block.PBits[subset][0] = block.PBits[subset][1] = -1;
+         for (int32_t end = 0; end < 2; end++) QuantizeEndPoint(ends[end], mode, first, last, -1, codes[end], decoded[end]);
+      }
+   }
+
+   // Pick the closest palette entry for the texels in channels [first, last), returns the squared error.
+   float AssignIndices(const float(*texels)[4], const int32_t* members, int32_t count, const int32_t(&decoded)[2][4], int32_t indexBits,
+      int32_t first, int32_t last, int32_t* indices)
+   {
+      const int32_t* weights = GetWeights(indexBits);
+      float palette[16][4];
+      for (int32_t i = 0; i < 1 << indexBits; i++)
+      {
+         for (int32_t c = first; c < last; c++) palette[i][c] = float(((64 - weights[i]) * decoded[0][c] + weights[i] * decoded[1][c] + 32) >> 6);
+      }
+      float total = 0;
+      for (int32_t i = 0; i < count; i++)
+      {
+         const float* texel = texels[members[i]];
+         float bestError = FLT_MAX;
+         for (int32_t j = 0; j < 1 << indexBits; j++)
+         {
+            float error = 0;
+            for (int32_t c = first; c < last; c++) error += (palette[j][c] - texel[c]) * (palette[j][c] - texel[c]);
+            if (error >= bestError) continue;
+            bestError = error;
+            indices[members[i]] = j;
+         }
+         total += bestError;
+      }
+      return total;
+   }
+
+   // Fit, quantize and index channels [first, last) of a subset, then refine the end points by least squares.
+   float EncodeSubset(const float(*texels)[4], const SubsetLine& line, const BC7ModeInfo& mode, int32_t indexBits, int32_t first, int32_t last,
+      int32_t refinements, BC7Block& block, int32_t subset, int32_t* indices)
+   {
+      float ends[2][4];
+      GetLineEnds(texels, 4, line, UINT8_MAX, ends);
+      QuantizeEnds(ends, mode, first, last, block, subset);
+      float error = AssignIndices(texels, line.Members, line.Count, block.Decoded[subset], indexBits, first, last, indices);
+      for (int32_t iteration = 0; iteration < refinements && error > 0; iteration++)
+      {
+         const int32_t* palette = GetWeights(indexBits);
+         int32_t weights[BCBlockLength];
+         for (int32_t i = 0; i < line.Count; i++) weights[i] = palette[indices[line.Members[i]]];
+         if (!SolveEnds(texels, line.Members, line.Count, weights, first, last, UINT8_MAX, ends)) break;
+         BC7Block trial = block;
+         int32_t trialIndices[BCBlockLength];
+         QuantizeEnds(ends, mode, first, last, trial, subset);
+         const float trialError = AssignIndices(texels, line.Members, line.Count, trial.Decoded[subset], indexBits, first, last, trialIndices);
+         if (trialError >= error) break;
+         error = trialError;
+         std::memcpy(block.Codes[subset], trial.Codes[subset], sizeof(trial.Codes[subset]));
+         std::memcpy(block.Decoded[subset], trial.Decoded[subset], sizeof(trial.Decoded[subset]));
+         std::memcpy(block.PBits[subset], trial.PBits[subset], sizeof(trial.PBits[subset]));
+         for (int32_t i = 0; i < line.Count; i++) indices[line.Members[i]] = trialIndices[line.Members[i]];
+      }
+      return error;
+   }
+
+   // Swap the end points of channels [first, last) of a subset, if its anchor index has the highest bit set.
+   void FixAnchor(BC7Block& block, int32_t subset, int32_t anchor, const SubsetLine& line, int32_t indexBits, int32_t first, int32_t last, int32_t* indices)
+   {
+      const int32_t maxIndex = (1 << indexBits) - 1;
+      if (indices[anchor] <= maxIndex >> 1) return;
+      for (int32_t c = first; c < last; c++)
+      {
+         std::swap(block.Codes[subset][0][c], block.Codes[subset][1][c]);
+         std::swap(block.Decoded[subset][0][c], block.Decoded[subset][1][c]);
+      }
+      std::swap(block.PBits[subset][0], block.PBits[subset][1]);
+      for (int32_t i = 0; i < line.Count; i++) indices[line.Members[i]] = maxIndex - indices[line.Members[i]];
+   }
+
+   void SplitSubsets(int32_t subsetCount, int32_t partition, SubsetLine* lines)
+   {
+      for (int32_t subset = 0; subset < subsetCount; subset++) lines[subset].Count = 0;
+      for (int32_t texel = 0; texel < BCBlockLength; texel++)
+      {
+         SubsetLine& line = lines[GetSubset(subsetCount, partition, texel)];
+         line.Members[line.Count++] = texel;
+      }
+   }
+
+   // The modes with a single set of indices for all the channels: 0, 1, 2, 3, 6 and 7.
+   void EncodeBC7Combined(const float(*texels)[4], int32_t modeIndex, int32_t partition, int32_t refinements, BC7Block& block)
+   {
+      const BC7ModeInfo& mode = BC7Modes[modeIndex];
+      block.Mode = modeIndex;
+      block.Partition = partition;
+      block.Rotation = block.IndexSelection = 0;
+      block.Error = 0;
+      const int32_t channels = mode.AlphaBits ? 4 : 3;
+      SubsetLine lines[3];
+      SplitSubsets(mode.SubsetCount, partition, lines);
+      for (int32_t subset = 0; subset < mode.SubsetCount; subset++)
+      {
+         FitLine(texels, channels, lines[subset]);
+         block.Error += EncodeSubset(texels, lines[subset], mode, mode.IndexBits, 0, channels, refinements, block, subset, block.Indices);
+         FixAnchor(block, subset, GetAnchor(mode.SubsetCount, partition, subset), lines[subset], mode.IndexBits, 0, channels, block.Indices);
+         // The opaque modes decode the alpha to 255.
+         if (channels == 3)
+         {
+            block.Decoded[subset][0][3] = block.Decoded[subset][1][3] = UINT8_MAX;
+            for (int32_t i = 0; i < lines[subset].Count; i++)
+            {
+               const float delta = UINT8_MAX - texels[lines[subset].Members[i]][3];
+               block.Error += delta * delta;
+            }
+         }
+      }
+   }
+
+   // Modes 4 and 5, where a channel rotated into the alpha is indexed on its own.
+   void EncodeBC7Separate(const float(*texels)[4], int32_t modeIndex, int32_t rotation, int32_t indexSelection, int32_t refinements, BC7Block& block)
+   {
+      const BC7ModeInfo& mode = BC7Modes[modeIndex];
+      block.Mode = modeIndex;
+      block.Partition = 0;
+      block.Rotation = rotation;
+      block.IndexSelection = indexSelection;
+      float rotated[BCBlockLength][4];
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         std::copy(texels[i], texels[i] + 4, rotated[i]);
+         if (rotation) std::swap(rotated[i][rotation - 1], rotated[i][3]);
+      }
+      SubsetLine line;
+      SplitSubsets(1, 0, &line);
+      FitLine(rotated, 3, line);
+      int32_t* colorIndices = indexSelection ? block.SecondaryIndices : block.Indices;
+      int32_t* alphaIndices = indexSelection ? block.Indices : block.SecondaryIndices;
+      const int32_t colorIndexBits = indexSelection ? mode.SecondaryIndexBits : mode.IndexBits;
+      const int32_t alphaIndexBits = indexSelection ? mode.IndexBits : mode.SecondaryIndexBits;
+      block.Error = EncodeSubset(rotated, line, mode, colorIndexBits, 0, 3, refinements, block, 0, colorIndices);
+      FixAnchor(block, 0, 0, line, colorIndexBits, 0, 3, colorIndices);
+      // The alpha line is the range of the alpha values.
+      SubsetLine alphaLine = line;
+      float low = UINT8_MAX, high = 0;
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         low = std::min(low, rotated[i][3]);
+         high = std::max(high, rotated[i][3]);
+      }
+      std::fill(std::begin(alphaLine.Axis), std::end(alphaLine.Axis), 0.f);
+      alphaLine.Mean[3] = (low + high) / 2;
+      alphaLine.Axis[3] = 1;
+      block.Error += EncodeSubset(rotated, alphaLine, mode, alphaIndexBits, 3, 4, refinements, block, 0, alphaIndices);
+      FixAnchor(block, 0, 0, alphaLine, alphaIndexBits, 3, 4, alphaIndices);
+      block.PBits[0][0] = block.PBits[0][1] = -1;
+   }
+
+   // The squared error of a partition, from the distances of the texels to the lines of their subsets.
+   float EstimatePartition(const float(*texels)[4], int32_t subsetCount, int32_t partition, int32_t channels)
+   {
+      SubsetLine lines[3];
+      SplitSubsets(subsetCount, partition, lines);
+      float error = 0;
+      for (int32_t subset = 0; subset < subsetCount; subset++)
+      {
+         FitLine(texels, channels, lines[subset]);
+         error += lines[subset].Residual;
+      }
+      return error;
+   }
+
+   void TryBC7Partitions(const float(*texels)[4], int32_t modeIndex, int32_t partitionCount, int32_t refinements, BC7Block& best)
+   {
+      const BC7ModeInfo& mode = BC7Modes[modeIndex];
+      const int32_t channels = mode.AlphaBits ? 4 : 3;
+      std::pair<float, int32_t> estimates[64];
+      const int32_t total = 1 << mode.PartitionBits;
+      for (int32_t partition = 0; partition < total; partition++)
+      {
+         estimates[partition] = { EstimatePartition(texels, mode.SubsetCount, partition, channels), partition };
+      }
+      partitionCount = std::min(partitionCount, total);
+      std::partial_sort(estimates, estimates + partitionCount, estimates + total);
+      for (int32_t i = 0; i < partitionCount; i++)
+      {
+         BC7Block block;
+         EncodeBC7Combined(texels, modeIndex, estimates[i].second, refinements, block);
+         if (block.Error < best.Error) best = block;
+      }
+   }
+
+   void WriteBC7Block(const BC7Block& block, uint8_t* destination)
+   {
+      const BC7ModeInfo& mode = BC7Modes[block.Mode];
+      std::memset(destination, 0, BC7BlockSize);
+      BlockWriter writer{ destination, 0 };
+      writer.Write(1 << block.Mode, block.Mode + 1);
+      writer.Write(block.Partition, mode.PartitionBits);
+      writer.Write(block.Rotation, mode.RotationBits);
+      writer.Write(block.IndexSelection, mode.IndexSelectionBits);
+      for (int32_t c = 0; c < 3; c++)
+      {
+         for (int32_t subset = 0; subset < mode.SubsetCount; subset++)
+         {
+            writer.Write(block.Codes[subset][0][c], mode.ColorBits);
+            writer.Write(block.Codes[subset][1][c], mode.ColorBits);
+         }
+      }
+      for (int32_t subset = 0; subset < mode.SubsetCount && mode.AlphaBits; subset++)
+      {
+         writer.Write(block.Codes[subset][0][3], mode.AlphaBits);
+         writer.Write(block.Codes[subset][1][3], mode.AlphaBits);
+      }
+      for (int32_t subset = 0; subset < mode.SubsetCount; subset++)
+      {
+         if (mode.EndPointPBits)
+         {
+            writer.Write(block.PBits[subset][0], 1);
+            writer.Write(block.PBits[subset][1], 1);
+         }
+         else if (mode.SharedPBits) writer.Write(block.PBits[subset][0], 1);
+      }
+      for (int32_t texel = 0; texel < BCBlockLength; texel++)
+      {
+         writer.Write(block.Indices[texel], mode.IndexBits - IsAnchor(mode.SubsetCount, block.Partition, texel));
+      }
+      for (int32_t texel = 0; texel < BCBlockLength && mode.SecondaryIndexBits; texel++)
+      {
+         writer.Write(block.SecondaryIndices[texel], mode.SecondaryIndexBits - (texel == 0));
+      }
+   }
+
+   //                         BC6H                         //
+   // The unsigned modes with a single subset: 11 stores the end points as they are, 12 to 14 store the second one
+   // as a signed delta of fewer bits from the first one, so that close end points get more precision.
+   struct BC6HModeInfo
+   {
+      uint32_t ModeBits;
+      int32_t EndPointBits;
+      int32_t DeltaBits; // 0 = not transformed
+   };
+
+   const BC6HModeInfo BC6HModes[4]
+   {
+      { 0x03, 10, 0 },
+      { 0x07, 11, 9 },
+      { 0x0B, 12, 8 },
+      { 0x0F, 16, 4 },
+   };
+
+   // The 16-bit value the hardware interpolates, the decoded half is (value * 31) >> 6.
+   ForceInline int32_t UnquantizeBC6H(int32_t code, int32_t bits)
+   {
+      if (bits >= 15) return code;
+      if (code == 0) return 0;
+      if (code == (1 << bits) - 1) return 0xFFFF;
+      return ((code << 16) + 0x8000) >> bits;
+   }
+
+   ForceInline int32_t QuantizeBC6H(float value, int32_t bits)
+   {
+      const int32_t guess = bits >= 15 ? int32_t(value + 0.5f) : int32_t(value * (1 << bits) / 65536.f);
+      int32_t best = 0;
+      float bestError = FLT_MAX;
+      for (int32_t code = std::max(guess - 1, 0); code <= std::min(guess + 1, (1 << bits) - 1); code++)
+      {
+         const float error = std::abs(UnquantizeBC6H(code, bits) - value);
+         if (error >= bestError) continue;
+         bestError = error;
+         best = code;
+      }
+      return best;
+   }
+
+   struct BC6HBlock
+   {
+      int32_t Mode;
+      int32_t Codes[2][3];
+      int32_t Indices[BCBlockLength];
+      float Error;
+   };
+
+   // The error is measured on the half floats as integers, which is about their relative error.
+   float AssignBC6HIndices(const float(*halves)[4], const int32_t(&codes)[2][3], int32_t bits, int32_t* indices)
+   {
+      int32_t palette[16][3];
+      for (int32_t c = 0; c < 3; c++)
+      {
+         const int32_t low = UnquantizeBC6H(codes[0][c], bits), high = UnquantizeBC6H(codes[1][c], bits);
+         for (int32_t i = 0; i < 16; i++) palette[i][c] = (((64 - Weights4[i]) * low + Weights4[i] * high + 32) >> 6) * 31 >> 6;
+      }
+      float total = 0;
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         float bestError = FLT_MAX;
+         for (int32_t j = 0; j < 16; j++)
+         {
+            float error = 0;
+            for (int32_t c = 0; c < 3; c++) error += (palette[j][c] - halves[i][c]) * (palette[j][c] - halves[i][c]);
+            if (error >= bestError) continue;
+            bestError = error;
+            indices[i] = j;
+         }
+         total += bestError;
+      }
+      return total;
+   }
+
+   // Quantize the end points, which are in the interpolated 16-bit space, returns false if the delta overflows.
+   bool EncodeBC6HMode(const float(*halves)[4], const float(&ends)[2][4], int32_t modeIndex, BC6HBlock& block)
+   {
+      const BC6HModeInfo& mode = BC6HModes[modeIndex];
+      block.Mode = modeIndex;
+      for (int32_t end = 0; end < 2; end++)
+      {
+         for (int32_t c = 0; c < 3; c++) block.Codes[end][c] = QuantizeBC6H(ends[end][c], mode.EndPointBits);
+      }
+      block.Error = AssignBC6HIndices(halves, block.Codes, mode.EndPointBits, block.Indices);
+      // Texel 0 is the anchor, whose index drops the highest bit.
+      if (block.Indices[0] >= 8)
+      {
+         std::swap(block.Codes[0], block.Codes[1]);
+         for (int32_t& index : block.Indices) index = 15 - index;
+      }
+      if (!mode.DeltaBits) return true;
+      const int32_t limit = 1 << (mode.DeltaBits - 1);
+      for (int32_t c = 0; c < 3; c++)
+      {
+         const int32_t delta = block.Codes[1][c] - block.Codes[0][c];
+         if (delta < -limit || delta >= limit) return false;
+      }
+      return true;
+   }
+
+   void EncodeBC6HBlock(const float(*halves)[4], EncodeQuality quality, uint8_t* destination)
+   {
+      // Fit in the interpolated space, where the weights are linear.
+      float values[BCBlockLength][4]{};
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         for (int32_t c = 0; c < 3; c++) values[i][c] = halves[i][c] * 64 / 31;
+      }
+      SubsetLine line;
+      SplitSubsets(1, 0, &line);
+      FitLine(values, 3, line);
+      float ends[2][4];
+      GetLineEnds(values, 3, line, 65535.f, ends);
+      const int32_t modeCount = quality == EncodeQuality::Fast ? 1 : 4;
+      const int32_t refinements = quality == EncodeQuality::Fast ? 0 : quality == EncodeQuality::Normal ? 1 : 3;
+      BC6HBlock best{};
+      best.Error = FLT_MAX;
+      for (int32_t modeIndex = 0; modeIndex < modeCount; modeIndex++)
+      {
+         float modeEnds[2][4];
+         std::memcpy(modeEnds, ends, sizeof(ends));
+         BC6HBlock block;
+         if (!EncodeBC6HMode(halves, modeEnds, modeIndex, block)) continue;
+         for (int32_t iteration = 0; iteration < refinements && block.Error > 0; iteration++)
+         {
+            int32_t weights[BCBlockLength];
+            for (int32_t i = 0; i < BCBlockLength; i++) weights[i] = Weights4[block.Indices[i]];
+            if (!SolveEnds(values, line.Members, BCBlockLength, weights, 0, 3, 65535.f, modeEnds)) break;
+            BC6HBlock trial;
+            if (!EncodeBC6HMode(halves, modeEnds, modeIndex, trial) || trial.Error >= block.Error) break;
+            block = trial;
+         }
+         if (block.Error < best.Error) best = block;
+      }
+      // Mode 11 always fits.
+      const BC6HModeInfo& mode = BC6HModes[best.Mode];
+      std::memset(destination, 0, BC6HBlockSize);
+      BlockWriter writer{ destination, 0 };
+      writer.Write(mode.ModeBits, 5);
+      for (int32_t c = 0; c < 3; c++) writer.Write(best.Codes[0][c], 10);
+      for (int32_t c = 0; c < 3; c++)
+      {
+         if (!mode.DeltaBits)
+         {
+            writer.Write(best.Codes[1][c], 10);
+            continue;
+         }
+         writer.Write(uint32_t(best.Codes[1][c] - best.Codes[0][c]), mode.DeltaBits);
+         // The bits above the 10th of the first end point follow, from the highest one.
+         writer.WriteReversed(uint32_t(best.Codes[0][c]) >> 10, mode.EndPointBits - 10);
+      }
+      writer.Write(best.Indices[0], 3);
+      for (int32_t i = 1; i < BCBlockLength; i++) writer.Write(best.Indices[i], 4);
+   }
+}
+
+void Pillow::Graphics::EncodeBC7RGBA(const XMFLOAT4A* blockRGBA, uint8_t* destination, EncodeQuality quality)
+{
+   float texels[BCBlockLength][4];
+   bool opaque = true;
+   for (int32_t i = 0; i < BCBlockLength; i++)
+   {
+      XMFLOAT4A texel;
+      XMStoreFloat4A(&texel, XMVectorSaturate(XMLoadFloat4A(&blockRGBA[i])));
+      // The 8-bit texels the block is measured against.
+      texels[i][0] = std::floor(texel.x * UINT8_MAX + 0.5f);
+      texels[i][1] = std::floor(texel.y * UINT8_MAX + 0.5f);
+      texels[i][2] = std::floor(texel.z * UINT8_MAX + 0.5f);
+      texels[i][3] = std::floor(texel.w * UINT8_MAX + 0.5f);
+      opaque &= texels[i][3] == UINT8_MAX;
+   }
+   BC7Block best;
+   const int32_t refinements = quality == EncodeQuality::Fast ? 0 : quality == EncodeQuality::Normal ? 1 : 3;
+   // Mode 6 suits the smooth blocks of any alpha, and is the only mode of the fast quality.
+   EncodeBC7Combined(texels, 6, 0, refinements, best);
+   if (quality != EncodeQuality::Fast && best.Error > 0)
+   {
+      const bool slow = quality == EncodeQuality::Slow;
+      const int32_t partitionCount = slow ? 8 : 2;
+      BC7Block block;
+      if (opaque)
+      {
+         TryBC7Partitions(texels, 1, partitionCount, refinements, best);
+         TryBC7Partitions(texels, 3, partitionCount, refinements, best);
+         if (slow)
+         {
+            TryBC7Partitions(texels, 0, partitionCount, refinements, best);
+            TryBC7Partitions(texels, 2, partitionCount, refinements, best);
+         }
+      }
+      else
+      {
+         TryBC7Partitions(texels, 7, partitionCount, refinements, best);
+      }
+      // The separate alpha of modes 4 and 5 also helps the opaque blocks, as the rotations decorrelate a channel.
+      for (int32_t rotation = 0; rotation < (slow ? 4 : 1); rotation++)
+      {
+         for (int32_t indexSelection = 0; indexSelection < (slow ? 2 : 1); indexSelection++)
+         {
+            EncodeBC7Separate(texels, 4, rotation, indexSelection, refinements, block);
+            if (block.Error < best.Error) best = block;
+         }
+         EncodeBC7Separate(texels, 5, rotation, 0, refinements, block);
+         if (block.Error < best.Error) best = block;
+      }
+   }
+   WriteBC7Block(best, destination);
+}
+
+void Pillow::Graphics::EncodeBC6HRGB(const XMFLOAT4A* blockRGB, uint8_t* destination, EncodeQuality quality)
+{
+   float halves[BCBlockLength][4];
+   for (int32_t i = 0; i < BCBlockLength; i++)
+   {
+      const float* texel = &blockRGB[i].x;
+      for (int32_t c = 0; c < 3; c++)
+      {
+         // The comparison also turns the NaNs into 0.
+         const float value = texel[c] > 0 ? std::min(texel[c], 65504.f) : 0;
+         halves[i][c] = float(XMConvertFloatToHalf(value));
+      }
+      halves[i][3] = 0;
+   }
+   EncodeBC6HBlock(halves, quality, destination);
+}
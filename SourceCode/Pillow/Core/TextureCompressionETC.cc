@@ -0,0 +1,552 @@
+#include "TextureCompression.h"
+#include <algorithm>
+#include <climits>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   //                         ETC2                         //
+   // A block is a big-endian 64-bit word, whose texels are indexed in column-major order: x * 4 + y.
+   // The individual and differential modes split the block in two halves, side by side or on top of each other(flipped),
+   // and every texel adds a modifier of the table of its half to the base color of the half.
+   // A differential block whose second base color overflows in red, green or blue is a T, H or planar block instead.
+   enum class ETC2Mode : uint8_t
+   {
+      Individual,
+      Differential,
+      T,
+      H,
+      Planar
+   };
+
+   // The modifiers a and b of a table, the codes 0 to 3 select +a, +b, -a and -b.
+   const int32_t ETC1Modifiers[8][2]
+   {
+      { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+   };
+
+   // The distances of the T and H modes.
+   const int32_t ETC2Distances[8]{ 3, 6, 11, 16, 23, 32, 41, 64 };
+
+   // The modifiers of EAC, multiplied by the multiplier of the block.
+   const int32_t EACModifiers[16][8]
+   {
+      { -3, -6, -9, -15, 2, 5, 8, 14 },
+      { -3, -7, -10, -13, 2, 6, 9, 12 },
+      { -2, -5, -8, -13, 1, 4, 7, 12 },
+      { -2, -4, -6, -13, 1, 3, 5, 12 },
+      { -3, -6, -8, -12, 2, 5, 7, 11 },
+      { -3, -7, -9, -11, 2, 6, 8, 10 },
+      { -4, -7, -8, -11, 3, 6, 7, 10 },
+      { -3, -5, -8, -11, 2, 4, 7, 10 },
+      { -2, -6, -8, -10, 1, 5, 7, 9 },
+      { -2, -5, -8, -10, 1, 4, 7, 9 },
+      { -2, -4, -8, -10, 1, 3, 7, 9 },
+      { -2, -5, -7, -10, 1, 4, 6, 9 },
+      { -3, -4, -7, -10, 2, 3, 6, 9 },
+      { -1, -2, -3, -10, 0, 1, 2, 9 },
+      { -4, -6, -8, -9, 3, 5, 7, 8 },
+      { -3, -5, -7, -9, 2, 4, 6, 8 },
+   };
+
+   ForceInline int32_t Clamp255(int32_t value)
+   {
+      return std::clamp(value, 0, 255);
+   }
+
+   ForceInline int32_t Expand4(int32_t value)
+   {
+      return value * 17;
+   }
+
+   ForceInline int32_t Expand5(int32_t value)
+   {
+      return value << 3 | value >> 2;
+   }
+
+   ForceInline int32_t Expand6(int32_t value)
+   {
+      return value << 2 | value >> 4;
+   }
+
+   ForceInline int32_t Expand7(int32_t value)
+   {
+      return value << 1 | value >> 6;
+   }
+
+   ForceInline int32_t GetBits(uint64_t block, int32_t first, int32_t count)
+   {
+      return int32_t(block >> first) & ((1 << count) - 1);
+   }
+
+   ForceInline uint64_t LoadBigEndian(const uint8_t* block)
+   {
+      uint64_t result = 0;
+      for (int32_t i = 0; i < 8; i++) result = result << 8 | block[i];
+      return result;
+   }
+
+   ForceInline void StoreBigEndian(uint64_t block, uint8_t* destination)
+   {
+      for (int32_t i = 7; i >= 0; i--, block >>= 8) destination[i] = uint8_t(block);
+   }
+
+   // The column-major index of a texel in row-major order.
+   ForceInline int32_t GetETCIndex(int32_t texel)
+   {
+      return (texel % 4) * 4 + texel / 4;
+   }
+
+   ForceInline int32_t GetHalf(int32_t texel, bool bFlip)
+   {
+      return bFlip ? texel / 4 >= 2 : texel % 4 >= 2;
+   }
+
+   ETC2Mode GetETC2Mode(uint64_t block)
+   {
+      if (!GetBits(block, 33, 1)) return ETC2Mode::Individual;
+      // The 5-bit base plus the signed 3-bit delta, of red, green and blue.
+      auto Overflows = [&](int32_t first)
+         {
+            const int32_t value = GetBits(block, first + 3, 5) + (GetBits(block, first, 3) ^ 4) - 4;
+            return value < 0 || value > 31;
+         };
+      if (Overflows(56)) return ETC2Mode::T;
+      if (Overflows(48)) return ETC2Mode::H;
+      if (Overflows(40)) return ETC2Mode::Planar;
+      return ETC2Mode::Differential;
+   }
+
+   // The squared error of the best codes of the texels of a half for a base color and a table.
+   int32_t FitHalf(const int32_t(*texels)[3], const int32_t* members, const int32_t* base, int32_t table, int32_t bestError, int32_t* codes)
+   {
+      int32_t error = 0;
+      for (int32_t i = 0; i < 8 && error < bestError; i++)
+      {
+         const int32_t* texel = texels[members[i]];
+         int32_t best = INT_MAX;
+         for (int32_t code = 0; code < 4; code++)
+         {
+            const int32_t modifier = (code & 2 ? -1 : 1) * ETC1Modifiers[table][code & 1];
+            int32_t texelError = 0;
+            for (int32_t c = 0; c < 3; c++)
+            {
+               const int32_t difference = Clamp255(base[c] + modifier) - texel[c];
+               texelError += difference * difference;
+            }
+            if (texelError < best)
+            {
+               best = texelError;
+               codes[i] = code;
+            }
+         }
+         error += best;
+      }
+      return error;
+   }
+
+   struct HalfFit
+   {
+      int32_t Table;
+      int32_t Codes[8];
+      int32_t Error;
+   };
+
+   HalfFit FitHalfTables(const int32_t(*texels)[3], const int32_t* members, const int32_t* base)
+   {
+      HalfFit best{ 0, {}, INT_MAX };
+      int32_t codes[8];
+      for (int32_t table = 0; table < 8; table++)
+      {
+         const int32_t error = FitHalf(texels, members, base, table, best.Error, codes);
+         if (error >= best.Error) continue;
+         best.Table = table;
+         best.Error = error;
+         std::copy(codes, codes + 8, best.Codes);
+      }
+      return best;
+   }
+
+   // The base color the texels of a half would have without their modifiers.
+   void GetHalfTarget(const int32_t(*texels)[3], const int32_t* members, const HalfFit* fit, float* target)
+   {
+      for (int32_t c = 0; c < 3; c++)
+      {
+         float sum = 0;
+         for (int32_t i = 0; i < 8; i++)
+         {
+            const int32_t code = fit ? fit->Codes[i] : 0;
+            const int32_t modifier = fit ? (code & 2 ? -1 : 1) * ETC1Modifiers[fit->Table][code & 1] : 0;
+            sum += float(texels[members[i]][c] - modifier);
+         }
+         target[c] = sum / 8;
+      }
+   }
+
+   struct ETC2Block
+   {
+      uint64_t Bits;
+      int32_t Error;
+   };
+
+   // The individual or differential mode for the target base colors of the halves.
+   ETC2Block EncodeHalves(const int32_t(*texels)[3], const int32_t(&members)[2][8], const float(&targets)[2][3], bool bDifferential, bool bFlip, HalfFit(&fits)[2])
+   {
+      int32_t codes[2][3], bases[2][3];
+      for (int32_t c = 0; c < 3; c++)
+      {
+         if (bDifferential)
+         {
+            codes[0][c] = std::clamp(int32_t(targets[0][c] * 31 / 255 + 0.5f), 0, 31);
+            const int32_t second = std::clamp(int32_t(targets[1][c] * 31 / 255 + 0.5f), 0, 31);
+            // The delta is 3 bits, [-4, 3].
+            codes[1][c] = codes[0][c] + std::clamp(second - codes[0][c], -4, 3);
+            bases[0][c] = Expand5(codes[0][c]);
+            bases[1][c] = Expand5(codes[1][c]);
+         }
+         else
+         {
+            for (int32_t half = 0; half < 2; half++)
+            {
+               codes[half][c] = std::clamp(int32_t(targets[half][c] * 15 / 255 + 0.5f), 0, 15);
+               bases[half][c] = Expand4(codes[half][c]);
+            }
+         }
+      }
+      fits[0] = FitHalfTables(texels, members[0], bases[0]);
+      fits[1] = FitHalfTables(texels, members[1], bases[1]);
+      uint64_t bits = uint64_t(fits[0].Table) << 37 | uint64_t(fits[1].Table) << 34 | uint64_t(bDifferential) << 33 | uint64_t(bFlip) << 32;
+      for (int32_t c = 0; c < 3; c++)
+      {
+         const int32_t first = 56 - c * 8;
+         if (bDifferential) bits |= uint64_t(codes[0][c]) << (first + 3) | uint64_t((codes[1][c] - codes[0][c]) & 7) << first;
+         else bits |= uint64_t(codes[0][c]) << (first + 4) | uint64_t(codes[1][c]) << first;
+      }
+      for (int32_t half = 0; half < 2; half++)
+      {
+         for (int32_t i = 0; i < 8; i++)
+         {
+            const int32_t index = GetETCIndex(members[half][i]);
+            bits |= uint64_t(fits[half].Codes[i] >> 1) << (16 + index) | uint64_t(fits[half].Codes[i] & 1) << index;
+         }
+      }
+      return ETC2Block{ bits, fits[0].Error + fits[1].Error };
+   }
+
+   // Fit the base colors to the averages of the halves, then to the texels without the modifiers they got.
+   ETC2Block EncodeSplit(const int32_t(*texels)[3], bool bDifferential, bool bFlip)
+   {
+      int32_t members[2][8];
+      int32_t counts[2]{};
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const int32_t half = GetHalf(i, bFlip);
+         members[half][counts[half]++] = i;
+      }
+      float targets[2][3];
+      GetHalfTarget(texels, members[0], nullptr, targets[0]);
+      GetHalfTarget(texels, members[1], nullptr, targets[1]);
+      HalfFit fits[2];
+      ETC2Block best = EncodeHalves(texels, members, targets, bDifferential, bFlip, fits);
+      if (best.Error == 0) return best;
+      GetHalfTarget(texels, members[0], &fits[0], targets[0]);
+      GetHalfTarget(texels, members[1], &fits[1], targets[1]);
+      const ETC2Block refined = EncodeHalves(texels, members, targets, bDifferential, bFlip, fits);
+      return refined.Error < best.Error ? refined : best;
+   }
+
+   // The planar mode interpolates the colors O, H and V at the texels (0, 0), (4, 0) and (0, 4).
+   ETC2Block EncodePlanar(const int32_t(*texels)[3])
+   {
+      const int32_t maxCodes[3]{ 63, 127, 63 };
+      int32_t codes[3][3]; // [O, H, V][channel]
+      int32_t error = 0;
+      for (int32_t c = 0; c < 3; c++)
+      {
+         // The least squares plane of the channel, x and y are centered at 1.5.
+         float mean = 0, slopeX = 0, slopeY = 0;
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            mean += float(texels[i][c]);
+            slopeX += (float(i % 4) - 1.5f) * float(texels[i][c]);
+            slopeY += (float(i / 4) - 1.5f) * float(texels[i][c]);
+         }
+         mean /= BCBlockLength;
+         slopeX /= 20;
+         slopeY /= 20;
+         const float origin = mean - 1.5f * (slopeX + slopeY);
+         const float ideals[3]{ origin, origin + 4 * slopeX, origin + 4 * slopeY };
+         // Round every color down or up, whichever combination fits best.
+         int32_t floors[3];
+         for (int32_t k = 0; k < 3; k++) floors[k] = std::clamp(int32_t(std::floor(ideals[k] * maxCodes[c] / 255)), 0, maxCodes[c] - 1);
+         int32_t best = INT_MAX;
+         for (int32_t combination = 0; combination < 8; combination++)
+         {
+            int32_t values[3], candidate[3];
+            for (int32_t k = 0; k < 3; k++)
+            {
+               candidate[k] = floors[k] + (combination >> k & 1);
+               values[k] = c == 1 ? Expand7(candidate[k]) : Expand6(candidate[k]);
+            }
+            int32_t channelError = 0;
+            for (int32_t i = 0; i < BCBlockLength; i++)
+            {
+               const int32_t x = i % 4, y = i / 4;
+               const int32_t difference = Clamp255((x * (values[1] - values[0]) + y * (values[2] - values[0]) + 4 * values[0] + 2) >> 2) - texels[i][c];
+               channelError += difference * difference;
+            }
+            if (channelError >= best) continue;
+            best = channelError;
+            for (int32_t k = 0; k < 3; k++) codes[k][c] = candidate[k];
+         }
+         error += best;
+      }
+      const int32_t(&o)[3] = codes[0], (&h)[3] = codes[1], (&v)[3] = codes[2];
+      uint64_t bits = uint64_t(o[0]) << 57 | uint64_t(o[1] >> 6) << 56 | uint64_t(o[1] & 63) << 49 | uint64_t(o[2] >> 5) << 48 |
+         uint64_t(o[2] >> 3 & 3) << 43 | uint64_t(o[2] & 7) << 39 | uint64_t(h[0] >> 1) << 34 | uint64_t(1) << 33 | uint64_t(h[0] & 1) << 32 |
+         uint64_t(h[1]) << 25 | uint64_t(h[2]) << 19 | uint64_t(v[0]) << 13 | uint64_t(v[1]) << 6 | uint64_t(v[2]);
+      // The unused bits 63, 55, 47 to 45 and 42 make red and green valid differential colors, and blue overflow.
+      const int32_t freeBits[6]{ 63, 55, 47, 46, 45, 42 };
+      for (int32_t combination = 0; combination < 64; combination++)
+      {
+         uint64_t candidate = bits;
+         for (int32_t k = 0; k < 6; k++) candidate |= uint64_t(combination >> k & 1) << freeBits[k];
+         if (GetETC2Mode(candidate) == ETC2Mode::Planar) return ETC2Block{ candidate, error };
+      }
+      return ETC2Block{ 0, INT_MAX };
+   }
+
+   //                         EAC                         //
+   // A value is base + modifier * multiplier. R11 scales that by 8 around the center of the base, in 11 bits,
+   // and a multiplier of 0 stands for 1/8.
+   struct EACPrecision
+   {
+      int32_t Scale;
+      int32_t Offset;
+      int32_t Max;
+   };
+
+   const EACPrecision EACAlphaPrecision{ 1, 0, 255 };
+   const EACPrecision EACR11Precision{ 8, 4, 2047 };
+
+   ForceInline int32_t GetEACStep(const EACPrecision& precision, int32_t multiplier)
+   {
+      return multiplier || precision.Scale == 1 ? multiplier * precision.Scale : 1;
+   }
+
+   // values are in [0, precision.Max], in row-major order.
+   uint64_t EncodeEAC(const int32_t* values, const EACPrecision& precision)
+   {
+      int32_t minimum = INT_MAX, maximum = 0;
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         minimum = std::min(minimum, values[i]);
+         maximum = std::max(maximum, values[i]);
+      }
+      int32_t bestError = INT_MAX, bestBase = 0, bestMultiplier = 0, bestTable = 0;
+      for (int32_t table = 0; table < 16 && bestError; table++)
+      {
+         const int32_t low = EACModifiers[table][3], high = EACModifiers[table][7];
+         // The multipliers whose span of modifiers is the closest to the range of the values.
+         const int32_t ideal = (maximum - minimum) / (precision.Scale * (high - low));
+         // The alpha multiplier of 0 flattens the block, which a multiplier of 1 does as exactly.
+         const int32_t lowest = precision.Scale == 1 ? 1 : 0;
+         for (int32_t multiplier = std::max(ideal, lowest); multiplier <= std::min(ideal + 1, 15) && bestError; multiplier++)
+         {
+            const int32_t step = GetEACStep(precision, multiplier);
+            const float center = (float(minimum + maximum) - float(step * (high + low))) / 2;
+            const int32_t middle = int32_t(std::floor((center - precision.Offset) / precision.Scale + 0.5f));
+            for (int32_t base = std::max(middle - 1, 0); base <= std::min(middle + 1, 255); base++)
+            {
+               int32_t palette[8];
+               for (int32_t k = 0; k < 8; k++) palette[k] = std::clamp(base * precision.Scale + precision.Offset + EACModifiers[table][k] * step, 0, precision.Max);
+               int32_t error = 0;
+               for (int32_t i = 0; i < BCBlockLength && error < bestError; i++)
+               {
+                  int32_t best = INT_MAX;
+                  for (int32_t k = 0; k < 8; k++) best = std::min(best, (palette[k] - values[i]) * (palette[k] - values[i]));
+                  error += best;
+               }
+               if (error >= bestError) continue;
+               bestError = error;
+               bestBase = base;
+               bestMultiplier = multiplier;
+               bestTable = table;
+            }
+         }
+      }
+      const int32_t step = GetEACStep(precision, bestMultiplier);
+      uint64_t bits = uint64_t(bestBase) << 56 | uint64_t(bestMultiplier) << 52 | uint64_t(bestTable) << 48;
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         int32_t best = INT_MAX, code = 0;
+         for (int32_t k = 0; k < 8; k++)
+         {
+            const int32_t difference = std::clamp(bestBase * precision.Scale + precision.Offset + EACModifiers[bestTable][k] * step, 0, precision.Max) - values[i];
+            if (difference * difference >= best) continue;
+            best = difference * difference;
+            code = k;
+         }
+         bits |= uint64_t(code) << (45 - 3 * GetETCIndex(i));
+      }
+      return bits;
+   }
+
+   void DecodeEAC(const uint8_t* block, const EACPrecision& precision, float* destination)
+   {
+      const uint64_t bits = LoadBigEndian(block);
+      const int32_t base = GetBits(bits, 56, 8), multiplier = GetBits(bits, 52, 4), table = GetBits(bits, 48, 4);
+      const int32_t step = GetEACStep(precision, multiplier);
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const int32_t code = GetBits(bits, 45 - 3 * GetETCIndex(i), 3);
+         const int32_t value = std::clamp(base * precision.Scale + precision.Offset + EACModifiers[table][code] * step, 0, precision.Max);
+         destination[i] = float(value) / float(precision.Max);
+      }
+   }
+}
+
+void Pillow::Graphics::EncodeETC2RGB(const XMFLOAT4A* blockRGB, uint8_t* destination)
+{
+   int32_t texels[BCBlockLength][3];
+   for (int32_t i = 0; i < BCBlockLength; i++)
+   {
+      texels[i][0] = Clamp255(int32_t(blockRGB[i].x * 255 + 0.5f));
+      texels[i][1] = Clamp255(int32_t(blockRGB[i].y * 255 + 0.5f));
+      texels[i][2] = Clamp255(int32_t(blockRGB[i].z * 255 + 0.5f));
+   }
+   // The planar mode suits gradients, the split modes suit the rest: differential for close halves, individual for distinct ones.
+   ETC2Block best = EncodePlanar(texels);
+   for (int32_t mode = 0; mode < 4 && best.Error; mode++)
+   {
+      const ETC2Block candidate = EncodeSplit(texels, mode & 1, mode & 2);
+      if (candidate.Error < best.Error) best = candidate;
+   }
+   StoreBigEndian(best.Bits, destination);
+}
+
+void Pillow::Graphics::EncodeEACAlpha(const float* block, uint8_t* destination)
+{
+   int32_t values[BCBlockLength];
+   for (int32_t i = 0; i < BCBlockLength; i++) values[i] = Clamp255(int32_t(block[i] * 255 + 0.5f));
+   StoreBigEndian(EncodeEAC(values, EACAlphaPrecision), destination);
+}
+
+void Pillow::Graphics::EncodeEACR11(const float* block, uint8_t* destination)
+{
+   int32_t values[BCBlockLength];
+   for (int32_t i = 0; i < BCBlockLength; i++) values[i] = std::clamp(int32_t(block[i] * 2047 + 0.5f), 0, 2047);
+   StoreBigEndian(EncodeEAC(values, EACR11Precision), destination);
+}
+
+void Pillow::Graphics::DecodeETC2RGB(const uint8_t* block, XMFLOAT4A* destination)
+{
+   const uint64_t bits = LoadBigEndian(block);
+   const ETC2Mode mode = GetETC2Mode(bits);
+   int32_t colors[BCBlockLength][3];
+   if (mode == ETC2Mode::Planar)
+   {
+      const int32_t o[3]{ Expand6(GetBits(bits, 57, 6)), Expand7(GetBits(bits, 56, 1) << 6 | GetBits(bits, 49, 6)),
+         Expand6(GetBits(bits, 48, 1) << 5 | GetBits(bits, 43, 2) << 3 | GetBits(bits, 39, 3)) };
+      const int32_t h[3]{ Expand6(GetBits(bits, 34, 5) << 1 | GetBits(bits, 32, 1)), Expand7(GetBits(bits, 25, 7)), Expand6(GetBits(bits, 19, 6)) };
+      const int32_t v[3]{ Expand6(GetBits(bits, 13, 6)), Expand7(GetBits(bits, 6, 7)), Expand6(GetBits(bits, 0, 6)) };
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const int32_t x = i % 4, y = i / 4;
+         for (int32_t c = 0; c < 3; c++) colors[i][c] = Clamp255((x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2);
+      }
+   }
+   else if (mode == ETC2Mode::T || mode == ETC2Mode::H)
+   {
+      int32_t first[3], second[3], distance;
+      if (mode == ETC2Mode::T)
+      {
+         first[0] = GetBits(bits, 59, 2) << 2 | GetBits(bits, 56, 2);
+         first[1] = GetBits(bits, 52, 4);
+         first[2] = GetBits(bits, 48, 4);
+         for (int32_t c = 0; c < 3; c++) second[c] = GetBits(bits, 44 - c * 4, 4);
+         distance = ETC2Distances[GetBits(bits, 34, 2) << 1 | GetBits(bits, 32, 1)];
+      }
+      else
+      {
+         first[0] = GetBits(bits, 59, 4);
+         first[1] = GetBits(bits, 56, 3) << 1 | GetBits(bits, 52, 1);
+         first[2] = GetBits(bits, 51, 1) << 3 | GetBits(bits, 47, 3);
+         for (int32_t c = 0; c < 3; c++) second[c] = GetBits(bits, 43 - c * 4, 4);
+         // The order of the colors is the lowest bit of the distance.
+         const int32_t order = (first[0] << 8 | first[1] << 4 | first[2]) >= (second[0] << 8 | second[1] << 4 | second[2]);
+         distance = ETC2Distances[GetBits(bits, 34, 1) << 2 | GetBits(bits, 32, 1) << 1 | order];
+      }
+      int32_t palette[4][3];
+      for (int32_t c = 0; c < 3; c++)
+      {
+         first[c] = Expand4(first[c]);
+         second[c] = Expand4(second[c]);
+         if (mode == ETC2Mode::T)
+         {
+            palette[0][c] = first[c];
+            palette[1][c] = Clamp255(second[c] + distance);
+            palette[2][c] = second[c];
+            palette[3][c] = Clamp255(second[c] - distance);
+         }
+         else
+         {
+            palette[0][c] = Clamp255(first[c] + distance);
+            palette[1][c] = Clamp255(first[c] - distance);
+            palette[2][c] = Clamp255(second[c] + distance);
+            palette[3][c] = Clamp255(second[c] - distance);
+         }
+      }
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const int32_t index = GetETCIndex(i);
+         const int32_t code = GetBits(bits, 16 + index, 1) << 1 | GetBits(bits, index, 1);
+         for (int32_t c = 0; c < 3; c++) colors[i][c] = palette[code][c];
+      }
+   }
+   else
+   {
+      const bool bFlip = GetBits(bits, 32, 1);
+      const int32_t tables[2]{ GetBits(bits, 37, 3), GetBits(bits, 34, 3) };
+      int32_t bases[2][3];
+      for (int32_t c = 0; c < 3; c++)
+      {
+         const int32_t first = 56 - c * 8;
+         if (mode == ETC2Mode::Differential)
+         {
+            const int32_t base = GetBits(bits, first + 3, 5);
+            bases[0][c] = Expand5(base);
+            bases[1][c] = Expand5(base + (GetBits(bits, first, 3) ^ 4) - 4);
+         }
+         else
+         {
+            bases[0][c] = Expand4(GetBits(bits, first + 4, 4));
+            bases[1][c] = Expand4(GetBits(bits, first, 4));
+         }
+      }
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const int32_t half = GetHalf(i, bFlip);
+         const int32_t index = GetETCIndex(i);
+         const int32_t code = GetBits(bits, 16 + index, 1) << 1 | GetBits(bits, index, 1);
+         const int32_t modifier = (code & 2 ? -1 : 1) * ETC1Modifiers[tables[half]][code & 1];
+         for (int32_t c = 0; c < 3; c++) colors[i][c] = Clamp255(bases[half][c] + modifier);
+      }
+   }
+   for (int32_t i = 0; i < BCBlockLength; i++)
+   {
+      destination[i] = XMFLOAT4A(colors[i][0] / 255.f, colors[i][1] / 255.f, colors[i][2] / 255.f, 1);
+   }
+}
+
+void Pillow::Graphics::DecodeEACAlpha(const uint8_t* block, float* destination)
+{
+   DecodeEAC(block, EACAlphaPrecision, destination);
+}
+
+void Pillow::Graphics::DecodeEACR11(const uint8_t* block, float* destination)
+{
+   DecodeEAC(block, EACR11Precision, destination);
+}
@@ -0,0 +1,604 @@
+#include "TextureCompression.h"
+#include <algorithm>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#define PILLOW_AVX2_LANES
+#endif
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+using namespace DirectX;
+
+// Structure-of-arrays block encoders.
+// Every lane of a SIMD register handles a different block, so the Newton iterations and the index searches
+// run at full width instead of wasting the lanes on 3 color channels.
+// Each lane executes exactly the same float operations in the same order as the single block encoders,
+// branches are turned into masks, and a lane leaving a loop early just stops recording its results.
+namespace
+{
+   const int32_t MaxLaneCount = 8;
+
+   // 4 lanes on top of DirectXMath, which maps to SSE2 on x64 and NEON on arm64.
+   struct Lanes4
+   {
+      static constexpr int32_t Count = 4;
+      typedef XMVECTOR V;
+
+      static ForceInline V Load(const float* p) { return XMLoadFloat4A((const XMFLOAT4A*)p); }
+      static ForceInline void Store(float* p, V v) { XMStoreFloat4A((XMFLOAT4A*)p, v); }
+      static ForceInline V Set(float value) { return XMVectorReplicate(value); }
+      static ForceInline V Zero() { return XMVectorZero(); }
+      static ForceInline V Add(V a, V b) { return XMVectorAdd(a, b); }
+      static ForceInline V Sub(V a, V b) { return XMVectorSubtract(a, b); }
+      static ForceInline V Mul(V a, V b) { return XMVectorMultiply(a, b); }
+      static ForceInline V Div(V a, V b) { return XMVectorDivide(a, b); }
+      static ForceInline V Min(V a, V b) { return XMVectorMin(a, b); }
+      static ForceInline V Max(V a, V b) { return XMVectorMax(a, b); }
+      // Truncation after adding 0.5, which is how the single block encoders round the non-negative values.
+      static ForceInline V Round(V a)
+      {
+         a = XMVectorAdd(a, XMVectorReplicate(0.5f));
+#if defined(_XM_SSE_INTRINSICS_)
+         return _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+#elif defined(_XM_ARM_NEON_INTRINSICS_)
+         return vcvtq_f32_s32(vcvtq_s32_f32(a));
+#else
+         return XMVectorTruncate(a);
+#endif
+      }
+      static ForceInline V Saturate(V a) { return XMVectorSaturate(a); }
+      static ForceInline V Less(V a, V b) { return XMVectorLess(a, b); }
+      static ForceInline V LessOrEqual(V a, V b) { return XMVectorLessOrEqual(a, b); }
+      static ForceInline V Greater(V a, V b) { return XMVectorGreater(a, b); }
+      static ForceInline V GreaterOrEqual(V a, V b) { return XMVectorGreaterOrEqual(a, b); }
+      static ForceInline V Equal(V a, V b) { return XMVectorEqual(a, b); }
+      static ForceInline V And(V a, V b) { return XMVectorAndInt(a, b); }
+      static ForceInline V Or(V a, V b) { return XMVectorOrInt(a, b); }
+      static ForceInline V AndNot(V a, V b) { return XMVectorAndCInt(a, b); } // a & ~b
+      // Pick b where the mask is set, otherwise a.
+      static ForceInline V Select(V a, V b, V mask) { return XMVectorSelect(a, b, mask); }
+      static ForceInline bool Any(V mask) { return !XMVector4EqualInt(mask, XMVectorFalseInt()); }
+   };
+
+#if defined(PILLOW_AVX2_LANES)
+   // 8 lanes with AVX2. FMA is not used, so the results match the SSE2 build of the single block encoders.
+   struct Lanes8
+   {
+      static constexpr int32_t Count = 8;
+      typedef __m256 V;
+
+      static ForceInline V Load(const float* p) { return _mm256_load_ps(p); }
+      static ForceInline void Store(float* p, V v) { _mm256_store_ps(p, v); }
+      static ForceInline V Set(float value) { return _mm256_set1_ps(value); }
+      static ForceInline V Zero() { return _mm256_setzero_ps(); }
+      static ForceInline V Add(V a, V b) { return _mm256_add_ps(a, b); }
+      static ForceInline V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+      static ForceInline V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+      static ForceInline V Div(V a, V b) { return _mm256_div_ps(a, b); }
+      static ForceInline V Min(V a, V b) { return _mm256_min_ps(a, b); }
+      static ForceInline V Max(V a, V b) { return _mm256_max_ps(a, b); }
+      static ForceInline V Round(V a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(_mm256_add_ps(a, Set(0.5f)))); }
+      static ForceInline V Saturate(V a) { return _mm256_min_ps(_mm256_max_ps(a, Zero()), Set(1)); }
+      static ForceInline V Less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+      static ForceInline V LessOrEqual(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+      static ForceInline V Greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+      static ForceInline V GreaterOrEqual(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+      static ForceInline V Equal(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+      static ForceInline V And(V a, V b) { return _mm256_and_ps(a, b); }
+      static ForceInline V Or(V a, V b) { return _mm256_or_ps(a, b); }
+      static ForceInline V AndNot(V a, V b) { return _mm256_andnot_ps(b, a); }
+      static ForceInline V Select(V a, V b, V mask) { return _mm256_blendv_ps(a, b, mask); }
+      static ForceInline bool Any(V mask) { return _mm256_movemask_ps(mask) != 0; }
+   };
+#endif
+
+   bool DetectAVX2()
+   {
+#if defined(PILLOW_AVX2_LANES)
+      int32_t info[4];
+      __cpuid(info, 0);
+      if (info[0] < 7) return false;
+      __cpuid(info, 1);
+      const bool osxsave = info[2] & (1 << 27);
+      const bool avx = info[2] & (1 << 28);
+      // The OS must save the YMM registers on context switches.
+      if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+      __cpuidex(info, 7, 0);
+      return info[1] & (1 << 5);
+#else
+      return false;
+#endif
+   }
+
+   const bool HasAVX2 = DetectAVX2();
+
+   // Texels of a batch, indexed by [texel][channel][lane].
+   struct alignas(32) RGBLanes
+   {
+      float texels[BCBlockLength][3][MaxLaneCount];
+   };
+
+   struct alignas(32) AlphaLanes
+   {
+      float texels[BCBlockLength][MaxLaneCount];
+   };
+
+   struct alignas(32) LaneValues
+   {
+      float values[MaxLaneCount];
+   };
+
+   // The same summation order as XMVector3Dot: (x + y) + z.
+   template<class L>
+   ForceInline typename L::V Dot3(const typename L::V* a, const typename L::V* b)
+   {
+      return L::Add(L::Add(L::Mul(a[0], b[0]), L::Mul(a[1], b[1])), L::Mul(a[2], b[2]));
+   }
+
+   // Floyd Steinberg error diffusion inside a 4x4 block, identical to the single block encoder.
+   template<class L>
+   ForceInline void DiffuseError(typename L::V (*errors)[3], const typename L::V* diff, int32_t i)
+   {
+      for (int32_t k = 0; k < 3; k++)
+      {
+         if (3 != (i & 3)) errors[i + 1][k] = L::Add(L::Mul(diff[k], L::Set(7.f / 16.f)), errors[i + 1][k]);
+         if (i < 12)
+         {
+            errors[i + 4][k] = L::Add(L::Mul(diff[k], L::Set(5.f / 16.f)), errors[i + 4][k]);
+            if (i & 3) errors[i + 3][k] = L::Add(L::Mul(diff[k], L::Set(3.f / 16.f)), errors[i + 3][k]);
+            if (3 != (i & 3)) errors[i + 5][k] = L::Add(L::Mul(diff[k], L::Set(1.f / 16.f)), errors[i + 5][k]);
+         }
+      }
+   }
+
+   template<class L>
+   void OptimizeRGBLanes(typename L::V* color0, typename L::V* color1, const typename L::V (*block)[3], const float* luminance, int32_t iterations)
+   {
+      typedef typename L::V V;
+      const float fSteps = 3;
+      constexpr float fEpsilon = (0.25f / 64.f) * (0.25f / 64.f);
+      // Lanes finish at different points. A finishing lane records its end points and clears its active bit.
+      V active = L::Equal(L::Zero(), L::Zero());
+      auto Finish = [&](V mask, const V* c0, const V* c1)
+         {
+            mask = L::And(mask, active);
+            for (int32_t k = 0; k < 3; k++)
+            {
+               color0[k] = L::Select(color0[k], c0[k], mask);
+               color1[k] = L::Select(color1[k], c1[k], mask);
+            }
+            active = L::AndNot(active, mask);
+         };
+      // Find Min and Max points, as starting point
+      V c0[3], c1[3];
+      for (int32_t k = 0; k < 3; k++)
+      {
+         c0[k] = L::Set(luminance[k]);
+         c1[k] = L::Zero();
+         color0[k] = color1[k] = L::Zero();
+      }
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         for (int32_t k = 0; k < 3; k++)
+         {
+            c0[k] = L::Select(c0[k], block[i][k], L::Less(block[i][k], c0[k]));
+            c1[k] = L::Select(c1[k], block[i][k], L::Greater(block[i][k], c1[k]));
+         }
+      }
+      // Diagonal axis
+      V AB[3];
+      for (int32_t k = 0; k < 3; k++) AB[k] = L::Sub(c1[k], c0[k]);
+      const V fAB = Dot3<L>(AB, AB);
+      // Single color block.. no need to root-find
+      Finish(L::Less(fAB, L::Set(FLT_MIN)), c0, c1);
+      if (!L::Any(active)) return;
+      // Try all four axis directions, to determine which diagonal best fits data
+      const V invAB = L::Div(L::Set(1.f), fAB);
+      V dir[3], mid[3];
+      for (int32_t k = 0; k < 3; k++)
+      {
+         dir[k] = L::Mul(AB[k], invAB);
+         mid[k] = L::Add(L::Mul(L::Sub(c1[k], c0[k]), L::Set(0.5f)), c0[k]);
+      }
+      V fDir[4]{ L::Zero(), L::Zero(), L::Zero(), L::Zero() };
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         V pt[3];
+         for (int32_t k = 0; k < 3; k++) pt[k] = L::Mul(L::Sub(block[i][k], mid[k]), dir[k]);
+         const V xy = L::Add(pt[0], pt[1]);
+         const V x_y = L::Sub(pt[0], pt[1]);
+         const V f[4]{ L::Add(xy, pt[2]), L::Sub(xy, pt[2]), L::Add(x_y, pt[2]), L::Sub(x_y, pt[2]) };
+         for (int32_t j = 0; j < 4; j++) fDir[j] = L::Add(L::Mul(f[j], f[j]), fDir[j]);
+      }
+      V fDirMax = fDir[0];
+      V iDirMax = L::Zero();
+      for (int32_t j = 1; j < 4; j++)
+      {
+         const V greater = L::Greater(fDir[j], fDirMax);
+         fDirMax = L::Select(fDirMax, fDir[j], greater);
+         iDirMax = L::Select(iDirMax, L::Set(float(j)), greater);
+      }
+      const V swapG = L::Or(L::Equal(iDirMax, L::Set(2)), L::Equal(iDirMax, L::Set(3)));
+      const V swapB = L::Or(L::Equal(iDirMax, L::Set(1)), L::Equal(iDirMax, L::Set(3)));
+      V temp = c0[1];
+      c0[1] = L::Select(c0[1], c1[1], swapG);
+      c1[1] = L::Select(c1[1], temp, swapG);
+      temp = c0[2];
+      c0[2] = L::Select(c0[2], c1[2], swapB);
+      c1[2] = L::Select(c1[2], temp, swapB);
+      // Two color block.. no need to root-find
+      Finish(L::Less(fAB, L::Set(1.f / 4096.f)), c0, c1);
+      if (!L::Any(active)) return;
+      // Use Newton's Method to find local minima of sum-of-squares error.
+      for (int32_t iteration = 0; iteration < iterations && L::Any(active); iteration++)
+      {
+         // Calculate color direction
+         for (int32_t k = 0; k < 3; k++) dir[k] = L::Sub(c1[k], c0[k]);
+         const V fLen = Dot3<L>(dir, dir);
+         Finish(L::Less(fLen, L::Set(1.f / 4096.f)), c0, c1);
+         if (!L::Any(active)) break;
+         const V scale = L::Div(L::Set(fSteps), fLen);
+         for (int32_t k = 0; k < 3; k++) dir[k] = L::Mul(dir[k], scale);
+         // Evaluate function, and derivatives
+         V d2X = L::Zero(), d2Y = L::Zero();
+         V dX[3]{ L::Zero(), L::Zero(), L::Zero() };
+         V dY[3]{ L::Zero(), L::Zero(), L::Zero() };
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            V offset[3];
+            for (int32_t k = 0; k < 3; k++) offset[k] = L::Sub(block[i][k], c0[k]);
+            const V fDot = Dot3<L>(offset, dir);
+            // Clamping before rounding gives 0 for fDot <= 0 and fSteps for fDot >= fSteps.
+            const V step = L::Round(L::Min(L::Max(fDot, L::Zero()), L::Set(fSteps)));
+            // The weights of the step, (3 - step) / 3 and step / 3, are exactly the constant tables {1, 2/3, 1/3, 0}
+            // of the single block encoder: 2 * (1 / 3.f) only shifts the exponent, and 3 * (1 / 3.f) rounds to 1.
+            const V pC = L::Mul(L::Sub(L::Set(fSteps), step), L::Set(1.f / 3.f));
+            const V pD = L::Mul(step, L::Set(1.f / 3.f));
+            const V fC = L::Mul(pC, L::Set(1.f / 8.f));
+            const V fD = L::Mul(pD, L::Set(1.f / 8.f));
+            d2X = L::Add(d2X, L::Mul(fC, pC));
+            d2Y = L::Add(d2Y, L::Mul(fD, pD));
+            for (int32_t k = 0; k < 3; k++)
+            {
+               const V point = L::Add(L::Mul(c0[k], pC), L::Mul(c1[k], pD));
+               const V diff = L::Sub(point, block[i][k]);
+               dX[k] = L::Add(dX[k], L::Mul(diff, fC));
+               dY[k] = L::Add(dY[k], L::Mul(diff, fD));
+            }
+         }
+         // Move endpoints
+         const V moveX = L::Greater(d2X, L::Zero());
+         const V moveY = L::Greater(d2Y, L::Zero());
+         const V scaleX = L::Div(L::Set(-1.f), d2X);
+         const V scaleY = L::Div(L::Set(-1.f), d2Y);
+         V converged = active;
+         for (int32_t k = 0; k < 3; k++)
+         {
+            c0[k] = L::Select(c0[k], L::Add(c0[k], L::Mul(dX[k], scaleX)), moveX);
+            c1[k] = L::Select(c1[k], L::Add(c1[k], L::Mul(dY[k], scaleY)), moveY);
+            converged = L::And(converged, L::Less(L::Mul(dX[k], dX[k]), L::Set(fEpsilon)));
+            converged = L::And(converged, L::Less(L::Mul(dY[k], dY[k]), L::Set(fEpsilon)));
+         }
+         Finish(converged, c0, c1);
+      }
+      Finish(active, c0, c1);
+   }
+
+   template<class L>
+   void EncodeBC1Lanes(const RGBLanes& input, uint8_t* destination, int32_t destinationStride, int32_t blockCount, bool RGBDithering, int32_t iterations)
+   {
+      typedef typename L::V V;
+      XMFLOAT4A luminance, luminanceInv;
+      XMStoreFloat4A(&luminance, RGBLuminance);
+      XMStoreFloat4A(&luminanceInv, RGBLuminanceInv);
+      const float lum[3]{ luminance.x, luminance.y, luminance.z };
+      const float lumInv[3]{ luminanceInv.x, luminanceInv.y, luminanceInv.z };
+      const float quantize[3]{ 31.f, 63.f, 31.f };
+      const float dequantize[3]{ 1 / 31.f, 1 / 63.f, 1 / 31.f };
+      // Quantize blocks to R5G6B5, with optional error diffusion.
+      V colors[BCBlockLength][3];
+      V errors[BCBlockLength][3];
+      if (RGBDithering)
+      {
+         for (int32_t i = 0; i < BCBlockLength; i++) errors[i][0] = errors[i][1] = errors[i][2] = L::Zero();
+      }
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         V diff[3];
+         for (int32_t k = 0; k < 3; k++)
+         {
+            V c = L::Load(input.texels[i][k]);
+            if (RGBDithering) c = L::Add(c, errors[i][k]);
+            c = L::Saturate(c);
+            const V quantized = L::Mul(L::Round(L::Mul(c, L::Set(quantize[k]))), L::Set(dequantize[k]));
+            diff[k] = L::Sub(c, quantized);
+            colors[i][k] = L::Mul(quantized, L::Set(lum[k]));
+         }
+         if (RGBDithering) DiffuseError<L>(errors, diff, i);
+      }
+      // Perform 6D root finding function to find two endpoints of color axis.
+      V colorA[3], colorB[3];
+      OptimizeRGBLanes<L>(colorA, colorB, colors, lum, iterations);
+      // Quantize the end points in lanes, then pack them per block.
+      LaneValues endPoints[2][3];
+      for (int32_t k = 0; k < 3; k++)
+      {
+         const V scale = L::Set(quantize[k]);
+         V a = L::Saturate(L::Mul(colorA[k], L::Set(lumInv[k])));
+         V b = L::Saturate(L::Mul(colorB[k], L::Set(lumInv[k])));
+         L::Store(endPoints[0][k].values, L::Round(L::Mul(a, scale)));
+         L::Store(endPoints[1][k].values, L::Round(L::Mul(b, scale)));
+      }
+      bool isFlat[MaxLaneCount]{};
+      int32_t flatCount = 0;
+      LaneValues decoded[2][3]; // [0]: Step 0 = the larger color, [1]: Step 1 = the smaller color.
+      for (int32_t lane = 0; lane < L::Count; lane++)
+      {
+         auto Pack = [&](int32_t index) -> uint16_t
+            {
+               return uint16_t(int32_t(endPoints[index][0].values[lane]) << 11 | int32_t(endPoints[index][1].values[lane]) << 5 | int32_t(endPoints[index][2].values[lane]));
+            };
+         uint16_t wColorA = Pack(0);
+         uint16_t wColorB = Pack(1);
+         isFlat[lane] = wColorA == wColorB;
+         flatCount += isFlat[lane];
+         // The 4-color mode requires C0 > C1.
+         if (wColorA > wColorB) std::swap(wColorA, wColorB);
+         const uint16_t ordered[2]{ wColorB, wColorA };
+         for (int32_t j = 0; j < 2; j++)
+         {
+            decoded[j][0].values[lane] = float((ordered[j] >> 11) & 31) * (1 / 31.f);
+            decoded[j][1].values[lane] = float((ordered[j] >> 5) & 63) * (1 / 63.f);
+            decoded[j][2].values[lane] = float((ordered[j] >> 0) & 31) * (1 / 31.f);
+         }
+         if (lane >= blockCount) continue;
+         uint8_t* block = destination + lane * destinationStride;
+         reinterpret_cast<uint16_t*>(block)[0] = wColorB;
+         reinterpret_cast<uint16_t*>(block)[1] = isFlat[lane] ? wColorB : wColorA;
+      }
+      if (flatCount == L::Count)
+      {
+         for (int32_t lane = 0; lane < blockCount; lane++) reinterpret_cast<uint32_t*>(destination + lane * destinationStride)[1] = 0x0;
+         return;
+      }
+      // Calculate color steps
+      V step[4][3], dir[3];
+      for (int32_t k = 0; k < 3; k++)
+      {
+         step[0][k] = L::Mul(L::Load(decoded[0][k].values), L::Set(lum[k]));
+         step[1][k] = L::Mul(L::Load(decoded[1][k].values), L::Set(lum[k]));
+         const V length = L::Sub(step[1][k], step[0][k]);
+         step[2][k] = L::Add(L::Mul(length, L::Set(1 / 3.f)), step[0][k]);
+         step[3][k] = L::Add(L::Mul(length, L::Set(2 / 3.f)), step[0][k]);
+         dir[k] = L::Sub(step[1][k], step[0][k]);
+      }
+      const float fSteps = 3;
+      const V scale = L::Div(L::Set(fSteps), Dot3<L>(dir, dir));
+      for (int32_t k = 0; k < 3; k++) dir[k] = L::Mul(dir[k], scale);
+      // Encode colors, 2 bits per pixel
+      LaneValues codes[BCBlockLength];
+      if (RGBDithering)
+      {
+         for (int32_t i = 0; i < BCBlockLength; i++) errors[i][0] = errors[i][1] = errors[i][2] = L::Zero();
+      }
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         V c[3], offset[3];
+         for (int32_t k = 0; k < 3; k++)
+         {
+            c[k] = L::Mul(L::Load(input.texels[i][k]), L::Set(lum[k]));
+            if (RGBDithering) c[k] = L::Add(c[k], errors[i][k]);
+            offset[k] = L::Sub(c[k], step[0][k]);
+         }
+         const V fDot = Dot3<L>(offset, dir);
+         // Step index {0, 1, 2, 3} along the axis maps to the code {0, 2, 3, 1}.
+         const V index = L::Round(L::Min(L::Max(fDot, L::Zero()), L::Set(fSteps)));
+         V code = L::Select(L::Add(index, L::Set(1)), L::Zero(), L::Equal(index, L::Zero()));
+         code = L::Select(code, L::Set(1), L::Equal(index, L::Set(fSteps)));
+         L::Store(codes[i].values, code);
+         if (!RGBDithering) continue;
+         V diff[3];
+         for (int32_t k = 0; k < 3; k++)
+         {
+            V point = step[0][k];
+            for (int32_t s = 1; s < 4; s++) point = L::Select(point, step[s][k], L::Equal(code, L::Set(float(s))));
+            diff[k] = L::Sub(c[k], point);
+         }
+         DiffuseError<L>(errors, diff, i);
+      }
+      for (int32_t lane = 0; lane < blockCount; lane++)
+      {
+         uint32_t encodedIndices = 0;
+         if (!isFlat[lane])
+         {
+            for (int32_t i = 0; i < BCBlockLength; i++) encodedIndices |= uint32_t(codes[i].values[lane]) << (2 * i);
+         }
+         reinterpret_cast<uint32_t*>(destination + lane * destinationStride)[1] = encodedIndices;
+      }
+   }
+
+   template<class L>
+   void EncodeBC4Lanes(const AlphaLanes& input, uint8_t* destination, int32_t destinationStride, int32_t blockCount, int32_t iterations)
+   {
+      typedef typename L::V V;
+      V block[BCBlockLength];
+      for (int32_t i = 0; i < BCBlockLength; i++) block[i] = L::Load(input.texels[i]);
+      // Step 1: Find end points.
+      // Blocks with boundary values use the 6-interpolation codec, which has the exact codes of 0 and 1.
+      V use6 = L::Zero();
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         use6 = L::Or(use6, L::Or(L::Equal(block[i], L::Zero()), L::Equal(block[i], L::Set(1))));
+      }
+      const V fSteps = L::Select(L::Set(7), L::Set(5), use6);
+      V _min = L::Set(1), _max = L::Zero();
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         _min = L::Select(_min, block[i], L::Less(block[i], _min));
+         _max = L::Select(_max, block[i], L::Greater(block[i], _max));
+      }
+      _max = L::Select(_max, L::Set(1), L::And(use6, L::Equal(_min, _max)));
+      // Use Newton's Method to find local minima of sum-of-squares error.
+      V active = L::Equal(L::Zero(), L::Zero());
+      for (int32_t iteration = 0; iteration < iterations; iteration++)
+      {
+         active = L::AndNot(active, L::Less(L::Sub(_max, _min), L::Set(1.f / 256.f)));
+         if (!L::Any(active)) break;
+         const V fScale = L::Div(fSteps, L::Sub(_max, _min));
+         // Evaluate function, and derivatives
+         V dX = L::Zero(), dY = L::Zero(), d2X = L::Zero(), d2Y = L::Zero();
+         const V lowBound = L::Mul(_min, L::Set(0.5f));
+         const V highBound = L::Mul(L::Add(_max, L::Set(1)), L::Set(0.5f));
+         for (int32_t i = 0; i < BCBlockLength; i++)
+         {
+            const V fDot = L::Mul(L::Sub(block[i], _min), fScale);
+            V step = L::Round(fDot);
+            const V low = L::LessOrEqual(fDot, L::Zero());
+            const V high = L::GreaterOrEqual(fDot, fSteps);
+            step = L::Select(step, L::Select(L::Zero(), L::Set(6), L::And(use6, L::LessOrEqual(block[i], lowBound))), low);
+            step = L::Select(step, L::Select(fSteps, L::Set(7), L::And(use6, L::GreaterOrEqual(block[i], highBound))), high);
+            // Indices 6 and 7 of the 6-interpolation codec are the fixed 0 and 1, which have no derivatives.
+            const V valid = L::Less(step, L::Add(fSteps, L::Set(1)));
+            // Correctly rounded, so equal to the constant tables of the single block encoder.
+            // Zeroed weights of the invalid steps only add zeros to the derivatives.
+            const V pC = L::And(L::Div(L::Sub(fSteps, step), fSteps), valid);
+            const V pD = L::And(L::Div(step, fSteps), valid);
+            const V fDiff = L::Sub(L::Add(L::Mul(pC, _min), L::Mul(pD, _max)), block[i]);
+            dX = L::Add(dX, L::Mul(pC, fDiff));
+            d2X = L::Add(d2X, L::Mul(pC, pC));
+            dY = L::Add(dY, L::Mul(pD, fDiff));
+            d2Y = L::Add(d2Y, L::Mul(pD, pD));
+         }
+         // Move endpoints, only for the lanes still iterating.
+         V newMin = L::Select(_min, L::Sub(_min, L::Div(dX, d2X)), L::Greater(d2X, L::Zero()));
+         V newMax = L::Select(_max, L::Sub(_max, L::Div(dY, d2Y)), L::Greater(d2Y, L::Zero()));
+         const V swap = L::Greater(newMin, newMax);
+         const V temp = newMin;
+         newMin = L::Select(newMin, newMax, swap);
+         newMax = L::Select(newMax, temp, swap);
+         _min = L::Select(_min, newMin, active);
+         _max = L::Select(_max, newMax, active);
+         const V converged = L::And(L::Less(L::Mul(dX, dX), L::Set(1.f / 64.f)), L::Less(L::Mul(dY, dY), L::Set(1.f / 64.f)));
+         active = L::AndNot(active, converged);
+      }
+      _min = L::Saturate(_min);
+      _max = L::Saturate(_max);
+      // Quantize the end points: 6-interpolation codec stores min first, the other stores max first.
+      const V byteMin = L::Round(L::Mul(_min, L::Set(float(UINT8_MAX))));
+      const V byteMax = L::Round(L::Mul(_max, L::Set(float(UINT8_MAX))));
+      const V c0 = L::Select(byteMax, byteMin, use6);
+      const V c1 = L::Select(byteMin, byteMax, use6);
+      // Step 2: Compute indices from the palette of the quantized end points.
+      const V mode8 = L::Greater(c0, c1);
+      V palette[8]{ c0, c1 };
+      for (int32_t i = 1; i < 7; i++)
+      {
+         const V p8 = L::Div(L::Add(L::Mul(L::Set(float(7 - i)), c0), L::Mul(L::Set(float(i)), c1)), L::Set(7.f));
+         V p6;
+         if (i < 5) p6 = L::Div(L::Add(L::Mul(L::Set(float(5 - i)), c0), L::Mul(L::Set(float(i)), c1)), L::Set(5.f));
+         else p6 = i == 5 ? L::Zero() : L::Set(float(UINT8_MAX));
+         palette[i + 1] = L::Select(p6, p8, mode8);
+      }
+      LaneValues codes[BCBlockLength];
+      for (int32_t i = 0; i < BCBlockLength; i++)
+      {
+         const V value = L::Mul(block[i], L::Set(float(UINT8_MAX)));
+         V index = L::Zero();
+         V minError = L::Sub(palette[0], value);
+         minError = L::Select(minError, L::Sub(L::Zero(), minError), L::Less(minError, L::Zero()));
+         for (int32_t j = 1; j < 8; j++)
+         {
+            V error = L::Sub(palette[j], value);
+            error = L::Select(error, L::Sub(L::Zero(), error), L::Less(error, L::Zero()));
+            const V better = L::Less(error, minError);
+            minError = L::Select(minError, error, better);
+            index = L::Select(index, L::Set(float(j)), better);
+         }
+         L::Store(codes[i].values, index);
+      }
+      LaneValues endPoints[2];
+      L::Store(endPoints[0].values, c0);
+      L::Store(endPoints[1].values, c1);
+      for (int32_t lane = 0; lane < blockCount; lane++)
+      {
+         uint8_t* block = destination + lane * destinationStride;
+         block[0] = uint8_t(endPoints[0].values[lane]);
+         block[1] = uint8_t(endPoints[1].values[lane]);
+         uint64_t indices = 0;
+         for (int32_t i = 0; i < BCBlockLength; i++) indices |= uint64_t(codes[i].values[lane]) << (3 * i);
+         for (int32_t i = 0; i < 6; i++) block[2 + i] = uint8_t(indices >> (8 * i));
+      }
+   }
+
+   template<class L>
+   void EncodeBC1Batch(const XMFLOAT4A* blocksRGB, uint8_t* destination, int32_t destinationStride, int32_t blockCount, bool RGBDithering, int32_t iterations)
+   {
+      RGBLanes lanes;
+      for (int32_t first = 0; first < blockCount; first += L::Count)
+      {
+         const int32_t count = std::min(L::Count, blockCount - first);
+         for (int32_t lane = 0; lane < L::Count; lane++)
+         {
+            // Pad the tail with the last block.
+            const XMFLOAT4A* block = blocksRGB + (first + std::min(lane, count - 1)) * BCBlockLength;
+            for (int32_t i = 0; i < BCBlockLength; i++)
+            {
+               lanes.texels[i][0][lane] = block[i].x;
+               lanes.texels[i][1][lane] = block[i].y;
+               lanes.texels[i][2][lane] = block[i].z;
+            }
+         }
+         EncodeBC1Lanes<L>(lanes, destination + first * destinationStride, destinationStride, count, RGBDithering, iterations);
+      }
+   }
+
+   template<class L>
+   void EncodeBC4Batch(const float* blocks, uint8_t* destination, int32_t destinationStride, int32_t blockCount, int32_t iterations)
+   {
+      AlphaLanes lanes;
+      for (int32_t first = 0; first < blockCount; first += L::Count)
+      {
+         const int32_t count = std::min(L::Count, blockCount - first);
+         for (int32_t lane = 0; lane < L::Count; lane++)
+         {
+            const float* block = blocks + (first + std::min(lane, count - 1)) * BCBlockLength;
+            for (int32_t i = 0; i < BCBlockLength; i++) lanes.texels[i][lane] = block[i];
+         }
+         EncodeBC4Lanes<L>(lanes, destination + first * destinationStride, destinationStride, count, iterations);
+      }
+   }
+}
+
+int32_t Pillow::Graphics::GetBCBatchWidth()
+{
+   return HasAVX2 ? 8 : 4;
+}
+
+void Pillow::Graphics::EncodeBC1RGBBatch(const XMFLOAT4A* blocksRGB, uint8_t* destination, int32_t destinationStride, int32_t blockCount, bool RGBDithering, EncodeQuality quality)
+{
+   if (quality == EncodeQuality::Slow)
+   {
+      for (int32_t i = 0; i < blockCount; i++) EncodeBC1RGB(blocksRGB + i * BCBlockLength, destination + i * destinationStride, RGBDithering, quality);
+      return;
+   }
+   const int32_t iterations = GetBCRefinementIterations(quality);
+#if defined(PILLOW_AVX2_LANES)
+   if (HasAVX2) return EncodeBC1Batch<Lanes8>(blocksRGB, destination, destinationStride, blockCount, RGBDithering, iterations);
+#endif
+   EncodeBC1Batch<Lanes4>(blocksRGB, destination, destinationStride, blockCount, RGBDithering, iterations);
+}
+
+void Pillow::Graphics::EncodeBC4AlphaBatch(const float* blocks, uint8_t* destination, int32_t destinationStride, int32_t blockCount, EncodeQuality quality)
+{
+   if (quality == EncodeQuality::Slow)
+   {
+      for (int32_t i = 0; i < blockCount; i++) EncodeBC4Alpha(blocks + i * BCBlockLength, destination + i * destinationStride, quality);
+      return;
+   }
+   const int32_t iterations = GetBCRefinementIterations(quality);
+#if defined(PILLOW_AVX2_LANES)
+   if (HasAVX2) return EncodeBC4Batch<Lanes8>(blocks, destination, destinationStride, blockCount, iterations);
+#endif
+   EncodeBC4Batch<Lanes4>(blocks, destination, destinationStride, blockCount, iterations);
+}
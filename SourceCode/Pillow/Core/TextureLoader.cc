@@ -0,0 +1,197 @@
+#include "TextureLoader.h"
+#include "TextureCompression.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   enum LoadStage : int32_t
+   {
+      Read,
+      Decode,
+      Mips,
+      Encode,
+      StageCount
+   };
+}
+
+TextureLoadRequest::TextureLoadRequest(const string& relativePath, bool bSRGB, TextureLoadPriority priority, std::function<void(TextureLoadRequest&)> onFinalize) :
+   _RelativePath(relativePath),
+   _IsSRGB(bSRGB),
+   priority(priority),
+   onFinalize(std::move(onFinalize))
+{
+}
+
+TextureLoadState TextureLoadRequest::Wait() const
+{
+   TextureLoadState current = GetState();
+   while (current == TextureLoadState::Queued || current == TextureLoadState::Loading)
+   {
+      state.wait(current, std::memory_order::acquire);
+      current = GetState();
+   }
+   return current;
+}
+
+TextureLoader::TextureLoader(int32_t threadCount)
+{
+   if (threadCount <= 0) threadCount = std::max(int32_t(std::thread::hardware_concurrency()) - 1, 1);
+   workers.reserve(threadCount);
+   for (int32_t i = 0; i < threadCount; i++) workers.emplace_back(&TextureLoader::Worker, this);
+}
+
+TextureLoader::~TextureLoader()
+{
+   {
+      std::lock_guard guard(lock);
+      quit = true;
+      for (; !queue.empty(); queue.pop())
+      {
+         TextureLoadRequest& request = *queue.top().Request;
+         if (queue.top().Ticket == request.ticket) End(request, TextureLoadState::Cancelled);
+      }
+   }
+   wakeup.notify_all();
+   for (auto& worker : workers) worker.join();
+}
+
+TextureLoadHandle TextureLoader::Load(const string& relativePath, bool bSRGB, TextureLoadPriority priority, std::function<void(TextureLoadRequest&)> onFinalize)
+{
+   auto request = std::make_shared<TextureLoadRequest>(relativePath, bSRGB, priority, std::move(onFinalize));
+   {
+      std::lock_guard guard(lock);
+      if (quit) throw std::runtime_error("The texture loader is shutting down.");
+      Enqueue(request);
+   }
+   wakeup.notify_one();
+   return request;
+}
+
+bool TextureLoader::Cancel(const TextureLoadHandle& request)
+{
+   std::lock_guard guard(lock);
+   const TextureLoadState state = request->GetState();
+   if (state != TextureLoadState::Queued && state != TextureLoadState::Loading) return false;
+   request->cancelled = true;
+   // A queued request ends now, a running one ends when its stage returns.
+   if (request->queued)
+   {
+      request->queued = false;
+      request->ticket = UINT64_MAX;
+      End(*request, TextureLoadState::Cancelled);
+   }
+   return true;
+}
+
+void TextureLoader::SetPriority(const TextureLoadHandle& request, TextureLoadPriority priority)
+{
+   std::lock_guard guard(lock);
+   if (request->GetPriority() == priority) return;
+   request->priority.store(priority, std::memory_order::relaxed);
+   // Queue it again, the old entry is skipped for its ticket.
+   if (request->queued) Enqueue(request);
+}
+
+int32_t TextureLoader::Finalize(double budgetMilliseconds)
+{
+   using namespace std::chrono;
+   const steady_clock::time_point start = steady_clock::now();
+   int32_t count = 0;
+   while (true)
+   {
+      TextureLoadHandle request;
+      {
+         std::lock_guard guard(lock);
+         if (readyQueue.empty()) break;
+         request = readyQueue.top().Request;
+         readyQueue.pop();
+      }
+      if (request->onFinalize) request->onFinalize(*request);
+      request->state.store(TextureLoadState::Finalized, std::memory_order::release);
+      request->state.notify_all();
+      count++;
+      if (duration<double, std::milli>(steady_clock::now() - start).count() >= budgetMilliseconds) break;
+   }
+   return count;
+}
+
+void TextureLoader::Worker()
+{
+   std::unique_lock guard(lock);
+   while (true)
+   {
+      wakeup.wait(guard, [this]() { return quit || !queue.empty(); });
+      if (quit) return;
+      QueueEntry entry = queue.top();
+      queue.pop();
+      TextureLoadRequest& request = *entry.Request;
+      if (entry.Ticket != request.ticket) continue;
+      request.queued = false;
+      request.state.store(TextureLoadState::Loading, std::memory_order::relaxed);
+      guard.unlock();
+      try
+      {
+         RunStage(request);
+      }
+      catch (...)
+      {
+         request.Error = std::current_exception();
+      }
+      guard.lock();
+      if (request.Error) End(request, TextureLoadState::Failed);
+      else if (quit || request.cancelled) End(request, TextureLoadState::Cancelled);
+      else if (++request.stage < StageCount) Enqueue(entry.Request);
+      else
+      {
+         readyQueue.push(QueueEntry{ request.GetPriority(), nextTicket++, entry.Request });
+         request.state.store(TextureLoadState::Ready, std::memory_order::release);
+         request.state.notify_all();
+      }
+   }
+}
+
+// The lock must be held.
+void TextureLoader::Enqueue(const TextureLoadHandle& request)
+{
+   request->ticket = nextTicket++;
+   request->queued = true;
+   queue.push(QueueEntry{ request->GetPriority(), request->ticket, request });
+   wakeup.notify_one();
+}
+
+void TextureLoader::RunStage(TextureLoadRequest& request)
+{
+   // Every worker runs a single thread, the loads themselves run in parallel.
+   switch (request.stage)
+   {
+   case Read:
+      request.fileData = ReadBinaryFile(GetResourcePath(request.GetRelativePath()));
+      break;
+   case Decode:
+      request.Texture = DecodeMipZero(request.fileData.data(), request.fileData.size(), request.GetIsSRGB());
+      request.fileData = std::vector<uint8_t>();
+      break;
+   case Mips:
+      GenerateMips(*request.Texture, 1);
+      break;
+   case Encode:
+   {
+      const GenericTextureInfo& info = request.Texture->Info;
+      if (info.GetCompressionMode() == CompressionMode::None) break;
+      request.Blocks = CreateAlignedMemory(int64_t(info.GetArrayCount()) * GetCompressedArraySliceSize(info));
+      CompressTexture(reinterpret_cast<const uint8_t*>(request.Texture->Data.get()), reinterpret_cast<uint8_t*>(request.Blocks.get()), info, EncodeQuality::Normal, 1);
+      break;
+   }
+   }
+}
+
+void TextureLoader::End(TextureLoadRequest& request, TextureLoadState state)
+{
+   request.fileData = std::vector<uint8_t>();
+   request.Texture.reset();
+   request.Blocks.reset();
+   request.state.store(state, std::memory_order::release);
+   request.state.notify_all();
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include "Auxiliaries.h"
+#include "Texture.h"
+
+namespace Pillow::Graphics
+{
+   enum class TextureLoadPriority : uint8_t
+   {
+      Background,
+      Normal,
+      Visible // On-screen assets jump the queue.
+   };
+
+   enum class TextureLoadState : uint8_t
+   {
+      Queued,
+      Loading,
+      Ready, // The background stages are done, waiting for TextureLoader::Finalize().
+      Finalized,
+      Cancelled,
+      Failed
+   };
+
+   // The shared state of a load. The loader keeps a reference until the load ends.
+   class TextureLoadRequest
+   {
+      DeleteDefautedMethods(TextureLoadRequest)
+         ReadonlyProperty(string, RelativePath)
+         ReadonlyProperty(bool, IsSRGB)
+
+   public:
+      // Valid from Ready on.
+      std::unique_ptr<GenericTexture> Texture;
+      // The compressed blocks of Texture in SubRes[Array][Mip] order, null with CompressionMode::None.
+      std::unique_ptr<CacheLine[]> Blocks;
+      // Valid with Failed.
+      std::exception_ptr Error;
+
+      TextureLoadRequest(const string& relativePath, bool bSRGB, TextureLoadPriority priority, std::function<void(TextureLoadRequest&)> onFinalize);
+
+      ForceInline TextureLoadState GetState() const { return state.load(std::memory_order::acquire); }
+      ForceInline TextureLoadPriority GetPriority() const { return priority.load(std::memory_order::relaxed); }
+      // Block until the background stages end. Returns Ready, Finalized, Cancelled or Failed.
+      TextureLoadState Wait() const;
+
+   private:
+      friend class TextureLoader;
+
+      std::atomic<TextureLoadState> state{ TextureLoadState::Queued };
+      std::atomic<TextureLoadPriority> priority;
+      std::function<void(TextureLoadRequest&)> onFinalize;
+      // The fields below are guarded by the lock of the loader.
+      int32_t stage{};
+      bool cancelled{};
+      bool queued{};
+      // The queue entry in effect. The older entries of a reprioritized request are skipped.
+      uint64_t ticket{};
+      std::vector<uint8_t> fileData;
+   };
+
+   using TextureLoadHandle = std::shared_ptr<TextureLoadRequest>;
+
+   // Loads textures on background threads in 4 stages: read, decode, mips and block compression.
+   // A request goes back to the queue after every stage, so the priorities and the cancellations take effect between stages.
+   class TextureLoader
+   {
+      DeleteDefautedMethods(TextureLoader)
+
+   public:
+      // threadCount background workers(0 = all hardware threads but the calling one).
+      TextureLoader(int32_t threadCount = 0);
+      // The queued loads are cancelled, and the running stages are finished.
+      ~TextureLoader();
+
+      // Returns right away. onFinalize runs on the thread calling Finalize().
+      TextureLoadHandle Load(const string& relativePath, bool bSRGB = false, TextureLoadPriority priority = TextureLoadPriority::Normal,
+         std::function<void(TextureLoadRequest&)> onFinalize = {});
+      // A running stage is never interrupted, the request is dropped before its next stage.
+      // Returns false if the background stages have already ended.
+      bool Cancel(const TextureLoadHandle& request);
+      void SetPriority(const TextureLoadHandle& request, TextureLoadPriority priority);
+      // Call it on the main thread every frame. The Ready loads are finalized in priority order,
+      // until budgetMilliseconds is used up. At least one load is finalized per call. Returns the number of them.
+      int32_t Finalize(double budgetMilliseconds);
+
+   private:
+      struct QueueEntry
+      {
+         TextureLoadPriority Priority;
+         uint64_t Ticket;
+         TextureLoadHandle Request;
+
+         // The higher priority first, then the earlier ticket.
+         ForceInline bool operator<(const QueueEntry& right) const
+         {
+            return Priority != right.Priority ? Priority < right.Priority : Ticket > right.Ticket;
+         }
+      };
+
+      std::mutex lock;
+      std::condition_variable wakeup;
+      std::priority_queue<QueueEntry> queue;
+      std::priority_queue<QueueEntry> readyQueue;
+      uint64_t nextTicket{};
+      bool quit{};
+      std::vector<std::thread> workers;
+
+      void Worker();
+      void Enqueue(const TextureLoadHandle& request);
+      static void RunStage(TextureLoadRequest& request);
+      static void End(TextureLoadRequest& request, TextureLoadState state);
+   };
+}
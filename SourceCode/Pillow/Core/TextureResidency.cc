@@ -0,0 +1,209 @@
+#include "TextureResidency.h"
+#include "TextureCompression.h"
+#include "algorithm"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+SimulatedResidencyBackend::SimulatedResidencyBackend(int64_t capacity) :
+   _Capacity(capacity)
+{
+}
+
+bool SimulatedResidencyBackend::MakeResident(uint32_t texture, int32_t mip, int64_t size)
+{
+   if (IsResident(texture, mip)) throw std::runtime_error("The mip is already resident.");
+   if (_Capacity > 0 && _AllocatedSize + size > _Capacity)
+   {
+      _FailedAllocationCount++;
+      return false;
+   }
+   allocations.insert(Allocation{ texture, mip, size });
+   _AllocatedSize += size;
+   _AllocationCount++;
+   return true;
+}
+
+void SimulatedResidencyBackend::Evict(uint32_t texture, int32_t mip)
+{
+   auto it = allocations.find(Allocation{ texture, mip, 0 });
+   if (it == allocations.end()) throw std::runtime_error("The mip isn't resident.");
+   _AllocatedSize -= it->Size;
+   allocations.erase(it);
+}
+
+TextureResidencyManager::TextureResidencyManager(ResidencyBackend& backend, int64_t budget, int32_t minResidentMips) :
+   _Budget(budget),
+   _MinResidentMips(std::max(minResidentMips, 1)),
+   backend(backend)
+{
+}
+
+TextureResidencyManager::~TextureResidencyManager()
+{
+   for (uint32_t texture = 0; texture < entries.size(); texture++)
+   {
+      if (entries[texture].Registered) Unregister(texture);
+   }
+}
+
+uint32_t TextureResidencyManager::Register(const GenericTextureInfo& info)
+{
+   uint32_t texture = uint32_t(entries.size());
+   if (freeIds.empty()) entries.emplace_back();
+   else
+   {
+      texture = freeIds.back();
+      freeIds.pop_back();
+   }
+   const int32_t tailMip = std::max(int32_t(info.GetMipCount()) - _MinResidentMips, 0);
+   entries[texture] = Entry{ info, info.GetMipCount(), tailMip, _FrameIndex, 0, true };
+   // The tail is always resident, even beyond the budget.
+   while (entries[texture].ResidentMip > tailMip)
+   {
+      if (StreamIn(texture, true)) continue;
+      Unregister(texture);
+      throw std::runtime_error("Out of texture memory.");
+   }
+   return texture;
+}
+
+void TextureResidencyManager::Unregister(uint32_t texture)
+{
+   Entry& entry = GetEntry(texture);
+   while (entry.ResidentMip < entry.Info.GetMipCount()) EvictMip(texture);
+   entry.Registered = false;
+   freeIds.push_back(texture);
+}
+
+void TextureResidencyManager::MarkSampled(uint32_t texture, int32_t mip)
+{
+   Entry& entry = GetEntry(texture);
+   const int32_t tailMip = std::max(int32_t(entry.Info.GetMipCount()) - _MinResidentMips, 0);
+   mip = std::clamp(mip, 0, tailMip);
+   // The first sample of a frame replaces the request of the previous frames.
+   entry.DesiredMip = entry.LastSampledFrame == _FrameIndex ? std::min(entry.DesiredMip, mip) : mip;
+   entry.LastSampledFrame = _FrameIndex;
+}
+
+void TextureResidencyManager::Update()
+{
+   // A smaller budget, or the tails of new textures, may have exceeded the budget.
+   MakeRoom(0, UINT32_MAX);
+   // Stream in a mip at a time, the smallest pending mip first, so every texture gets sharper before any gets its largest mip.
+   std::vector<std::pair<int64_t, uint32_t>> pending;
+   auto Push = [&](uint32_t texture)
+      {
+         const Entry& entry = entries[texture];
+         if (entry.LastSampledFrame != _FrameIndex || entry.ResidentMip <= entry.DesiredMip) return;
+         pending.emplace_back(GetMipSize(entry.Info, entry.ResidentMip - 1), texture);
+         std::push_heap(pending.begin(), pending.end(), std::greater<>());
+      };
+   for (uint32_t texture = 0; texture < entries.size(); texture++)
+   {
+      if (entries[texture].Registered) Push(texture);
+   }
+   while (!pending.empty())
+   {
+      std::pop_heap(pending.begin(), pending.end(), std::greater<>());
+      const uint32_t texture = pending.back().second;
+      pending.pop_back();
+      if (StreamIn(texture)) Push(texture);
+   }
+   _FrameIndex++;
+}
+
+void TextureResidencyManager::SetBudget(int64_t budget)
+{
+   _Budget = budget;
+   MakeRoom(0, UINT32_MAX);
+}
+
+int32_t TextureResidencyManager::GetResidentMip(uint32_t texture) const
+{
+   return GetEntry(texture).ResidentMip;
+}
+
+int32_t TextureResidencyManager::GetDesiredMip(uint32_t texture) const
+{
+   return GetEntry(texture).DesiredMip;
+}
+
+int64_t TextureResidencyManager::GetResidentSize(uint32_t texture) const
+{
+   return GetEntry(texture).ResidentSize;
+}
+
+ResidencyStats TextureResidencyManager::GetStats() const
+{
+   const int32_t textureCount = int32_t(entries.size() - freeIds.size());
+   return ResidencyStats{ _Budget, residentSize, peakResidentSize, streamedIn, evicted, textureCount };
+}
+
+int64_t TextureResidencyManager::GetMipSize(const GenericTextureInfo& info, int32_t mip)
+{
+   const int64_t size = info.GetCompressionMode() == CompressionMode::None ? info.GetMipSize(mip) : GetCompressedMipSize(info.GetFormat(), info.GetCompressionMode(), info.GetMipWidth(mip));
+   return size * info.GetArrayCount();
+}
+
+TextureResidencyManager::Entry& TextureResidencyManager::GetEntry(uint32_t texture)
+{
+   if (texture >= entries.size() || !entries[texture].Registered) throw std::runtime_error("Invalid texture id.");
+   return entries[texture];
+}
+
+const TextureResidencyManager::Entry& TextureResidencyManager::GetEntry(uint32_t texture) const
+{
+   if (texture >= entries.size() || !entries[texture].Registered) throw std::runtime_error("Invalid texture id.");
+   return entries[texture];
+}
+
+bool TextureResidencyManager::StreamIn(uint32_t texture, bool bOverBudget)
+{
+   const int32_t mip = entries[texture].ResidentMip - 1;
+   const int64_t size = GetMipSize(entries[texture].Info, mip);
+   const bool fits = MakeRoom(size, texture);
+   if ((!fits && !bOverBudget) || !backend.MakeResident(texture, mip, size)) return false;
+   Entry& entry = entries[texture];
+   entry.ResidentMip = mip;
+   entry.ResidentSize += size;
+   residentSize += size;
+   peakResidentSize = std::max(peakResidentSize, residentSize);
+   streamedIn++;
+   return true;
+}
+
+void TextureResidencyManager::EvictMip(uint32_t texture)
+{
+   Entry& entry = entries[texture];
+   const int64_t size = GetMipSize(entry.Info, entry.ResidentMip);
+   backend.Evict(texture, entry.ResidentMip);
+   entry.ResidentMip++;
+   entry.ResidentSize -= size;
+   residentSize -= size;
+   evicted++;
+}
+
+bool TextureResidencyManager::MakeRoom(int64_t size, uint32_t requester)
+{
+   if (residentSize + size <= _Budget) return true;
+   std::vector<uint32_t> candidates;
+   for (uint32_t texture = 0; texture < entries.size(); texture++)
+   {
+      if (entries[texture].Registered && texture != requester) candidates.push_back(texture);
+   }
+   std::stable_sort(candidates.begin(), candidates.end(), [this](uint32_t left, uint32_t right)
+      {
+         return entries[left].LastSampledFrame < entries[right].LastSampledFrame;
+      });
+   for (uint32_t texture : candidates)
+   {
+      const Entry& entry = entries[texture];
+      // Textures sampled in this frame keep the mips they asked for, the others keep their tails.
+      const int32_t tailMip = std::max(int32_t(entry.Info.GetMipCount()) - _MinResidentMips, 0);
+      const int32_t keptMip = entry.LastSampledFrame == _FrameIndex ? entry.DesiredMip : tailMip;
+      while (entry.ResidentMip < keptMip && residentSize + size > _Budget) EvictMip(texture);
+      if (residentSize + size <= _Budget) return true;
+   }
+   return false;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <set>
+#include <vector>
+#include "Auxiliaries.h"
+#include "Texture.h"
+
+namespace Pillow::Graphics
+{
+   // Where the residency manager allocates the mips. A mip covers all the array slices of a texture.
+   class ResidencyBackend
+   {
+   public:
+      virtual ~ResidencyBackend() = default;
+      // Allocate the mip and stream its texels in. Returns false if the memory is exhausted.
+      virtual bool MakeResident(uint32_t texture, int32_t mip, int64_t size) = 0;
+      virtual void Evict(uint32_t texture, int32_t mip) = 0;
+   };
+
+   // A CPU side backend that only counts the allocations, for tests and budget tuning without a device.
+   // The capacity simulates the memory of a device(0 = unlimited).
+   class SimulatedResidencyBackend final : public ResidencyBackend
+   {
+      DeleteDefautedMethods(SimulatedResidencyBackend)
+         ReadonlyProperty(int64_t, Capacity)
+         ReadonlyProperty(int64_t, AllocatedSize)
+         ReadonlyProperty(int64_t, AllocationCount)
+         ReadonlyProperty(int64_t, FailedAllocationCount)
+
+   public:
+      SimulatedResidencyBackend(int64_t capacity);
+
+      bool MakeResident(uint32_t texture, int32_t mip, int64_t size) override;
+      void Evict(uint32_t texture, int32_t mip) override;
+      ForceInline bool IsResident(uint32_t texture, int32_t mip) const { return allocations.contains(Allocation{ texture, mip, 0 }); }
+
+   private:
+      struct Allocation
+      {
+         uint32_t Texture;
+         int32_t Mip;
+         int64_t Size;
+
+         ForceInline bool operator<(const Allocation& right) const
+         {
+            return Texture != right.Texture ? Texture < right.Texture : Mip < right.Mip;
+         }
+      };
+
+      std::set<Allocation> allocations;
+   };
+
+   struct ResidencyStats
+   {
+      int64_t Budget{};
+      int64_t ResidentSize{};
+      int64_t PeakResidentSize{};
+      // In mips.
+      int64_t StreamedIn{};
+      int64_t Evicted{};
+      int32_t TextureCount{};
+   };
+
+   // Keeps the mips of the registered textures within a memory budget.
+   // 1.A texture is resident from its most detailed resident mip to its last mip, the tail of minResidentMips always stays.
+   // 2.Textures report the mip they are sampled at, and the missing mips stream in at the next Update().
+   // 3.To make room, the most detailed mips of the least recently sampled textures are evicted first.
+   //   Textures sampled in the current frame only lose the mips beyond what they asked for.
+   // It isn't thread safe, all the calls belong to the thread which renders the frames.
+   class TextureResidencyManager
+   {
+      DeleteDefautedMethods(TextureResidencyManager)
+         ReadonlyProperty(int64_t, Budget)
+         ReadonlyProperty(int32_t, MinResidentMips)
+         ReadonlyProperty(uint64_t, FrameIndex)
+
+   public:
+      TextureResidencyManager(ResidencyBackend& backend, int64_t budget, int32_t minResidentMips = 1);
+      ~TextureResidencyManager();
+
+      // Only the mip tail becomes resident. Returns the id passed to the backend.
+      uint32_t Register(const GenericTextureInfo& info);
+      void Unregister(uint32_t texture);
+      // Record a sample in the current frame, mip is the most detailed mip needed.
+      void MarkSampled(uint32_t texture, int32_t mip);
+      // Call it once per frame: stream in the requested mips within the budget.
+      void Update();
+      // A smaller budget takes effect at once.
+      void SetBudget(int64_t budget);
+
+      // The most detailed resident mip, a min-LOD clamp for the samplers.
+      int32_t GetResidentMip(uint32_t texture) const;
+      // The most detailed mip sampled in the last frame it was sampled.
+      int32_t GetDesiredMip(uint32_t texture) const;
+      int64_t GetResidentSize(uint32_t texture) const;
+      ResidencyStats GetStats() const;
+      // The size of a mip of all the array slices, block compressed or not.
+      static int64_t GetMipSize(const GenericTextureInfo& info, int32_t mip);
+
+   private:
+      struct Entry
+      {
+         GenericTextureInfo Info;
+         int32_t ResidentMip;
+         int32_t DesiredMip;
+         uint64_t LastSampledFrame;
+         int64_t ResidentSize;
+         bool Registered;
+      };
+
+      ResidencyBackend& backend;
+      std::vector<Entry> entries;
+      std::vector<uint32_t> freeIds;
+      int64_t residentSize{};
+      int64_t peakResidentSize{};
+      int64_t streamedIn{};
+      int64_t evicted{};
+
+      Entry& GetEntry(uint32_t texture);
+      const Entry& GetEntry(uint32_t texture) const;
+      bool StreamIn(uint32_t texture, bool bOverBudget = false);
+      void EvictMip(uint32_t texture);
+      bool MakeRoom(int64_t size, uint32_t requester);
+   };
+}
@@ -0,0 +1,214 @@
+#include "TextureStreamer.h"
+#include "cmath"
+#include "cstring"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // Copy a mip of all the array slices out of the mapped file, which is where the disk is read.
+   std::unique_ptr<CacheLine[]> ReadMip(const CookedTexture& source, int32_t mip)
+   {
+      auto data = CreateAlignedMemory(TextureResidencyManager::GetMipSize(source.Info, mip));
+      uint8_t* destination = reinterpret_cast<uint8_t*>(data.get());
+      for (int32_t slice = 0; slice < source.Info.GetArrayCount(); slice++)
+      {
+         const std::span<const uint8_t> subresource = source.GetSubresource(slice, mip);
+         std::memcpy(destination, subresource.data(), subresource.size());
+         destination += subresource.size();
+      }
+      return data;
+   }
+}
+
+TextureStreamer::TextureStreamer(int64_t budget) :
+   manager(*this, budget, StreamingTailMips)
+{
+   // The fetches are bound by the disk, a single thread keeps them in order.
+   worker = std::thread(&TextureStreamer::Worker, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+   {
+      std::lock_guard guard(lock);
+      quit = true;
+      queue.clear();
+   }
+   wakeup.notify_all();
+   worker.join();
+}
+
+uint32_t TextureStreamer::Register(const string& relativePath)
+{
+   std::shared_ptr<CookedTexture> source = LoadCookedTexture(relativePath);
+   const uint32_t texture = manager.Register(source->Info);
+   std::vector<FetchJob> tail;
+   {
+      std::lock_guard guard(lock);
+      slots[texture].Source = source;
+      tail.swap(staged);
+   }
+   // The tail doesn't wait for the background thread.
+   for (const FetchJob& job : tail)
+   {
+      auto data = ReadMip(*source, job.Mip);
+      std::lock_guard guard(lock);
+      Complete(job, std::move(data));
+   }
+   return texture;
+}
+
+void TextureStreamer::Unregister(uint32_t texture)
+{
+   manager.Unregister(texture);
+   // The queued fetches of the texture are skipped for their tickets.
+   std::lock_guard guard(lock);
+   slots[texture] = Slot{};
+}
+
+void TextureStreamer::RequestMip(uint32_t texture, int32_t mip)
+{
+   manager.MarkSampled(texture, mip);
+}
+
+void TextureStreamer::RequestScreenWidth(uint32_t texture, float screenWidth)
+{
+   const float width = GetInfo(texture).GetWidth();
+   RequestMip(texture, int32_t(std::floor(std::log2(width / std::max(screenWidth, 1.0f)))));
+}
+
+void TextureStreamer::Update()
+{
+   manager.Update();
+   {
+      std::lock_guard guard(lock);
+      if (staged.empty()) return;
+      queue.insert(queue.end(), staged.begin(), staged.end());
+      staged.clear();
+   }
+   wakeup.notify_one();
+}
+
+void TextureStreamer::Flush()
+{
+   std::unique_lock guard(lock);
+   idle.wait(guard, [this]() { return queue.empty() && !fetching; });
+}
+
+void TextureStreamer::SetBudget(int64_t budget)
+{
+   manager.SetBudget(budget);
+}
+
+float TextureStreamer::GetMinLOD(uint32_t texture) const
+{
+   std::lock_guard guard(lock);
+   return float(GetSlot(texture).ActiveMip);
+}
+
+std::span<const uint8_t> TextureStreamer::GetMip(uint32_t texture, int32_t mip) const
+{
+   std::lock_guard guard(lock);
+   const Slot& slot = GetSlot(texture);
+   if (mip < slot.ActiveMip || mip >= int32_t(slot.Mips.size())) return {};
+   const int64_t size = TextureResidencyManager::GetMipSize(slot.Source->Info, mip);
+   return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(slot.Mips[mip].get()), size);
+}
+
+const GenericTextureInfo& TextureStreamer::GetInfo(uint32_t texture) const
+{
+   std::lock_guard guard(lock);
+   return GetSlot(texture).Source->Info;
+}
+
+StreamedTextureStats TextureStreamer::GetTextureStats(uint32_t texture) const
+{
+   int32_t activeMip;
+   {
+      std::lock_guard guard(lock);
+      activeMip = GetSlot(texture).ActiveMip;
+   }
+   return StreamedTextureStats{ manager.GetDesiredMip(texture), manager.GetResidentMip(texture), activeMip, manager.GetResidentSize(texture) };
+}
+
+ResidencyStats TextureStreamer::GetStats() const
+{
+   return manager.GetStats();
+}
+
+// Called by the manager, the memory itself is allocated when the fetch completes.
+bool TextureStreamer::MakeResident(uint32_t texture, int32_t mip, int64_t)
+{
+   std::lock_guard guard(lock);
+   if (texture >= slots.size()) slots.resize(texture + 1);
+   Slot& slot = slots[texture];
+   // The manager allocates the last mip first.
+   if (slot.Tickets.empty())
+   {
+      slot.Mips.resize(mip + 1);
+      slot.Tickets.resize(mip + 1);
+      slot.ActiveMip = mip + 1;
+   }
+   slot.Tickets[mip] = nextTicket++;
+   staged.push_back(FetchJob{ texture, mip, slot.Tickets[mip] });
+   return true;
+}
+
+void TextureStreamer::Evict(uint32_t texture, int32_t mip)
+{
+   std::lock_guard guard(lock);
+   Slot& slot = slots[texture];
+   slot.Tickets[mip] = 0;
+   slot.Mips[mip].reset();
+   slot.ActiveMip = std::max(slot.ActiveMip, mip + 1);
+}
+
+void TextureStreamer::Worker()
+{
+   std::unique_lock guard(lock);
+   while (true)
+   {
+      wakeup.wait(guard, [this]() { return quit || !queue.empty(); });
+      if (quit) return;
+      const FetchJob job = queue.front();
+      queue.pop_front();
+      if (IsCurrent(job))
+      {
+         // The texture may be unregistered meanwhile, the file stays mapped until the fetch ends.
+         std::shared_ptr<CookedTexture> source = slots[job.Texture].Source;
+         fetching = true;
+         guard.unlock();
+         auto data = ReadMip(*source, job.Mip);
+         guard.lock();
+         fetching = false;
+         Complete(job, std::move(data));
+      }
+      if (queue.empty()) idle.notify_all();
+   }
+}
+
+// The lock must be held.
+bool TextureStreamer::IsCurrent(const FetchJob& job) const
+{
+   return job.Texture < slots.size() && job.Mip < int32_t(slots[job.Texture].Tickets.size()) && slots[job.Texture].Tickets[job.Mip] == job.Ticket;
+}
+
+// The lock must be held.
+void TextureStreamer::Complete(const FetchJob& job, std::unique_ptr<CacheLine[]> data)
+{
+   // Evicted while being fetched.
+   if (!IsCurrent(job)) return;
+   Slot& slot = slots[job.Texture];
+   slot.Mips[job.Mip] = std::move(data);
+   // The mips are allocated from the tail up, so the active range grows without gaps.
+   while (slot.ActiveMip > 0 && slot.Mips[slot.ActiveMip - 1]) slot.ActiveMip--;
+}
+
+// The lock must be held.
+const TextureStreamer::Slot& TextureStreamer::GetSlot(uint32_t texture) const
+{
+   if (texture >= slots.size() || !slots[texture].Source) throw std::runtime_error("Invalid texture id.");
+   return slots[texture];
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <span>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "Auxiliaries.h"
+#include "CookedTexture.h"
+#include "TextureResidency.h"
+
+namespace Pillow::Graphics
+{
+   // The mips from 64x64 down to 4x4, the mip chains end at 4x4.
+   const int32_t StreamingTailMips = 5;
+
+   struct StreamedTextureStats
+   {
+      int32_t DesiredMip;
+      // Allocated within the budget. The mips in [ResidentMip, ActiveMip) are being fetched.
+      int32_t ResidentMip;
+      // The most detailed mip the samplers may use.
+      int32_t ActiveMip;
+      int64_t ResidentSize;
+   };
+
+   // Streams the mips of .ptex files within a memory budget.
+   // 1.A registered texture has its tail resident at once, read on the calling thread.
+   // 2.The mips requested every frame are allocated by the TextureResidencyManager at Update(),
+   //   then fetched from the mapped file by a background thread, the smaller mips first.
+   // 3.A fetched mip is activated when all the mips below it are in. Clamp the sampling with GetMinLOD(),
+   //   which is the ResourceMinLODClamp of a D3D12 SRV, or GL_TEXTURE_MIN_LOD.
+   // All the calls belong to the thread which renders the frames, like TextureResidencyManager.
+   class TextureStreamer final : private ResidencyBackend
+   {
+      DeleteDefautedMethods(TextureStreamer)
+
+   public:
+      TextureStreamer(int64_t budget);
+      // The queued fetches are dropped, the running one is finished.
+      ~TextureStreamer();
+
+      // Map a .ptex file and make its tail resident. Returns the id of the texture.
+      uint32_t Register(const string& relativePath);
+      void Unregister(uint32_t texture);
+      // Request mip and the smaller mips for the current frame.
+      void RequestMip(uint32_t texture, int32_t mip);
+      // Request the mip whose width matches the width of the texture on screen, in pixels.
+      void RequestScreenWidth(uint32_t texture, float screenWidth);
+      // Call it once per frame, after the requests: allocate the requested mips and queue their fetches.
+      void Update();
+      // Block until the queued fetches end.
+      void Flush();
+      void SetBudget(int64_t budget);
+
+      float GetMinLOD(uint32_t texture) const;
+      // A mip of all the array slices in SubRes[Array] order, the texels or the BC blocks.
+      // Empty if the mip isn't active. Valid until the next Update(), SetBudget() or Unregister().
+      std::span<const uint8_t> GetMip(uint32_t texture, int32_t mip) const;
+      const GenericTextureInfo& GetInfo(uint32_t texture) const;
+      StreamedTextureStats GetTextureStats(uint32_t texture) const;
+      ResidencyStats GetStats() const;
+
+   private:
+      struct Slot
+      {
+         std::shared_ptr<CookedTexture> Source;
+         // A buffer per mip, null until fetched.
+         std::vector<std::unique_ptr<CacheLine[]>> Mips;
+         // The fetch in effect per mip, 0 if the mip isn't resident.
+         std::vector<uint64_t> Tickets;
+         int32_t ActiveMip;
+      };
+
+      struct FetchJob
+      {
+         uint32_t Texture;
+         int32_t Mip;
+         uint64_t Ticket;
+      };
+
+      mutable std::mutex lock;
+      std::condition_variable wakeup;
+      std::condition_variable idle;
+      std::vector<Slot> slots;
+      // The fetches allocated by the manager in the current call, not yet queued.
+      std::vector<FetchJob> staged;
+      std::deque<FetchJob> queue;
+      uint64_t nextTicket{ 1 };
+      bool fetching{};
+      bool quit{};
+      // After the slots, as its destructor evicts through them.
+      TextureResidencyManager manager;
+      std::thread worker;
+
+      bool MakeResident(uint32_t texture, int32_t mip, int64_t size) override;
+      void Evict(uint32_t texture, int32_t mip) override;
+      void Worker();
+      bool IsCurrent(const FetchJob& job) const;
+      void Complete(const FetchJob& job, std::unique_ptr<CacheLine[]> data);
+      const Slot& GetSlot(uint32_t texture) const;
+   };
+}
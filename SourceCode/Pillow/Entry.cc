@@ -5,6 +5,7 @@
 #include "Core/Renderers/Renderer.h"
 #include "Core/Input.h"
 #include "Core/Auxiliaries.h"
+#include "Core/JobSystem.h"
 #if defined(_WIN64)
 #define NOMINMAX
 #include <Windows.h>
@@ -211,6 +212,7 @@ void EngineLaunch()
 {
    GlobalClockStart();
    Constants::SetThreadNumbers();
+   InitializeJobSystem(Constants::ThreadNumJobs);
 #if defined(_WIN64)
    Graphics::InitializeRenderer(Constants::ThreadNumRenderer, (void*)&hwnd);
 #elif defined(__ANDROID__)
@@ -231,6 +233,7 @@ void EngineTerminate()
 {
    Graphics::Instance->Terminate();
    Graphics::Instance.reset();
+   TerminateJobSystem();
 }
 }
 
@@ -0,0 +1,136 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "TestUtilities.h"
+#include "Core/TextureCompression.h"
+
+// The round trip of a known texture through the encoders and DecompressMip() stays above a PSNR floor,
+// and the block rows DecompressMip() decodes in parallel match the single block decoders.
+namespace
+{
+   using namespace Pillow;
+   using namespace Pillow::Graphics;
+
+   const int32_t Width = 64;
+   // More threads than block rows of the small mips, so every worker count is exercised.
+   const int32_t ThreadCount = 4;
+
+   // Gradients in every channel with a little noise, the mips are generated from mip 0.
+   std::unique_ptr<GenericTexture> CreateKnownTexture(GenericTexFmt format, CompressionMode compMode)
+   {
+      auto texture = std::make_unique<GenericTexture>(GenericTextureInfo(format, Width, true, compMode));
+      const int32_t pixelSize = texture->Info.GetPixelSize();
+      uint8_t* texels = texture->GetSubresource(0, 0);
+      uint32_t random = 1;
+      for (int32_t y = 0; y < Width; y++)
+      {
+         for (int32_t x = 0; x < Width; x++)
+         {
+            random = random * 1664525u + 1013904223u;
+            const uint8_t noise = uint8_t(random >> 29);
+            const uint8_t values[4]{ uint8_t(x * 4 + noise), uint8_t(y * 4 + noise), uint8_t((x + y) * 2), uint8_t(UINT8_MAX - x * 2 - noise) };
+            for (int32_t c = 0; c < pixelSize; c++) texels[(y * Width + x) * pixelSize + c] = values[c];
+         }
+      }
+      GenerateMips(*texture, ThreadCount);
+      return texture;
+   }
+
+   void CheckQuality(GenericTexFmt format, CompressionMode compMode, double minPSNR, double minSSIM, const string& name)
+   {
+      const auto texture = CreateKnownTexture(format, compMode);
+      const CompressionQuality quality = MeasureCompressionQuality(*texture, EncodeQuality::Normal, ThreadCount);
+      char line[128];
+      std::snprintf(line, sizeof(line), "%s: PSNR %.2f dB, SSIM %.4f", name.c_str(), quality.PSNR, quality.SSIM);
+      LogSystem(line);
+      Tests::Check(quality.PSNR >= minPSNR, name + " is below its PSNR floor.");
+      Tests::Check(quality.SSIM >= minSSIM, name + " is below its SSIM floor.");
+   }
+
+   // A block decoded into R8G8B8A8 texels in row-major order, by the single block decoders.
+   void DecodeSingleBlock(const uint8_t* block, GenericTexFmt format, CompressionMode compMode, uint8_t* texels)
+   {
+      XMFLOAT4A colors[ASTCMaxBlockLength];
+      float first[BCBlockLength], second[BCBlockLength];
+      switch (compMode)
+      {
+      case CompressionMode::Hardware:
+         if (format != GenericTexFmt::UnsignedNormalized_R8G8) throw std::runtime_error("The test decodes BC5 only.");
+         DecodeBC5Normal(block, first, second);
+         for (int32_t i = 0; i < BCBlockLength; i++) colors[i] = XMFLOAT4A(first[i], second[i], 0, 1);
+         break;
+      case CompressionMode::ETC2:
+         if (format != GenericTexFmt::UnsignedNormalized_R8G8B8A8) throw std::runtime_error("The test decodes RGBA8_ETC2_EAC only.");
+         DecodeETC2RGB(block + EACBlockSize, colors);
+         DecodeEACAlpha(block, first);
+         for (int32_t i = 0; i < BCBlockLength; i++) colors[i].w = first[i];
+         break;
+      default:
+         DecodeASTC(block, GetBlockWidth(compMode), colors);
+         break;
+      }
+      const int32_t blockWidth = GetBlockWidth(compMode);
+      for (int32_t i = 0; i < blockWidth * blockWidth; i++) ColorFloat2Byte(texels + i * 4, XMLoadFloat4A(&colors[i]));
+   }
+
+   // tolerance covers the BC palettes, DecompressMip() computes them a color per vector and rounds them to bytes first.
+   void CheckParallelDecoder(GenericTexFmt format, CompressionMode compMode, int32_t width, int32_t tolerance, const string& name)
+   {
+      const auto texture = CreateKnownTexture(format, compMode);
+      const int32_t blockWidth = GetBlockWidth(compMode);
+      const int32_t blockCount = GetBlockCount(compMode, width);
+      const int32_t blockSize = GetBlockSize(format, compMode);
+      // Mip 0 is 64 wide, the smaller widths take the top left corner of it.
+      std::vector<uint8_t> texels(size_t(width) * width * texture->Info.GetPixelSize());
+      for (int32_t y = 0; y < width; y++)
+      {
+         std::memcpy(&texels[size_t(y) * width * texture->Info.GetPixelSize()], texture->GetSubresource(0, 0) + int64_t(y) * Width * texture->Info.GetPixelSize(),
+            size_t(width) * texture->Info.GetPixelSize());
+      }
+      std::vector<uint8_t> blocks(GetCompressedMipSize(format, compMode, width));
+      CompressMip(texels.data(), blocks.data(), format, compMode, width, EncodeQuality::Normal, ThreadCount);
+      std::vector<uint8_t> decoded(size_t(width) * width * 4);
+      const CompressionStats stats = DecompressMip(blocks.data(), decoded.data(), format, compMode, width, ThreadCount);
+      Tests::Check(stats.BlockCount == int64_t(blockCount) * blockCount, name + " decoded a wrong number of blocks.");
+      uint8_t reference[ASTCMaxBlockLength * 4];
+      for (int32_t blockY = 0; blockY < blockCount; blockY++)
+      {
+         for (int32_t blockX = 0; blockX < blockCount; blockX++)
+         {
+            DecodeSingleBlock(&blocks[(size_t(blockY) * blockCount + blockX) * blockSize], format, compMode, reference);
+            // The texels over the edge are dropped by DecompressMip().
+            for (int32_t y = 0; y < blockWidth && blockY * blockWidth + y < width; y++)
+            {
+               for (int32_t x = 0; x < blockWidth && blockX * blockWidth + x < width; x++)
+               {
+                  const uint8_t* expected = reference + (y * blockWidth + x) * 4;
+                  const uint8_t* actual = &decoded[((size_t(blockY) * blockWidth + y) * width + blockX * blockWidth + x) * 4];
+                  for (int32_t c = 0; c < 4; c++)
+                  {
+                     Tests::Check(std::abs(int32_t(actual[c]) - expected[c]) <= tolerance, name + " differs from the single block decoder at block (" +
+                        std::to_string(blockX) + ", " + std::to_string(blockY) + ").");
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+int main()
+{
+   return Tests::RunTest("CompressionQualityTest", []()
+      {
+         // The floors are a little below the results of the encoders at the time of writing.
+         CheckQuality(GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::Hardware, 30, 0.93, "BC3");
+         CheckQuality(GenericTexFmt::UnsignedNormalized_R8G8, CompressionMode::Hardware, 42, 0.99, "BC5");
+         CheckQuality(GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ETC2, 26, 0.93, "RGBA8_ETC2_EAC");
+         CheckQuality(GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ASTC4x4, 32, 0.945, "ASTC 4x4");
+         CheckQuality(GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ASTC6x6, 28.5, 0.9, "ASTC 6x6");
+         CheckParallelDecoder(GenericTexFmt::UnsignedNormalized_R8G8, CompressionMode::Hardware, Width, 1, "BC5");
+         CheckParallelDecoder(GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ETC2, Width, 0, "RGBA8_ETC2_EAC");
+         CheckParallelDecoder(GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ASTC4x4, Width, 0, "ASTC 4x4");
+         // 32 texels end in the middle of the sixth 6x6 block.
+         CheckParallelDecoder(GenericTexFmt::UnsignedNormalized_R8G8B8A8, CompressionMode::ASTC6x6, 32, 0, "ASTC 6x6");
+      });
+}
@@ -0,0 +1,91 @@
+#include <fstream>
+#include <cstring>
+#include "TestUtilities.h"
+#include "Core/CookedTexture.h"
+
+// A .ktx2 level whose offset wraps the bounds check of its end around must be rejected.
+namespace
+{
+   using namespace Pillow;
+
+   // The .ktx2 layout, as CookedTexture.cc reads it.
+   struct KTX2Header
+   {
+      uint8_t Identifier[12];
+      uint32_t VkFormat;
+      uint32_t TypeSize;
+      uint32_t PixelWidth;
+      uint32_t PixelHeight;
+      uint32_t PixelDepth;
+      uint32_t LayerCount;
+      uint32_t FaceCount;
+      uint32_t LevelCount;
+      uint32_t SupercompressionScheme;
+      uint32_t DFDByteOffset;
+      uint32_t DFDByteLength;
+      uint32_t KVDByteOffset;
+      uint32_t KVDByteLength;
+      uint64_t SGDByteOffset;
+      uint64_t SGDByteLength;
+   };
+
+   struct KTX2Level
+   {
+      uint64_t ByteOffset;
+      uint64_t ByteLength;
+      uint64_t UncompressedByteLength;
+   };
+
+   const uint8_t KTX2Identifier[12]{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+   const uint32_t VkFormatR8G8B8A8Unorm = 37;
+   const uint64_t LevelSize = 4 * 4 * 4;
+
+   // A 4x4 R8G8B8A8_UNORM .ktx2 with a single level at offset, its texels follow the level index.
+   void WriteKTX2(const string& path, uint64_t offset)
+   {
+      KTX2Header header{};
+      std::memcpy(header.Identifier, KTX2Identifier, sizeof(KTX2Identifier));
+      header.VkFormat = VkFormatR8G8B8A8Unorm;
+      header.TypeSize = 1;
+      header.PixelWidth = 4;
+      header.PixelHeight = 4;
+      header.FaceCount = 1;
+      header.LevelCount = 1;
+      const KTX2Level level{ offset, LevelSize, LevelSize };
+      const uint8_t texels[LevelSize]{};
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(&level), sizeof(level));
+      file.write(reinterpret_cast<const char*>(texels), sizeof(texels));
+      Tests::Check(bool(file), "Unable to write " + path);
+   }
+
+   bool IsAccepted(const string& path)
+   {
+      try
+      {
+         Graphics::CookedTexture texture(path);
+      }
+      catch (const std::runtime_error&)
+      {
+         return false;
+      }
+      return true;
+   }
+}
+
+int main()
+{
+   return Tests::RunTest("ContainerBoundsTest", []()
+      {
+         static_assert(sizeof(KTX2Header) == 80 && sizeof(KTX2Level) == 24, "The layout of .ktx2 is fixed.");
+         const Tests::ScratchDirectory directory("PillowContainerBounds");
+         const string valid = directory.GetFilePath("Valid.ktx2");
+         WriteKTX2(valid, sizeof(KTX2Header) + sizeof(KTX2Level));
+         Tests::Check(IsAccepted(valid), "A valid .ktx2 level was rejected.");
+         // The level starts 16 bytes before the end of the address space, offset + size wraps around into the file.
+         const string wrapped = directory.GetFilePath("Wrapped.ktx2");
+         WriteKTX2(wrapped, UINT64_MAX - 15);
+         Tests::Check(!IsAccepted(wrapped), "A .ktx2 level out of the file was accepted.");
+      });
+}
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstring>
+#include "TestUtilities.h"
+#include "Core/JobSystem.h"
+#include "Core/Renderers/Renderer.h"
+
+// SortDrawPackets() gives the order of std::stable_sort: on the small counts, on a single job, and split into jobs on the job system.
+namespace
+{
+   using namespace Pillow;
+   using namespace Pillow::Graphics;
+
+   // The key bits the packets differ in, the others are shared and their digits skipped.
+   enum class KeySpread
+   {
+      Frame, // A few passes and pipelines, more materials, and random depths.
+      Material, // A single pass and pipeline, few materials and depths, so the equal keys test the stability.
+   };
+
+   // Fixed seed, the same packets on every run.
+   std::vector<DrawPacket> CreatePackets(int32_t count, KeySpread spread)
+   {
+      std::vector<DrawPacket> packets(count);
+      uint64_t random = 1;
+      for (int32_t i = 0; i < count; i++)
+      {
+         random = random * 6364136223846793005ull + 1442695040888963407ull;
+         const uint32_t bits = uint32_t(random >> 32);
+         const uint64_t key = spread == KeySpread::Frame ? MakeSortKey(bits & 3, (bits >> 2) & 63, (bits >> 8) & 1023, float(bits >> 20) / 4096) :
+            MakeSortKey(1, 7, bits & 15, float((bits >> 4) & 3));
+         // The index of the packet is kept in its payload, so a reordering of equal keys shows up in the comparison.
+         packets[i] = DrawPacket{ key, uint32_t(i), uint32_t(i) };
+      }
+      return packets;
+   }
+
+   void CheckSort(int32_t count, KeySpread spread, int32_t jobCount)
+   {
+      std::vector<DrawPacket> packets = CreatePackets(count, spread);
+      std::vector<DrawPacket> reference = packets;
+      std::vector<DrawPacket> scratch(count);
+      SortDrawPackets(packets.data(), scratch.data(), count, jobCount);
+      std::stable_sort(reference.begin(), reference.end(), [](const DrawPacket& left, const DrawPacket& right) { return left.SortKey < right.SortKey; });
+      const auto mismatch = std::mismatch(packets.begin(), packets.end(), reference.begin(),
+         [](const DrawPacket& left, const DrawPacket& right) { return std::memcmp(&left, &right, sizeof(DrawPacket)) == 0; });
+      Tests::Check(mismatch.first == packets.end(), std::to_string(count) + " packets on " + std::to_string(jobCount) +
+         " jobs mismatch std::stable_sort at " + std::to_string(mismatch.first - packets.begin()) + ".");
+   }
+
+   void CheckAllCounts()
+   {
+      // Under MinRadixSortPackets, a single job, and enough packets for several jobs of MinPacketsPerJob.
+      for (int32_t count : { 1, 100, 5000, 100000 })
+      {
+         CheckSort(count, KeySpread::Frame, 0);
+         CheckSort(count, KeySpread::Material, 0);
+      }
+      CheckSort(100000, KeySpread::Frame, 3);
+   }
+}
+
+int main()
+{
+   return Tests::RunTest("DrawPacketSortTest", []()
+      {
+         // Without the job system every sort runs on the calling thread.
+         CheckAllCounts();
+         InitializeJobSystem(3);
+         try
+         {
+            CheckAllCounts();
+         }
+         catch (...)
+         {
+            TerminateJobSystem();
+            throw;
+         }
+         TerminateJobSystem();
+      });
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdlib>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include "Core/Auxiliaries.h"
+
+// Shared by the test executables. A failed check throws, and RunTest() turns it into the exit code ctest reads.
+namespace Pillow::Tests
+{
+   inline void Check(bool condition, const string& message)
+   {
+      if (!condition) throw std::runtime_error(message);
+   }
+
+   // A directory of its own under the temp directory, removed with its files when the scope ends.
+   class ScratchDirectory
+   {
+      DeleteDefautedMethods(ScratchDirectory)
+
+   public:
+      ScratchDirectory(const string& name) :
+         path(std::filesystem::temp_directory_path() / (name + "-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())))
+      {
+         std::filesystem::create_directories(path);
+      }
+
+      ~ScratchDirectory()
+      {
+         std::error_code error;
+         std::filesystem::remove_all(path, error);
+      }
+
+      string GetFilePath(const string& fileName) const { return (path / fileName).string(); }
+
+   private:
+      std::filesystem::path path;
+   };
+
+   inline int RunTest(const char* name, const std::function<void()>& test)
+   {
+      try
+      {
+         test();
+      }
+      catch (const std::exception& exception)
+      {
+         LogSystem(string(name) + " failed: " + exception.what());
+         return EXIT_FAILURE;
+      }
+      LogSystem(string(name) + " passed.");
+      return EXIT_SUCCESS;
+   }
+}
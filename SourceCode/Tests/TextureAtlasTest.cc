@@ -0,0 +1,117 @@
+#include <cstring>
+#include "TestUtilities.h"
+#include "Core/TextureAtlas.h"
+
+// PlanTextureArrays() groups only the compatible sources, opens a new array past MaxArraySize, keeps cube arrays to whole cubes,
+// and BuildTextureArrays() copies every source to the first subresource of its slice.
+namespace
+{
+   using namespace Pillow;
+   using namespace Pillow::Graphics;
+
+   GenericTextureInfo MakeInfo(GenericTexFmt format, int32_t width, bool bMips = true, bool bCube = false, int32_t arraySize = 1)
+   {
+      return GenericTextureInfo(format, width, bMips, CompressionMode::None, bCube, arraySize);
+   }
+
+   void CheckSlice(const TextureArraySlice& slice, int32_t array, int32_t firstSlice, const string& source)
+   {
+      Tests::Check(slice.Array == array && slice.FirstSlice == firstSlice, source + " is at array " + std::to_string(slice.Array) + " slice " +
+         std::to_string(slice.FirstSlice) + ", expected array " + std::to_string(array) + " slice " + std::to_string(firstSlice) + ".");
+   }
+
+   void TestMixedSources()
+   {
+      const std::vector<GenericTextureInfo> sources
+      {
+         MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 16),
+         MakeInfo(GenericTexFmt::UnsignedNormalized_R8, 16),
+         MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 32),
+         MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 16, true, false, 2),
+         MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 16, false),
+         MakeInfo(GenericTexFmt::UnsignedNormalized_R8, 16),
+      };
+      const TextureArrayPlan plan = PlanTextureArrays(sources);
+      Tests::Check(plan.Arrays.size() == 4 && plan.Remap.size() == sources.size(), "The mixed sources should make 4 arrays.");
+      CheckSlice(plan.Remap[0], 0, 0, "RGBA 16");
+      CheckSlice(plan.Remap[1], 1, 0, "R 16");
+      CheckSlice(plan.Remap[2], 2, 0, "RGBA 32");
+      CheckSlice(plan.Remap[3], 0, 1, "RGBA 16 x2");
+      CheckSlice(plan.Remap[4], 3, 0, "RGBA 16 without mips");
+      CheckSlice(plan.Remap[5], 1, 1, "The second R 16");
+      Tests::Check(plan.Arrays[0].GetArrayCount() == 3 && plan.Arrays[1].GetArrayCount() == 2 &&
+         plan.Arrays[2].GetArrayCount() == 1 && plan.Arrays[3].GetArrayCount() == 1, "The array sizes don't add up.");
+      Tests::Check(plan.Arrays[1].GetFormat() == GenericTexFmt::UnsignedNormalized_R8 && plan.Arrays[2].GetWidth() == 32 &&
+         plan.Arrays[3].GetMipCount() == 1, "An array doesn't match its sources.");
+   }
+
+   void TestOverflow()
+   {
+      const int32_t maxSize = GenericTextureInfo::MaxArraySize;
+      std::vector<GenericTextureInfo> sources(maxSize - 1, MakeInfo(GenericTexFmt::UnsignedNormalized_R8, 4, false));
+      // 2 slices don't fit in the last free slice, the single slice after them still does.
+      sources.push_back(MakeInfo(GenericTexFmt::UnsignedNormalized_R8, 4, false, false, 2));
+      sources.push_back(MakeInfo(GenericTexFmt::UnsignedNormalized_R8, 4, false));
+      sources.push_back(MakeInfo(GenericTexFmt::UnsignedNormalized_R8, 4, false));
+      const TextureArrayPlan plan = PlanTextureArrays(sources);
+      Tests::Check(plan.Arrays.size() == 2, "The sources past MaxArraySize should open a second array.");
+      Tests::Check(plan.Arrays[0].GetArrayCount() == maxSize && plan.Arrays[1].GetArrayCount() == 3, "The overflowing arrays have the wrong sizes.");
+      CheckSlice(plan.Remap[maxSize - 2], 0, maxSize - 2, "The last source before the overflow");
+      CheckSlice(plan.Remap[maxSize - 1], 1, 0, "The 2 slices source");
+      CheckSlice(plan.Remap[maxSize], 0, maxSize - 1, "The source of the last free slice");
+      CheckSlice(plan.Remap[maxSize + 1], 1, 2, "The source past the full array");
+   }
+
+   void TestCubemapCapacity()
+   {
+      const int32_t cubeCapacity = GenericTextureInfo::MaxArraySize / 6;
+      const std::vector<GenericTextureInfo> sources(cubeCapacity + 1, MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 4, false, true));
+      const TextureArrayPlan plan = PlanTextureArrays(sources);
+      Tests::Check(plan.Arrays.size() == 2, "The cube past the capacity should open a second array.");
+      Tests::Check(plan.Arrays[0].GetIsCubemap() && plan.Arrays[0].GetArrayCount() == cubeCapacity * 6, "A cube array should hold whole cubes only.");
+      Tests::Check(plan.Arrays[0].GetArrayCount() < GenericTextureInfo::MaxArraySize, "The capacity isn't rounded down to whole cubes.");
+      CheckSlice(plan.Remap[cubeCapacity - 1], 0, (cubeCapacity - 1) * 6, "The last cube that fits");
+      CheckSlice(plan.Remap[cubeCapacity], 1, 0, "The cube past the capacity");
+   }
+
+   void TestCopiedTexels()
+   {
+      std::vector<std::unique_ptr<GenericTexture>> textures;
+      textures.push_back(std::make_unique<GenericTexture>(MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 16)));
+      textures.push_back(std::make_unique<GenericTexture>(MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8, 8)));
+      textures.push_back(std::make_unique<GenericTexture>(MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 16, true, false, 3)));
+      textures.push_back(std::make_unique<GenericTexture>(MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 4, true, true)));
+      textures.push_back(std::make_unique<GenericTexture>(MakeInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, 16)));
+      std::vector<const GenericTexture*> sources;
+      uint8_t seed = 1;
+      for (const auto& texture : textures)
+      {
+         uint8_t* data = reinterpret_cast<uint8_t*>(texture->Data.get());
+         for (int64_t i = 0; i < texture->Info.GetTotalSize(); i++) data[i] = uint8_t(seed + i * 7);
+         seed += 64;
+         sources.push_back(texture.get());
+      }
+      const TextureArrayAtlas atlas = BuildTextureArrays(sources);
+      Tests::Check(atlas.Remap.size() == sources.size(), "Every source needs a slice.");
+      for (size_t i = 0; i < sources.size(); i++)
+      {
+         const TextureArraySlice& slice = atlas.Remap[i];
+         const GenericTexture& array = *atlas.Arrays[slice.Array];
+         Tests::Check(slice.FirstSlice + sources[i]->Info.GetArrayCount() <= array.Info.GetArrayCount(), "Source " + std::to_string(i) + " is out of its array.");
+         Tests::Check(std::memcmp(array.GetSubresource(slice.FirstSlice, 0), sources[i]->Data.get(), sources[i]->Info.GetTotalSize()) == 0,
+            "The texels of source " + std::to_string(i) + " aren't at its first subresource.");
+      }
+      CheckSlice(atlas.Remap[4], 0, 4, "The last RGBA 16");
+   }
+}
+
+int main()
+{
+   return Tests::RunTest("TextureAtlasTest", []()
+      {
+         TestMixedSources();
+         TestOverflow();
+         TestCubemapCapacity();
+         TestCopiedTexels();
+      });
+}
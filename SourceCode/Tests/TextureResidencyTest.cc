@@ -0,0 +1,103 @@
+#include "TestUtilities.h"
+#include "Core/TextureResidency.h"
+
+// TextureResidencyManager on the simulated backend: the tails stay beyond the budget, the least recently sampled textures
+// lose their most detailed mips first, and the evicted mips stream back in once they are sampled again.
+namespace
+{
+   using namespace Pillow;
+   using namespace Pillow::Graphics;
+
+   GenericTextureInfo MakeInfo(int32_t width)
+   {
+      return GenericTextureInfo(GenericTexFmt::UnsignedNormalized_R8G8B8A8, width, true, CompressionMode::None);
+   }
+
+   // The size of the mips [mip, last].
+   int64_t GetChainSize(const GenericTextureInfo& info, int32_t mip)
+   {
+      int64_t size = 0;
+      for (; mip < info.GetMipCount(); mip++) size += TextureResidencyManager::GetMipSize(info, mip);
+      return size;
+   }
+
+   // The manager and the backend agree on every mip of the texture.
+   void CheckBackend(const TextureResidencyManager& manager, const SimulatedResidencyBackend& backend, uint32_t texture, const GenericTextureInfo& info)
+   {
+      for (int32_t mip = 0; mip < info.GetMipCount(); mip++)
+      {
+         const bool bResident = mip >= manager.GetResidentMip(texture);
+         Tests::Check(backend.IsResident(texture, mip) == bResident, "The backend disagrees on mip " + std::to_string(mip) + " of texture " + std::to_string(texture) + ".");
+      }
+   }
+
+   void TestTailBeyondBudget()
+   {
+      SimulatedResidencyBackend backend(0);
+      const GenericTextureInfo info = MakeInfo(256);
+      const int32_t tailMips = 3;
+      TextureResidencyManager manager(backend, 1, tailMips);
+      uint32_t textures[3];
+      for (uint32_t& texture : textures) texture = manager.Register(info);
+      for (uint32_t texture : textures) manager.MarkSampled(texture, 0);
+      manager.Update();
+      const int32_t tailMip = info.GetMipCount() - tailMips;
+      for (uint32_t texture : textures)
+      {
+         Tests::Check(manager.GetResidentMip(texture) == tailMip, "A texture over the budget isn't at its tail.");
+         CheckBackend(manager, backend, texture, info);
+      }
+      const ResidencyStats stats = manager.GetStats();
+      Tests::Check(stats.ResidentSize == 3 * GetChainSize(info, tailMip), "The tails aren't resident.");
+      Tests::Check(stats.ResidentSize > stats.Budget, "The tails should exceed the tiny budget.");
+   }
+
+   void TestLeastRecentlySampledFirst()
+   {
+      SimulatedResidencyBackend backend(0);
+      const GenericTextureInfo large = MakeInfo(256), small = MakeInfo(128);
+      // Room for the mip 1 of every texture, the mip 0 of the small texture has the size of the mip 1 of a large texture.
+      const int64_t budget = 2 * GetChainSize(large, 1) + GetChainSize(small, 1);
+      TextureResidencyManager manager(backend, budget);
+      const uint32_t oldest = manager.Register(large), recent = manager.Register(large), growing = manager.Register(small);
+      // Frame 0: everything at mip 1, which fills the budget.
+      manager.MarkSampled(oldest, 1);
+      manager.MarkSampled(recent, 1);
+      manager.MarkSampled(growing, 1);
+      manager.Update();
+      Tests::Check(manager.GetResidentMip(oldest) == 1 && manager.GetResidentMip(recent) == 1 && manager.GetResidentMip(growing) == 1, "The sampled mips didn't stream in.");
+      Tests::Check(manager.GetStats().ResidentSize == budget, "The budget isn't filled.");
+      // Frame 1: only the recent texture is sampled.
+      manager.MarkSampled(recent, 1);
+      manager.Update();
+      // Frame 2: the small texture asks for its mip 0, the oldest texture gives up its most detailed mip for it.
+      manager.MarkSampled(growing, 0);
+      manager.Update();
+      Tests::Check(manager.GetResidentMip(growing) == 0, "The requested mip didn't stream in.");
+      Tests::Check(manager.GetResidentMip(oldest) == 2, "The least recently sampled texture didn't lose its most detailed mip.");
+      Tests::Check(manager.GetResidentMip(recent) == 1, "A more recently sampled texture was evicted first.");
+      Tests::Check(manager.GetStats().ResidentSize <= budget, "The budget is exceeded.");
+      // Frame 3: the oldest texture is sampled again, the recent one is now the least recently sampled.
+      manager.MarkSampled(oldest, 1);
+      manager.MarkSampled(growing, 0);
+      manager.Update();
+      Tests::Check(manager.GetResidentMip(oldest) == 1, "The evicted mip didn't stream back in.");
+      Tests::Check(manager.GetResidentMip(recent) == 2, "The least recently sampled texture didn't make room.");
+      Tests::Check(manager.GetResidentMip(growing) == 0, "A texture sampled in the frame lost the mip it asked for.");
+      CheckBackend(manager, backend, oldest, large);
+      CheckBackend(manager, backend, recent, large);
+      CheckBackend(manager, backend, growing, small);
+      const ResidencyStats stats = manager.GetStats();
+      Tests::Check(stats.ResidentSize == backend.GetAllocatedSize() && stats.ResidentSize <= budget, "The resident size is out of the budget.");
+      Tests::Check(stats.Evicted == 2, "Exactly the 2 mips made room.");
+   }
+}
+
+int main()
+{
+   return Tests::RunTest("TextureResidencyTest", []()
+      {
+         TestTailBeyondBudget();
+         TestLeastRecentlySampledFirst();
+      });
+}